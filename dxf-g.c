@@ -32,12 +32,16 @@
 #include <math.h>
 #include <string.h>
 #include <ctype.h>
+#include <sys/stat.h>
 #include "bio.h"
 
 /* interface headers */
 #include "bu/debug.h"
 #include "bu/getopt.h"
 #include "bu/list.h"
+#include "bu/parallel.h"
+#include "bu/sort.h"
+#include "bu/time.h"
 #include "vmath.h"
 #include "bn.h"
 #include "nmg.h"
@@ -46,19 +50,26 @@
 
 /* private headers */
 #include "./dxf.h"
+#include "./dxf_import.h"
+#include "./dxf_daemon.h"
 
 
-static int overstrikemode = 0;
-static int underscoremode = 0;
-
 struct insert_data {
     fastf_t scale[3];
     fastf_t rotation;
     point_t insert_pt;
     vect_t extrude_dir;
+    int cols, rows;		/* MINSERT grid */
+    fastf_t col_spacing, row_spacing;
 };
 
 
+/* kinds of state xform, from cheapest to apply */
+#define XFORM_IDENTITY		0
+#define XFORM_TRANSLATE		1
+#define XFORM_AFFINE		2
+#define XFORM_PROJECTIVE	3
+
 struct state_data {
     struct bu_list l;
     struct block_list *curr_block;
@@ -66,15 +77,102 @@ struct state_data {
     int state;
     int sub_state;
     mat_t xform;
+    int xform_type;		/* see xform_classify() */
+    struct insert_data ins;	/* the INSERT being expanded */
+    int cell, cells;		/* MINSERT cell being expanded, of cells */
+};
+
+
+/* a curve kept as a native sketch segment, see wire_arc() */
+struct wire_curve {
+    int type;			/* CURVE_CARC_MAGIC or CURVE_NURB_MAGIC */
+    int start, end;		/* arc end points, or a point on a full circle and its center */
+    fastf_t radius;		/* negative for a full circle */
+    int center_is_left;
+    int orientation;		/* 0 counterclockwise, 1 clockwise */
+    int order;
+    int ctl;			/* first of c_size consecutive control points */
+    int c_size;
+    int k_size;
+    fastf_t *knots;
+    fastf_t *weights;		/* NULL unless rational */
+};
+
+
+/*
+ * Wire geometry of one layer.  Segments index into the point array,
+ * so consecutive segments of a polyline share their end points.
+ */
+struct wire_store {
+    fastf_t *pts;			/* x, y, z of each point */
+    size_t pt_count;
+    size_t pt_max;
+    int *segs;				/* start and end point of each segment */
+    size_t seg_count;
+    size_t seg_max;
+    struct wire_curve *curves;
+    size_t curve_count;
+    size_t curve_max;
+    size_t chain_count;			/* open chains and closed loops, see chain_segments() */
+    size_t loop_count;
+    size_t dup_count;			/* line segments dropped, see clean_lines() */
+    size_t merged_count;
+};
+
+
+/*
+ * Part of a layer mesh made ready by prepare_layer(): the whole mesh,
+ * or the triangles in one grid cell.
+ */
+struct mesh_cell {
+    int ix, iy;
+    size_t start;		/* first triangle in part_tris */
+    size_t count;
+    size_t nclosed;		/* triangles in closed shells, which come first */
+    size_t *parts;		/* nparts + 1 offsets from start, one BOT each before chunking */
+    size_t nparts;
+};
+
+
+/* a sketch made by prepare_layer(), for the whole layer or one grid cell */
+struct sketch_cell {
+    int ix, iy;
+    struct rt_sketch_internal *skt;
+};
+
+
+/* an object written for one grid cell of a layer, see write_tiles() */
+struct tile_member {
+    int ix, iy;
+    int layer;
+    size_t seq;			/* order written */
+    char *name;
+};
+
+
+/*
+ * Strokes of one character at unit height with its origin at zero,
+ * as bn_vlist_2string() draws it.
+ */
+struct glyph {
+    int built;
+    size_t count;
+    fastf_t *pts;		/* x, y of each stroke point */
+    char *draw;			/* nonzero to draw to the point, zero to move */
 };
 
+#define GLYPH_COUNT 256
+
+
+/* a TEXT, MTEXT, ATTRIB or ATTDEF kept as metadata, see add_annotation() */
+struct annotation {
+    const char *kind;
+    char *text;
+    point_t pt;			/* insertion point, mm */
+    fastf_t height;		/* mm */
+    fastf_t rotation;		/* degrees */
+};
 
-static struct bu_list state_stack;
-static struct state_data *curr_state;
-static int curr_color=7;
-static int ignore_colors = 0;
-static char *curr_layer_name;
-static int color_by_layer = 0;		/* flag, if set, colors are set by layer */
 
 struct layer {
     char *name;			/* layer name */
@@ -83,6 +181,15 @@ struct layer {
     int *part_tris;			/* list of triangles for current part */
     size_t max_tri;			/* number of triangles currently malloced */
     size_t curr_tri;			/* number of triangles currently being used */
+    int *tri_hash;			/* triangle numbers, -1 for empty, see add_triangle() */
+    size_t tri_hash_size;
+    size_t dup_tris;			/* repeated faces dropped */
+    size_t shell_count;			/* closed pieces of the mesh, written as a solid */
+    point_t bb_min, bb_max;		/* extents of the objects written for the layer */
+    struct mesh_cell *mesh_cells;	/* see prepare_layer() */
+    size_t mesh_cell_count;
+    struct sketch_cell *sketch_cells;
+    size_t sketch_cell_count;
     size_t line_count;
     size_t solid_count;
     size_t polyline_count;
@@ -98,9 +205,16 @@ struct layer {
     size_t leader_count;
     size_t face3d_count;
     size_t point_count;
-    struct bu_ptbl solids;
-    struct model *m;
-    struct shell *s;
+    size_t curve_segs;			/* chords written for curved entities */
+    size_t curve_segs_fixed;		/* what the fixed segment counts would give */
+    struct bu_ptbl instances;		/* struct block_instance, INSERTs of library blocks */
+    struct bu_ptbl refs;		/* struct block_ref, INSERTs while recording a block */
+    fastf_t *point_pts;			/* x, y, z of each POINT */
+    size_t point_max;
+    struct annotation *notes;
+    size_t note_count;
+    size_t note_max;
+    struct wire_store wires;
 };
 
 
@@ -110,16 +224,356 @@ struct block_list {
     off_t offset;
     char handle[17];
     point_t base;
+    uint64_t hash;			/* of the definition, see hash_block_code() */
+    struct block_def *def;		/* library entry, once looked up */
+    struct parsed_block *parsed;	/* recorded body, once inserted */
+};
+
+
+/* an INSERT met while recording a block, see record_block() */
+struct block_ref {
+    struct block_list *blk;
+    off_t offset;		/* of blk in the file, -1 if none, to find it again in a later import */
+    mat_t xform;		/* relative to the recorded block */
+};
+
+
+/*
+ * The body of a BLOCK as parsed once, in block coordinates: the
+ * layers its entities went to, each holding wires, triangles,
+ * POINTs and references to nested blocks.
+ */
+struct parsed_block {
+    struct layer **layers;
+    int layer_count;
+    int has_arcs;		/* native arcs only survive similarity transforms */
+    int has_chords;		/* curves tessellated for the block's own scale */
+    int replaying;		/* set while being replayed, a block may not insert itself */
+    off_t offset;		/* of the BLOCK in the file, while kept in a cache */
+};
+
+
+/* a BLOCK definition written to the database by some import */
+struct block_def {
+    char *block_name;
+    uint64_t hash;
+    char *comb_name;		/* NULL if the block had no geometry */
+    int converting;		/* set while its own body is being imported */
+};
+
+
+struct dxf_block_library {
+    struct bu_ptbl defs;	/* struct block_def */
+    size_t converted;
+    size_t reused;
+};
+
+
+/* an INSERT written as a reference to a library block */
+struct block_instance {
+    const char *comb_name;	/* owned by the library */
+    mat_t xform;
+};
+
+
+/*
+ * Values carried between group codes of a single entity.  These used
+ * to be function-level statics in the entity handlers; each converter
+ * context now owns its own copy.
+ */
+struct point_entity {
+    point_t pt;
+};
+
+
+struct vertex_entity {
+    fastf_t x, y, z;
+    int face[4];
+    int vertex_flag;
+};
+
+
+struct insert_entity {
+    struct insert_data ins;
+    struct state_data *new_state;
+};
+
+
+struct solid_entity {
+    int last_vert_no;
+    point_t solid_pt[4];
+};
+
+
+struct lwpolyline_entity {
+    int vert_no;
+    fastf_t x, y;
+};
+
+
+struct line_entity {
+    point_t line_pt[2];
+};
+
+
+struct ellipse_entity {
+    point_t center;
+    point_t majorAxis;
+    double ratio;
+    double startAngle;
+    double endAngle;
+};
+
+
+struct circle_entity {
+    point_t center;
+    fastf_t radius;
+};
+
+
+struct leader_entity {
+    int arrowHeadFlag;
+    int vertNo;
+    point_t pt;
+};
+
+
+struct mtext_entity {
+    struct bu_vls *vls;
+    int attachPoint;
+    int drawingDirection;
+    double textHeight;
+    double entityHeight;
+    double charWidth;
+    double rectWidth;
+    double rotationAngle;
+    double insertionPoint[3];
+    double xAxisDirection[3];
+};
+
+
+struct text_entity {
+    char *theText;
+    int horizAlignment;
+    int vertAlignment;
+    int textFlag;
+    point_t firstAlignmentPoint;
+    point_t secondAlignmentPoint;
+    double textScale;
+    double textHeight;
+    double textRotation;
+};
+
+
+struct dimension_entity {
+    char *block_name;
+    struct state_data *new_state;
+};
+
+
+struct arc_entity {
+    point_t center;
+    fastf_t radius;
+    fastf_t start_angle, end_angle;
 };
 
 
-static struct bu_list block_head;
-static struct block_list *curr_block=NULL;
+struct spline_entity {
+    int flag;
+    int degree;
+    int numKnots;
+    int numCtlPts;
+    int numFitPts;
+    fastf_t *knots;
+    fastf_t *weights;
+    fastf_t *ctlPts;
+    fastf_t *fitPts;
+    vect_t startTan;
+    vect_t endTan;
+    int tanFlags;		/* SPLINE_START_TANGENT, SPLINE_END_TANGENT */
+    int knotCount;
+    int weightCount;
+    int ctlPtCount;
+    int fitPtCount;
+    int subCounter;
+    int subCounter2;
+};
+
+
+/*
+ * Block recordings left by an import, for the next import of the same
+ * file with the same options.
+ */
+#define RECORDED_FILES 4
+
+struct recorded_file {
+    struct bu_vls key;			/* see record_key() */
+    struct bu_ptbl blocks;		/* struct parsed_block */
+};
+
+
+/*
+ * Allocations that outlive a single import.  A batch worker hands the
+ * same cache to each import it runs so these stay warm between files.
+ */
+struct dxf_import_cache {
+    fastf_t *polyline_verts;
+    int polyline_vertex_max;
+    int *polyline_vert_indices;
+    int polyline_vert_indices_max;
+    struct bu_list free_hd;		/* vlist free list */
+    struct glyph *glyphs;		/* see glyph_get() */
+    fastf_t **curve_tmpl;		/* see curve_template() */
+    struct recorded_file recorded[RECORDED_FILES];
+    size_t recorded_next;		/* the one to reuse for another file */
+};
+
+
+#define MAX_LINE_SIZE 2050
+
+/*
+ * Circles, arcs and ellipses are queued and their points generated
+ * in batches.  A queued curve is c + cos(t) a + sin(t) b for t from 0
+ * in steps of delta, with the current transform and the start angle
+ * already folded into c, a and b, so making the points is a few
+ * multiply-adds per point over flat arrays.
+ */
+#define CURVE_BATCH 512
+#define CURVE_MAX_SEGS 4096
+
+enum { CURVE_CIRCLE, CURVE_ARC, CURVE_ELLIPSE, CURVE_TYPES };
+
+struct curve_job {
+    int type;
+    int layer;
+    int nsegs;
+    int closed;			/* the last segment returns to the first point */
+    int tmpl_n;			/* delta is 2pi/tmpl_n, zero if not */
+    fastf_t delta;
+    fastf_t t1;			/* angle of the last point when open */
+    point_t c;
+    vect_t a, b;
+};
+
+struct curve_batch {
+    struct curve_job jobs[CURVE_BATCH];
+    size_t count;
+    fastf_t **tmpl;			/* cos and sin of k*2pi/n, by n up to CURVE_MAX_SEGS */
+    fastf_t *ct, *st;			/* cos and sin for one curve */
+    fastf_t *x, *y, *z;			/* points of one curve */
+    size_t scratch_max;
+    size_t curves[CURVE_TYPES];
+    size_t points[CURVE_TYPES];
+    int64_t usec[CURVE_TYPES];
+};
+
+/*
+ * All of the state for one DXF import.  Nothing in here is shared
+ * between contexts, so independent imports may run concurrently as
+ * long as each writes to its own database.
+ */
+struct dxf_import {
+    /* options */
+    int verbose;
+    int ignore_colors;
+    int native_curves;
+    int dedup_reversed;			/* a face repeated with reversed winding is a duplicate too */
+    int spatial_order;			/* write BOT triangles and vertices in Morton order */
+    size_t chunk_tris;			/* most triangles in one surface BOT, zero for no limit */
+    int split_components;		/* one BOT for each connected piece of a mesh */
+    fastf_t tile_size;			/* drawing units, zero for no tiling */
+    size_t ncpu;			/* threads preparing layers in write_layers() */
+    fastf_t tile_mm;
+    struct tile_member *tiles;
+    size_t tile_count;
+    size_t tile_max;
+    int annotations;			/* keep text as attributes instead of strokes */
+    fastf_t chord_error;		/* drawing units, zero for fixed segment counts */
+    fastf_t simplify_tol;		/* drawing units, zero to only merge collinear lines */
+    fastf_t tol;
+    fastf_t tol_sq;
+    fastf_t scale_factor;
+
+    struct dxf_import_cache *cache;	/* optional, owned by the caller */
+    struct dxf_block_library *blocks;	/* optional, owned by the caller unless own_blocks */
+    int own_blocks;			/* blocks was created for this import */
+    char *prefix;			/* for every object name */
+    char *top_name;			/* NULL for "all" */
+    int block_body;			/* importing one BLOCK, stop at its ENDBLK */
+    int recording;			/* keep INSERTs and POINTs as references, see record_block() */
+    size_t block_parses;		/* blocks recorded for replay */
+    size_t block_kept;			/* recordings taken over from an earlier import */
+    size_t block_replays;		/* INSERTs served from a recording */
+    struct bu_vls record_key;		/* with a cache, see record_key() */
+
+    /* input and output */
+    FILE *dxf;
+    char *dxf_file;
+    struct rt_wdb *out_fp;
+    char line[MAX_LINE_SIZE];
+    int line_num;
+    char tmp_name[256];
+
+    /* parser state */
+    struct bu_list state_stack;
+    struct state_data *curr_state;
+    int curr_color;
+    char *curr_layer_name;
+    int color_by_layer;		/* flag, if set, colors are set by layer */
+    int *int_ptr;
+    int units;
+    int invisible;
+    int overstrikemode;
+    int underscoremode;
+
+    /* blocks */
+    struct bu_list block_head;
+    struct block_list *curr_block;
+
+    /* layers */
+    struct layer **layers;
+    int max_layers;
+    int next_layer;
+    int curr_layer;
+
+    /* POLYLINE and LWPOLYLINE accumulation */
+    int polyline_flag;
+    fastf_t *polyline_verts;
+    int polyline_vertex_count;
+    int polyline_vertex_max;
+    int mesh_m_count;
+    int mesh_n_count;
+    int *polyline_vert_indices;
+    int polyline_vert_indices_count;
+    int polyline_vert_indices_max;
+
+    point_t pts[4];
+
+    /* curve approximation */
+    int segs_per_circle;
+    int splineSegs;
+    struct curve_batch *curves;
+
+    struct bu_list free_hd;		/* vlist free list for text */
+    struct glyph *glyphs;		/* strokes of each character, built on first use */
+
+    /* per-entity values */
+    struct point_entity point_ent;
+    struct vertex_entity vertex_ent;
+    struct insert_entity insert_ent;
+    struct solid_entity solid_ent;
+    struct lwpolyline_entity lwpolyline_ent;
+    struct line_entity line_ent;
+    struct ellipse_entity ellipse_ent;
+    struct circle_entity circle_ent;
+    struct leader_entity leader_ent;
+    struct mtext_entity mtext_ent;
+    struct text_entity text_ent;
+    struct dimension_entity dimension_ent;
+    struct arc_entity arc_ent;
+    struct spline_entity spline_ent;
+};
 
-static struct layer **layers=NULL;
-static int max_layers;
-static int next_layer;
-static int curr_layer;
 
 /* SECTIONS (states) */
 #define UNKNOWN_SECTION		0
@@ -155,7 +609,6 @@ static int curr_layer;
 #define NUM_ENTITY_STATES		19
 
 /* POLYLINE flags */
-static int polyline_flag = 0;
 #define POLY_CLOSED		1
 #define POLY_CURVE_FIT		2
 #define POLY_SPLINE_FIT		4
@@ -181,64 +634,101 @@ static int polyline_flag = 0;
 #define SPLINE_PLANAR		8
 #define SPLINE_LINEAR		16
 
+/* spline_entity tanFlags */
+#define SPLINE_START_TANGENT	1
+#define SPLINE_END_TANGENT	2
+
 /* states for the TABLES section */
 #define UNKNOWN_TABLE_STATE	0
 #define LAYER_TABLE_STATE	1
 #define NUM_TABLE_STATES	2
 
-static fastf_t *polyline_verts=NULL;
-static int polyline_vertex_count = 0;
-static int polyline_vertex_max = 0;
-static int mesh_m_count = 0;
-static int mesh_n_count = 0;
-static int *polyline_vert_indices=NULL;
-static int polyline_vert_indices_count = 0;
-static int polyline_vert_indices_max = 0;
-#define PVINDEX(_i, _j)	((_i)*mesh_n_count + (_j))
+#define PVINDEX(_i, _j)	((_i)*ctx->mesh_n_count + (_j))
 #define POLYLINE_VERTEX_BLOCK	10
 
-static point_t pts[4];
-
 #define UNKNOWN_ENTITY 0
 #define POLYLINE_VERTEX 1
 
-static int invisible = 0;
-
 #define ERROR_FLAG	-999
 #define EOF_FLAG	-998
 
 #define TOL_SQ 0.00001
-#define MAX_LINE_SIZE 2050
-char line[MAX_LINE_SIZE];
-
-static char *usage="Usage: dxf-g [-c] [-d] [-v] [-t tolerance] [-s scale_factor] input_file.dxf output_file.g\n";
-
-static FILE *dxf;
-static struct rt_wdb *out_fp;
-static char *output_file;
-static char *dxf_file;
-static int verbose = 0;
-static fastf_t tol = 0.01;
-static fastf_t tol_sq;
-static char *base_name;
-static char tmp_name[256];
-static int segs_per_circle=32;
-static int splineSegs=16;
-static fastf_t sin_delta, cos_delta;
-static fastf_t delta_angle;
-static point_t *circle_pts;
-static fastf_t scale_factor;
-static struct bu_list free_hd;
 
 #define TRI_BLOCK 512			/* number of triangles to malloc per call */
+#define WIRE_BLOCK 1024			/* initial number of wire points or segments, doubled as needed */
+
+typedef int (*code_handler_t)(struct dxf_import *ctx, int code);
+
+static int process_unknown_code(struct dxf_import *ctx, int code);
+static int process_header_code(struct dxf_import *ctx, int code);
+static int process_classes_code(struct dxf_import *ctx, int code);
+static int process_tables_code(struct dxf_import *ctx, int code);
+static int process_blocks_code(struct dxf_import *ctx, int code);
+static int process_entity_code(struct dxf_import *ctx, int code);
+static int process_objects_code(struct dxf_import *ctx, int code);
+static int process_thumbnail_code(struct dxf_import *ctx, int code);
+
+static int process_entities_unknown_code(struct dxf_import *ctx, int code);
+static int process_entities_polyline_code(struct dxf_import *ctx, int code);
+static int process_entities_polyline_vertex_code(struct dxf_import *ctx, int code);
+static int process_3dface_entities_code(struct dxf_import *ctx, int code);
+static int process_line_entities_code(struct dxf_import *ctx, int code);
+static int process_insert_entities_code(struct dxf_import *ctx, int code);
+static int process_point_entities_code(struct dxf_import *ctx, int code);
+static int process_circle_entities_code(struct dxf_import *ctx, int code);
+static int process_arc_entities_code(struct dxf_import *ctx, int code);
+static int process_dimension_entities_code(struct dxf_import *ctx, int code);
+static int process_text_attrib_entities_code(struct dxf_import *ctx, int code);
+static int process_solid_entities_code(struct dxf_import *ctx, int code);
+static int process_lwpolyline_entities_code(struct dxf_import *ctx, int code);
+static int process_mtext_entities_code(struct dxf_import *ctx, int code);
+static int process_ellipse_entities_code(struct dxf_import *ctx, int code);
+static int process_leader_entities_code(struct dxf_import *ctx, int code);
+static int process_spline_entities_code(struct dxf_import *ctx, int code);
+
+static int process_tables_unknown_code(struct dxf_import *ctx, int code);
+static int process_tables_layer_code(struct dxf_import *ctx, int code);
+
+/* the dispatch tables are read-only and shared by all contexts */
+static const code_handler_t process_code[NUM_SECTIONS] = {
+    process_unknown_code,		/* UNKNOWN_SECTION */
+    process_header_code,		/* HEADER_SECTION */
+    process_classes_code,		/* CLASSES_SECTION */
+    process_tables_code,		/* TABLES_SECTION */
+    process_blocks_code,		/* BLOCKS_SECTION */
+    process_entity_code,		/* ENTITIES_SECTION */
+    process_objects_code,		/* OBJECTS_SECTION */
+    process_thumbnail_code		/* THUMBNAILIMAGE_SECTION */
+};
 
-static int (*process_code[NUM_SECTIONS])(int code);
-static int (*process_entities_code[NUM_ENTITY_STATES])(int code);
-static int (*process_tables_sub_code[NUM_TABLE_STATES])(int code);
+static const code_handler_t process_entities_code[NUM_ENTITY_STATES] = {
+    process_entities_unknown_code,		/* UNKNOWN_ENTITY_STATE */
+    process_entities_polyline_code,		/* POLYLINE_ENTITY_STATE */
+    process_entities_polyline_vertex_code,	/* POLYLINE_VERTEX_ENTITY_STATE */
+    process_3dface_entities_code,		/* FACE3D_ENTITY_STATE */
+    process_line_entities_code,			/* LINE_ENTITY_STATE */
+    process_insert_entities_code,		/* INSERT_ENTITY_STATE */
+    process_point_entities_code,		/* POINT_ENTITY_STATE */
+    process_circle_entities_code,		/* CIRCLE_ENTITY_STATE */
+    process_arc_entities_code,			/* ARC_ENTITY_STATE */
+    process_dimension_entities_code,		/* DIMENSION_ENTITY_STATE */
+    process_text_attrib_entities_code,		/* TEXT_ENTITY_STATE */
+    process_solid_entities_code,		/* SOLID_ENTITY_STATE */
+    process_lwpolyline_entities_code,		/* LWPOLYLINE_ENTITY_STATE */
+    process_mtext_entities_code,		/* MTEXT_ENTITY_STATE */
+    process_leader_entities_code,		/* LEADER_ENTITY_STATE */
+    process_text_attrib_entities_code,		/* ATTRIB_ENTITY_STATE */
+    process_text_attrib_entities_code,		/* ATTDEF_ENTITY_STATE */
+    process_ellipse_entities_code,		/* ELLIPSE_ENTITY_STATE */
+    process_spline_entities_code		/* SPLINE_ENTITY_STATE */
+};
+
+static const code_handler_t process_tables_sub_code[NUM_TABLE_STATES] = {
+    process_tables_unknown_code,	/* UNKNOWN_TABLE_STATE */
+    process_tables_layer_code		/* LAYER_TABLE_STATE */
+};
 
-static int *int_ptr=NULL;
-static int units = 0;
-static fastf_t units_conv[]={
+static const fastf_t units_conv[]={
     /* 0 */	1.0,
     /* 1 */	25.4,
     /* 2 */	304.8,
@@ -284,1935 +774,1429 @@ make_brlcad_name(const char *nameline)
 
 
 static void
-get_layer()
+get_layer(struct dxf_import *ctx)
 {
     int i;
-    int old_layer=curr_layer;
+    int old_layer=ctx->curr_layer;
 
-    if (verbose) {
-	bu_log("get_layer(): state = %d, substate = %d\n", curr_state->state, curr_state->sub_state);
+    if (ctx->verbose) {
+	bu_log("get_layer(): state = %d, substate = %d\n", ctx->curr_state->state, ctx->curr_state->sub_state);
     }
     /* do we already have a layer by this name and color */
-    curr_layer = -1;
-    for (i = 1; i < next_layer; i++) {
-	if (!color_by_layer && !ignore_colors && curr_color != 256) {
-	    if (layers[i]->color_number == curr_color && BU_STR_EQUAL(curr_layer_name, layers[i]->name)) {
-		curr_layer = i;
+    ctx->curr_layer = -1;
+    for (i = 1; i < ctx->next_layer; i++) {
+	if (!ctx->color_by_layer && !ctx->ignore_colors && ctx->curr_color != 256) {
+	    if (ctx->layers[i]->color_number == ctx->curr_color && BU_STR_EQUAL(ctx->curr_layer_name, ctx->layers[i]->name)) {
+		ctx->curr_layer = i;
 		break;
 	    }
 	} else {
-	    if (BU_STR_EQUAL(curr_layer_name, layers[i]->name)) {
-		curr_layer = i;
+	    if (BU_STR_EQUAL(ctx->curr_layer_name, ctx->layers[i]->name)) {
+		ctx->curr_layer = i;
 		break;
 	    }
 	}
     }
 
-    if (curr_layer == -1) {
+    if (ctx->curr_layer == -1) {
 	/* add a new layer */
-	if (next_layer >= max_layers) {
-	    if (verbose) {
+	if (ctx->next_layer >= ctx->max_layers) {
+	    if (ctx->verbose) {
 		bu_log("Creating new block of layers\n");
 	    }
-	    max_layers += 5;
-	    layers = (struct layer **)bu_realloc(layers, max_layers*sizeof(struct layer *), "layers");
+	    ctx->max_layers += 5;
+	    ctx->layers = (struct layer **)bu_realloc(ctx->layers, ctx->max_layers*sizeof(struct layer *), "layers");
 	    for (i = 0; i < 5; i++) {
-		BU_ALLOC(layers[max_layers-i-1], struct layer);
+		BU_ALLOC(ctx->layers[ctx->max_layers-i-1], struct layer);
 	    }
 	}
-	curr_layer = next_layer++;
-	if (verbose) {
-	    bu_log("New layer: %s, color number: %d", line, curr_color);
+	ctx->curr_layer = ctx->next_layer++;
+	if (ctx->verbose) {
+	    bu_log("New layer: %s, color number: %d", ctx->line, ctx->curr_color);
 	}
-	layers[curr_layer]->name = bu_strdup(curr_layer_name);
-	if (curr_state->state == ENTITIES_SECTION &&
-	    (curr_state->sub_state == POLYLINE_ENTITY_STATE ||
-	     curr_state->sub_state == POLYLINE_VERTEX_ENTITY_STATE)) {
-	    layers[curr_layer]->vert_tree = layers[old_layer]->vert_tree;
+	ctx->layers[ctx->curr_layer]->name = bu_strdup(ctx->curr_layer_name);
+	if (ctx->curr_state->state == ENTITIES_SECTION &&
+	    (ctx->curr_state->sub_state == POLYLINE_ENTITY_STATE ||
+	     ctx->curr_state->sub_state == POLYLINE_VERTEX_ENTITY_STATE)) {
+	    ctx->layers[ctx->curr_layer]->vert_tree = ctx->layers[old_layer]->vert_tree;
 	} else {
-	    layers[curr_layer]->vert_tree = bn_vert_tree_create();
+	    ctx->layers[ctx->curr_layer]->vert_tree = bn_vert_tree_create();
 	}
-	layers[curr_layer]->color_number = curr_color;
-	bu_ptbl_init(&layers[curr_layer]->solids, 8, "layers[curr_layer]->solids");
-	if (verbose) {
-	    bu_log("\tNew layer name: %s\n", layers[curr_layer]->name);
+	ctx->layers[ctx->curr_layer]->color_number = ctx->curr_color;
+	bu_ptbl_init(&ctx->layers[ctx->curr_layer]->instances, 8, "layers[curr_layer]->instances");
+	bu_ptbl_init(&ctx->layers[ctx->curr_layer]->refs, 8, "layers[curr_layer]->refs");
+	if (ctx->verbose) {
+	    bu_log("\tNew layer name: %s\n", ctx->layers[ctx->curr_layer]->name);
 	}
     }
 
-    if (verbose && curr_layer != old_layer) {
-	bu_log("changed to layer #%d, (m = %p, s=%p)\n",
-	       curr_layer,
-	       (void *)layers[curr_layer]->m,
-	       (void *)layers[curr_layer]->s);
+    if (ctx->verbose && ctx->curr_layer != old_layer) {
+	bu_log("changed to layer #%d, (%zu wire segments)\n",
+	       ctx->curr_layer,
+	       ctx->layers[ctx->curr_layer]->wires.seg_count);
     }
 }
 
 
-static void
-create_nmg()
-{
-    struct model *m;
-    struct nmgregion *r;
-
-    m = nmg_mm();
-    r = nmg_mrsv(m);
-    layers[curr_layer]->s = BU_LIST_FIRST(shell, &r->s_hd);
-    layers[curr_layer]->m = m;
-}
-
-
-/* routine to add a new triangle to the current part */
-void
-add_triangle(int v1, int v2, int v3, int layer)
+static int
+xform_classify(const mat_t m)
 {
-    if (verbose) {
-	bu_log("Adding triangle %d %d %d, to layer %s\n", v1, v2, v3, layers[layer]->name);
+    if (!ZERO(m[12]) || !ZERO(m[13]) || !ZERO(m[14]) || !EQUAL(m[15], 1.0)) {
+	return XFORM_PROJECTIVE;
     }
-    if (v1 == v2 || v2 == v3 || v3 == v1) {
-	if (verbose) {
-	    bu_log("\tSkipping degenerate triangle\n");
-	}
-	return;
+    if (!EQUAL(m[0], 1.0) || !EQUAL(m[5], 1.0) || !EQUAL(m[10], 1.0) ||
+	!ZERO(m[1]) || !ZERO(m[2]) || !ZERO(m[4]) || !ZERO(m[6]) || !ZERO(m[8]) || !ZERO(m[9])) {
+	return XFORM_AFFINE;
     }
-    if (layers[layer]->curr_tri >= layers[layer]->max_tri) {
-	/* allocate more memory for triangles */
-	layers[layer]->max_tri += TRI_BLOCK;
-	layers[layer]->part_tris = (int *)bu_realloc(layers[layer]->part_tris, sizeof(int) * layers[layer]->max_tri * 3, "layers[layer]->part_tris");
+    if (!ZERO(m[3]) || !ZERO(m[7]) || !ZERO(m[11])) {
+	return XFORM_TRANSLATE;
     }
 
-    /* fill in triangle info */
-    layers[layer]->part_tris[layers[layer]->curr_tri*3 + 0] = v1;
-    layers[layer]->part_tris[layers[layer]->curr_tri*3 + 1] = v2;
-    layers[layer]->part_tris[layers[layer]->curr_tri*3 + 2] = v3;
-
-    /* increment count */
-    layers[layer]->curr_tri++;
+    return XFORM_IDENTITY;
 }
 
 
-static int
-process_unknown_code(int code)
+/*
+ * Apply the state xform to count x, y, z points in place.  Entities
+ * outside any block skip this entirely, and the loops for the other
+ * common cases avoid the divide in MAT4X3PNT.
+ */
+static void
+xform_points(const struct state_data *state, fastf_t *pts, size_t count)
 {
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
+    const fastf_t *m = state->xform;
+    size_t i;
+
+    switch (state->xform_type) {
+	case XFORM_IDENTITY:
 	    break;
-	case 0:		/* text string */
-	    if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
+	case XFORM_TRANSLATE: {
+	    const fastf_t tx = m[3], ty = m[7], tz = m[11];
+
+	    for (i = 0; i < count; i++) {
+		pts[i*3 + X] += tx;
+		pts[i*3 + Y] += ty;
+		pts[i*3 + Z] += tz;
 	    }
 	    break;
-	case 2:		/* name */
-	    if (!bu_strncmp(line, "HEADER", 6)) {
-		curr_state->state = HEADER_SECTION;
-		if (verbose) {
-		    bu_log("Change state to %d\n", curr_state->state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "CLASSES", 7)) {
-		curr_state->state = CLASSES_SECTION;
-		if (verbose) {
-		    bu_log("Change state to %d\n", curr_state->state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "TABLES", 6)) {
-		curr_state->state = TABLES_SECTION;
-		curr_state->sub_state = UNKNOWN_TABLE_STATE;
-		if (verbose) {
-		    bu_log("Change state to %d\n", curr_state->state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "BLOCKS", 6)) {
-		curr_state->state = BLOCKS_SECTION;
-		if (verbose) {
-		    bu_log("Change state to %d\n", curr_state->state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "ENTITIES", 8)) {
-		curr_state->state = ENTITIES_SECTION;
-		curr_state->sub_state =UNKNOWN_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("Change state to %d\n", curr_state->state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "OBJECTS", 7)) {
-		curr_state->state = OBJECTS_SECTION;
-		if (verbose) {
-		    bu_log("Change state to %d\n", curr_state->state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "THUMBNAILIMAGE", 14)) {
-		curr_state->state = THUMBNAILIMAGE_SECTION;
-		if (verbose) {
-		    bu_log("Change state to %d\n", curr_state->state);
-		}
-		break;
+	}
+	case XFORM_AFFINE: {
+	    const fastf_t m0 = m[0], m1 = m[1], m2 = m[2], m3 = m[3];
+	    const fastf_t m4 = m[4], m5 = m[5], m6 = m[6], m7 = m[7];
+	    const fastf_t m8 = m[8], m9 = m[9], m10 = m[10], m11 = m[11];
+
+	    for (i = 0; i < count; i++) {
+		fastf_t x = pts[i*3 + X], y = pts[i*3 + Y], z = pts[i*3 + Z];
+
+		pts[i*3 + X] = m0 * x + m1 * y + m2 * z + m3;
+		pts[i*3 + Y] = m4 * x + m5 * y + m6 * z + m7;
+		pts[i*3 + Z] = m8 * x + m9 * y + m10 * z + m11;
 	    }
 	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
+	}
+	default:
+	    for (i = 0; i < count; i++) {
+		point_t tmp_pt;
+
+		MAT4X3PNT(tmp_pt, m, &pts[i*3]);
+		VMOVE(&pts[i*3], tmp_pt);
+	    }
 	    break;
     }
-    return 0;
 }
 
 
+/* add a point to the current layer's wires, returns its index */
 static int
-process_header_code(int code)
+wire_point(struct dxf_import *ctx, const fastf_t *pt)
 {
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    }
-	    break;
-	case 9:		/* variable name */
-	    if (!bu_strncmp(line, "$INSUNITS", 9)) {
-		int_ptr = &units;
-	    } else if (BU_STR_EQUAL(line, "$CECOLOR")) {
-		int_ptr = &color_by_layer;
-	    } else if (BU_STR_EQUAL(line, "$SPLINESEGS")) {
-		int_ptr = &splineSegs;
-	    }
-	    break;
-	case 70:
-	case 62:
-	    if (int_ptr) {
-		(*int_ptr) = atoi(line);
-	    }
-	    int_ptr = NULL;
-	    break;
+    struct wire_store *w = &ctx->layers[ctx->curr_layer]->wires;
+
+    if (w->pt_count >= w->pt_max) {
+	w->pt_max = w->pt_max ? w->pt_max * 2 : WIRE_BLOCK;
+	w->pts = (fastf_t *)bu_realloc(w->pts, w->pt_max * 3 * sizeof(fastf_t), "wire points");
     }
+    VMOVE(&w->pts[w->pt_count*3], pt);
 
-    return 0;
+    return (int)w->pt_count++;
 }
 
 
-static int
-process_classes_code(int code)
+/* add a segment between two points returned by wire_point() */
+static void
+wire_seg(struct dxf_import *ctx, int start, int end, const char *what)
 {
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    }
-	    break;
+    struct wire_store *w = &ctx->layers[ctx->curr_layer]->wires;
+
+    if (w->seg_count >= w->seg_max) {
+	w->seg_max = w->seg_max ? w->seg_max * 2 : WIRE_BLOCK;
+	w->segs = (int *)bu_realloc(w->segs, w->seg_max * 2 * sizeof(int), "wire segments");
     }
+    w->segs[w->seg_count*2] = start;
+    w->segs[w->seg_count*2 + 1] = end;
+    w->seg_count++;
 
-    return 0;
+    if (ctx->verbose) {
+	bu_log("Wire edge (%s): (%g %g %g) <-> (%g %g %g)\n", what,
+	       V3ARGS(&w->pts[start*3]), V3ARGS(&w->pts[end*3]));
+    }
 }
 
 
-static int
-process_tables_unknown_code(int code)
+/* add count points joined by count-1 segments, plus one more if closed */
+static void
+wire_polyline(struct dxf_import *ctx, const fastf_t *pts, int count, int closed, const char *what)
 {
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    if (BU_STR_EQUAL(line, "LAYER")) {
-		if (curr_layer_name) {
-		    bu_free(curr_layer_name, "cur_layer_name");
-		    curr_layer_name = NULL;
-		}
-		curr_color = 0;
-		curr_state->sub_state = LAYER_TABLE_STATE;
-		break;
-	    } else if (BU_STR_EQUAL(line, "ENDTAB")) {
-		if (curr_layer_name) {
-		    bu_free(curr_layer_name, "cur_layer_name");
-		    curr_layer_name = NULL;
-		}
-		curr_color = 0;
-		curr_state->sub_state = UNKNOWN_TABLE_STATE;
-		break;
-	    } else if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    }
-	    break;
+    int first, prev, curr;
+    int i;
+
+    if (count < 2) {
+	return;
     }
 
-    return 0;
+    first = prev = wire_point(ctx, pts);
+    for (i = 1; i < count; i++) {
+	curr = wire_point(ctx, &pts[i*3]);
+	wire_seg(ctx, prev, curr, what);
+	prev = curr;
+    }
+    if (closed) {
+	wire_seg(ctx, prev, first, what);
+    }
 }
 
 
-static int
-process_tables_layer_code(int code)
+static struct wire_curve *
+wire_curve(struct dxf_import *ctx, int type)
 {
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 2:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    if (verbose) {
-		bu_log("In LAYER in TABLES, layer name = %s\n", curr_layer_name);
-	    }
-	    break;
-	case 62:	/* layer color */
-	    curr_color = atoi(line);
-	    if (verbose) {
-		bu_log("In LAYER in TABLES, layer color = %d\n", curr_color);
-	    }
-	    break;
-	case 0:		/* text string */
-	    if (curr_layer_name && curr_color) {
-		get_layer();
-	    }
+    struct wire_store *w = &ctx->layers[ctx->curr_layer]->wires;
+    struct wire_curve *crv;
 
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "cur_layer_name");
-		curr_layer_name = NULL;
-	    }
-	    curr_color = 0;
-	    curr_state->sub_state = UNKNOWN_TABLE_STATE;
-	    return process_tables_unknown_code(code);
+    if (w->curve_count >= w->curve_max) {
+	w->curve_max = w->curve_max ? w->curve_max * 2 : WIRE_BLOCK;
+	w->curves = (struct wire_curve *)bu_realloc(w->curves, w->curve_max * sizeof(struct wire_curve), "wire curves");
     }
+    crv = &w->curves[w->curve_count++];
+    memset(crv, 0, sizeof(struct wire_curve));
+    crv->type = type;
 
-    return 0;
+    return crv;
 }
 
 
-static int
-process_tables_code(int code)
+/*
+ * Add a NURBS curve.  The control points are in drawing space and
+ * are transformed here; weights may be NULL.  The knots must be
+ * clamped, as wires_to_sketch() takes the first and last control
+ * points for the ends of the curve.
+ */
+static void
+wire_nurb(struct dxf_import *ctx, int order, int c_size, const fastf_t *ctl, const fastf_t *weights,
+	  int k_size, const fastf_t *knots)
 {
-    return process_tables_sub_code[curr_state->sub_state](code);
-}
+    struct wire_curve *crv;
+    int first = 0;
+    int i;
 
+    for (i = 0; i < c_size; i++) {
+	int idx = wire_point(ctx, &ctl[i*3]);
 
-static int
-process_blocks_code(int code)
-{
-    size_t len;
-    int coord;
-
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (BU_STR_EQUAL(line, "ENDBLK")) {
-		curr_block = NULL;
-		break;
-	    } else if (!bu_strncmp(line, "BLOCK", 5)) {
-		/* start of a new block */
-		BU_ALLOC(curr_block, struct block_list);
-		curr_block->offset = bu_ftell(dxf);
-		BU_LIST_INSERT(&(block_head), &(curr_block->l));
-		break;
-	    }
-	    break;
-	case 2:		/* block name */
-	    if (curr_block && curr_block->block_name == NULL) {
-		curr_block->block_name = bu_strdup(line);
-		if (verbose) {
-		    bu_log("BLOCK %s begins at %jd\n",
-			   curr_block->block_name,
-			   (intmax_t)curr_block->offset);
-		}
-	    }
-	    break;
-	case 5:		/* block handle */
-	    if (curr_block && BU_STR_EMPTY(curr_block->handle)) {
-		len = strlen(line);
-		V_MIN(len, 16);
-		bu_strlcpy(curr_block->handle, line, len);
-	    }
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	    if (curr_block) {
-		coord = code / 10 - 1;
-		curr_block->base[coord] = atof(line) * units_conv[units] * scale_factor;
-	    }
-	    break;
+	if (i == 0) {
+	    first = idx;
+	}
+    }
+    xform_points(ctx->curr_state, &ctx->layers[ctx->curr_layer]->wires.pts[first*3], c_size);
+
+    crv = wire_curve(ctx, CURVE_NURB_MAGIC);
+    crv->order = order;
+    crv->ctl = first;
+    crv->c_size = c_size;
+    crv->k_size = k_size;
+    crv->knots = (fastf_t *)bu_malloc(k_size * sizeof(fastf_t), "wire curve knots");
+    memcpy(crv->knots, knots, k_size * sizeof(fastf_t));
+    if (weights) {
+	crv->weights = (fastf_t *)bu_malloc(c_size * sizeof(fastf_t), "wire curve weights");
+	memcpy(crv->weights, weights, c_size * sizeof(fastf_t));
     }
-
-    return 0;
 }
 
 
-void
-add_polyline_vertex(fastf_t x, fastf_t y, fastf_t z)
+/*
+ * Add the conic c + cos(t) a + sin(t) b for t from t0 to t1 as a
+ * rational quadratic NURBS with one span per quarter turn.  This is
+ * exact for circles and ellipses under any affine transform.
+ */
+static void
+wire_conic(struct dxf_import *ctx, const point_t c, const vect_t a, const vect_t b, fastf_t t0, fastf_t t1)
 {
-    if (!polyline_verts) {
-	polyline_verts = (fastf_t *)bu_malloc(POLYLINE_VERTEX_BLOCK*3*sizeof(fastf_t), "polyline_verts");
-	polyline_vertex_count = 0;
-	polyline_vertex_max = POLYLINE_VERTEX_BLOCK;
-    } else if (polyline_vertex_count >= polyline_vertex_max) {
-	polyline_vertex_max += POLYLINE_VERTEX_BLOCK;
-	polyline_verts = (fastf_t *)bu_realloc(polyline_verts, polyline_vertex_max * 3 * sizeof(fastf_t), "polyline_verts");
-    }
+    int nspans = (int)ceil((t1 - t0) / M_PI_2 - 1.0e-9);
+    fastf_t dt, w;
+    fastf_t *ctl, *weights, *knots;
+    int c_size, k_size;
+    int i;
+
+    V_MAX(nspans, 1);
+    dt = (t1 - t0) / (fastf_t)nspans;
+    w = cos(dt / 2.0);
+    c_size = 2 * nspans + 1;
+    k_size = c_size + 3;
+
+    ctl = (fastf_t *)bu_malloc(c_size * 3 * sizeof(fastf_t), "conic ctl");
+    weights = (fastf_t *)bu_malloc(c_size * sizeof(fastf_t), "conic weights");
+    knots = (fastf_t *)bu_malloc(k_size * sizeof(fastf_t), "conic knots");
 
-    VSET(&polyline_verts[polyline_vertex_count*3], x, y, z);
-    polyline_vertex_count++;
+    /* odd points are where the end tangents of a span meet */
+    for (i = 0; i < c_size; i++) {
+	fastf_t t = t0 + dt * (fastf_t)i / 2.0;
+	fastf_t r = (i & 1) ? 1.0 / w : 1.0;
 
-    if (verbose) {
-	bu_log("Added polyline vertex (%g %g %g) #%d\n", x, y, z, polyline_vertex_count);
+	VJOIN2(&ctl[i*3], c, r * cos(t), a, r * sin(t), b);
+	weights[i] = (i & 1) ? w : 1.0;
     }
+
+    knots[0] = knots[1] = knots[2] = 0.0;
+    for (i = 1; i < nspans; i++) {
+	knots[2*i + 1] = knots[2*i + 2] = (fastf_t)i / (fastf_t)nspans;
+    }
+    knots[k_size - 3] = knots[k_size - 2] = knots[k_size - 1] = 1.0;
+
+    wire_nurb(ctx, 3, c_size, ctl, weights, k_size, knots);
+
+    bu_free(ctl, "conic ctl");
+    bu_free(weights, "conic weights");
+    bu_free(knots, "conic knots");
 }
 
 
+/*
+ * Whether m maps the XY plane onto itself as a rotation and uniform
+ * scale, possibly mirrored.  Such a transform keeps circles circles.
+ */
 static int
-process_point_entities_code(int code)
+xform_similar_xy(const mat_t m, fastf_t *scale, int *mirror)
 {
-    static point_t pt;
-    point_t tmp_pt;
-    int coord;
+    static const vect_t x_axis = {1.0, 0.0, 0.0};
+    static const vect_t y_axis = {0.0, 1.0, 0.0};
+    vect_t ex, ey;
+
+    MAT4X3VEC(ex, m, x_axis);
+    MAT4X3VEC(ey, m, y_axis);
+    *scale = MAGNITUDE(ex);
+    *mirror = (ex[X] * ey[Y] - ex[Y] * ey[X]) < 0.0;
+
+    return NEAR_EQUAL(*scale, MAGNITUDE(ey), *scale * 1.0e-9) &&
+	NEAR_ZERO(VDOT(ex, ey), *scale * *scale * 1.0e-9) &&
+	NEAR_ZERO(ex[Z], *scale * 1.0e-9) && NEAR_ZERO(ey[Z], *scale * 1.0e-9);
+}
 
-    switch (code) {
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	    coord = code / 10 - 1;
-	    pt[coord] = atof(line) * units_conv[units] * scale_factor;
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    get_layer();
-	    layers[curr_layer]->point_count++;
-	    MAT4X3PNT(tmp_pt, curr_state->xform, pt);
-	    sprintf(tmp_name, "point.%lu", (long unsigned int)layers[curr_layer]->point_count);
-	    (void)mk_sph(out_fp, tmp_name, tmp_pt, 0.1);
-	    (void)bu_ptbl_ins(&(layers[curr_layer]->solids), (long *)bu_strdup(tmp_name));
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+
+/*
+ * Add a counterclockwise circular arc from t0 to t1 (radians), or a
+ * full circle if the arc spans 2pi.  Under a rotation and uniform
+ * scale the result is a carc_seg; any other transform would make it
+ * an ellipse, so it becomes a NURBS instead.
+ */
+static void
+wire_arc(struct dxf_import *ctx, const point_t center, fastf_t radius, fastf_t t0, fastf_t t1)
+{
+    struct wire_curve *crv;
+    vect_t a, b;
+    point_t c, p;
+    fastf_t scale;
+    int start, end;
+    int cw;
+
+    if (!xform_similar_xy(ctx->curr_state->xform, &scale, &cw)) {
+	VSET(a, radius, 0.0, 0.0);
+	VSET(b, 0.0, radius, 0.0);
+	wire_conic(ctx, center, a, b, t0, t1);
+	return;
     }
 
-    return 0;
+    VSET(p, center[X] + radius * cos(t0), center[Y] + radius * sin(t0), center[Z]);
+    MAT4X3PNT(c, ctx->curr_state->xform, p);
+    start = wire_point(ctx, c);
+
+    if (t1 - t0 >= M_2PI - 1.0e-9) {
+	MAT4X3PNT(c, ctx->curr_state->xform, center);
+	end = wire_point(ctx, c);
+	crv = wire_curve(ctx, CURVE_CARC_MAGIC);
+	crv->radius = -radius * scale;
+    } else {
+	VSET(p, center[X] + radius * cos(t1), center[Y] + radius * sin(t1), center[Z]);
+	MAT4X3PNT(c, ctx->curr_state->xform, p);
+	end = wire_point(ctx, c);
+	crv = wire_curve(ctx, CURVE_CARC_MAGIC);
+	crv->radius = radius * scale;
+	crv->orientation = cw;
+	/* the center is left of the chord for a short counterclockwise arc */
+	crv->center_is_left = (t1 - t0 <= M_PI) ? !cw : cw;
+    }
+    crv->start = start;
+    crv->end = end;
 }
 
 
-static int
-process_entities_polyline_vertex_code(int code)
+/* largest scale m applies to any direction */
+static fastf_t
+xform_scale(const mat_t m)
 {
-    static fastf_t x, y, z;
-    static int face[4];
-    static int vertex_flag;
-    int coord;
+    vect_t col;
+    fastf_t scale = 0.0;
+    int i;
 
-    switch (code) {
-	case -1:	/* initialize */
-	    face[0] = 0;
-	    face[1] = 0;
-	    face[2] = 0;
-	    face[3] = 0;
-	    vertex_flag = 0;
-	    return 0;
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 70:	/* vertex flag */
-	    vertex_flag = atoi(line);
-	    break;
-	case 71:
-	case 72:
-	case 73:
-	case 74:
-	    coord = (code % 70) - 1;
-	    face[coord] = abs(atoi(line));
-	    break;
-	case 0:
-	    get_layer();
-	    if (vertex_flag == POLY_VERTEX_FACE) {
-		add_triangle(polyline_vert_indices[face[0]-1],
-			     polyline_vert_indices[face[1]-1],
-			     polyline_vert_indices[face[2]-1],
-			     curr_layer);
-		if (face[3] > 0) {
-		    add_triangle(polyline_vert_indices[face[2]-1],
-				 polyline_vert_indices[face[3]-1],
-				 polyline_vert_indices[face[0]-1],
-				 curr_layer);
-		}
-	    } else if (vertex_flag & POLY_VERTEX_3D_M) {
-		point_t tmp_pt1, tmp_pt2;
-		if (polyline_vert_indices_count >= polyline_vert_indices_max) {
-		    polyline_vert_indices_max += POLYLINE_VERTEX_BLOCK;
-		    polyline_vert_indices = (int *)bu_realloc(polyline_vert_indices,
-							      polyline_vert_indices_max * sizeof(int),
-							      "polyline_vert_indices");
-		}
-		VSET(tmp_pt1, x, y, z);
-		MAT4X3PNT(tmp_pt2, curr_state->xform, tmp_pt1);
-		polyline_vert_indices[polyline_vert_indices_count++] = bn_vert_tree_add(layers[curr_layer]->vert_tree, tmp_pt2[X], tmp_pt2[Y], tmp_pt2[Z], tol_sq);
-		if (verbose) {
-		    bu_log("Added 3D mesh vertex (%g %g %g) index = %d, number = %d\n",
-			   x, y, z, polyline_vert_indices[polyline_vert_indices_count-1],
-			   polyline_vert_indices_count-1);
-		}
-	    } else {
-		add_polyline_vertex(x, y, z);
-	    }
-	    curr_state->sub_state = POLYLINE_ENTITY_STATE;
-	    if (verbose) {
-		bu_log("sub_state changed to %d\n", curr_state->sub_state);
-	    }
-	    return process_entities_code[curr_state->sub_state](code);
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 10:
-	    x = atof(line) * units_conv[units] * scale_factor;
-	    break;
-	case 20:
-	    y = atof(line) * units_conv[units] * scale_factor;
-	    break;
-	case 30:
-	    z = atof(line) * units_conv[units] * scale_factor;
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
+    for (i = 0; i < 3; i++) {
+	VSET(col, m[i], m[4+i], m[8+i]);
+	V_MAX(scale, MAGNITUDE(col));
     }
 
-    return 0;
+    return scale;
 }
 
 
+/*
+ * Number of chords for sweep radians of a curve whose radius of
+ * curvature is at most radius (in output space), so that no chord
+ * strays further than the chord error from the curve.  Without a
+ * chord error this is the fixed count.  Both counts are tallied for
+ * the layer summary.
+ */
 static int
-process_entities_polyline_code(int code)
+curve_segments(struct dxf_import *ctx, fastf_t radius, fastf_t sweep, int fixed)
 {
+    fastf_t err = ctx->chord_error * units_conv[ctx->units] * ctx->scale_factor;
+    int nsegs = fixed;
 
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    get_layer();
-	    if (!bu_strncmp(line, "SEQEND", 6)) {
-		/* build any polyline meshes here */
-		if (polyline_flag & POLY_3D_MESH) {
-		    if (polyline_vert_indices_count == 0) {
-			return 0;
-		    } else if (polyline_vert_indices_count != mesh_m_count * mesh_n_count) {
-			bu_log("Incorrect number of vertices for polygon mesh!!!\n");
-			polyline_vert_indices_count = 0;
-		    } else {
-			int i, j;
-
-			if (polyline_vert_indices_count >= polyline_vert_indices_max) {
-			    polyline_vert_indices_max = ((polyline_vert_indices_count % POLYLINE_VERTEX_BLOCK) + 1) *
-				POLYLINE_VERTEX_BLOCK;
-			    polyline_vert_indices = (int *)bu_realloc(polyline_vert_indices,
-								      polyline_vert_indices_max * sizeof(int),
-								      "polyline_vert_indices");
-			}
-
-			if (mesh_m_count < 2) {
-			    if (mesh_n_count > 4) {
-				bu_log("Cannot handle polyline meshes with m<2 and n>4\n");
-				polyline_vert_indices_count = 0;
-				polyline_vert_indices_count = 0;
-				break;
-			    }
-			    if (mesh_n_count < 3) {
-				polyline_vert_indices_count = 0;
-				polyline_vert_indices_count = 0;
-				break;
-			    }
-			    add_triangle(polyline_vert_indices[0],
-					 polyline_vert_indices[1],
-					 polyline_vert_indices[2],
-					 curr_layer);
-			    if (mesh_n_count == 4) {
-				add_triangle(polyline_vert_indices[2],
-					     polyline_vert_indices[3],
-					     polyline_vert_indices[0],
-					     curr_layer);
-			    }
-			}
-
-			for (j = 1; j < mesh_n_count; j++) {
-			    for (i = 1; i < mesh_m_count; i++) {
-				add_triangle(polyline_vert_indices[PVINDEX(i-1, j-1)],
-					     polyline_vert_indices[PVINDEX(i-1, j)],
-					     polyline_vert_indices[PVINDEX(i, j-1)],
-					     curr_layer);
-				add_triangle(polyline_vert_indices[PVINDEX(i-1, j-1)],
-					     polyline_vert_indices[PVINDEX(i, j-1)],
-					     polyline_vert_indices[PVINDEX(i, j)],
-					     curr_layer);
-			    }
-			}
-			polyline_vert_indices_count = 0;
-			polyline_vertex_count = 0;
-		    }
-		} else {
-		    struct edgeuse *eu;
-		    struct vertex *v0 = NULL, *v1 = NULL, *v2 = NULL;
+    if (err > SMALL_FASTF) {
+	int min_segs = (sweep > M_PI) ? 3 : 1;
 
-		    if (polyline_vertex_count > 1) {
-			int i;
+	if (err >= radius) {
+	    nsegs = min_segs;
+	} else {
+	    nsegs = (int)ceil(sweep / (2.0 * acos(1.0 - err / radius)) - 1.0e-9);
+	    V_MAX(nsegs, min_segs);
+	    V_MIN(nsegs, CURVE_MAX_SEGS);
+	}
+    }
+    V_MAX(nsegs, 1);
 
-			if (!layers[curr_layer]->m) {
-			    create_nmg();
-			}
+    ctx->layers[ctx->curr_layer]->curve_segs_fixed += fixed;
+    ctx->layers[ctx->curr_layer]->curve_segs += nsegs;
 
-			for (i = 0; i < polyline_vertex_count-1; i++) {
-			    eu = nmg_me(v1, v2, layers[curr_layer]->s);
-			    if (i == 0) {
-				v1 = eu->vu_p->v_p;
-				nmg_vertex_gv(v1, polyline_verts);
-				v0 = v1;
-			    }
-			    v2 = eu->eumate_p->vu_p->v_p;
-			    nmg_vertex_gv(v2, &polyline_verts[(i+1)*3]);
-			    if (verbose) {
-				bu_log("Wire edge (polyline): (%g %g %g) <-> (%g %g %g)\n",
-				       V3ARGS(v1->vg_p->coord),
-				       V3ARGS(v2->vg_p->coord));
-			    }
-			    v1 = v2;
-			    v2 = NULL;
-			}
+    return nsegs;
+}
 
-			if (polyline_flag & POLY_CLOSED) {
-			    v2 = v0;
-			    (void)nmg_me(v1, v2, layers[curr_layer]->s);
-			    if (verbose) {
-				bu_log("Wire edge (closing polyline): (%g %g %g) <-> (%g %g %g)\n",
-				       V3ARGS(v1->vg_p->coord),
-				       V3ARGS(v2->vg_p->coord));
-			    }
-			}
-		    }
-		    polyline_vert_indices_count = 0;
-		    polyline_vertex_count = 0;
-		}
 
-		layers[curr_layer]->polyline_count++;
-		curr_state->state = ENTITIES_SECTION;
-		curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "VERTEX", 6)) {
-		if (verbose)
-		    bu_log("Found a POLYLINE VERTEX\n");
-		curr_state->sub_state = POLYLINE_VERTEX_ENTITY_STATE;
-		process_entities_code[POLYLINE_VERTEX_ENTITY_STATE](-1);
-		break;
-	    } else {
-		if (verbose) {
-		    bu_log("Unrecognized text string while in polyline entity: %s\n", line);
-		}
-		break;
-	    }
-	case 70:	/* polyline flag */
-	    polyline_flag = atoi(line);
-	    break;
-	case 71:
-	    mesh_m_count = atoi(line);
-	    break;
-	case 72:
-	    mesh_n_count = atoi(line);
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 60:
-	    invisible = atoi(line);
-	    break;
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
+static fastf_t
+chord_dist_sq(const fastf_t *a, const fastf_t *b, const fastf_t *p)
+{
+    vect_t ab, ap;
+    fastf_t len_sq, t;
+
+    VSUB2(ab, b, a);
+    VSUB2(ap, p, a);
+    len_sq = MAGSQ(ab);
+    if (len_sq < SMALL_FASTF) {
+	return MAGSQ(ap);
     }
+    t = VDOT(ap, ab) / len_sq;
+    CLAMP(t, 0.0, 1.0);
+    VJOIN1(ap, a, t, ab);
 
-    return 0;
+    return DIST_PNT_PNT_SQ(ap, p);
 }
 
 
-static int
-process_entities_unknown_code(int code)
-{
-    struct state_data *tmp_state;
+/*
+ * SPLINE evaluation.  A spline is turned into a run of Bezier pieces
+ * once, from the knot spans of its B-spline or by interpolating its
+ * fit points, and each piece is then either sampled at the fixed
+ * parameters falling inside it or flattened by de Casteljau
+ * subdivision until its control polygon lies within the chord error
+ * of its chord.  Control points are homogeneous (wx, wy, wz, w) so
+ * rational splines need no special case.
+ */
+#define SPLINE_MAX_DEGREE 25
+#define SPLINE_MAX_DEPTH 16
+
+struct bezier_set {
+    int degree;
+    int count;			/* pieces */
+    fastf_t *breaks;		/* count+1 parameters where pieces meet */
+    fastf_t *ctl;		/* (degree+1)*4 per piece */
+};
 
-    invisible = 0;
 
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "POLYLINE", 8)) {
-		if (verbose)
-		    bu_log("Found a POLYLINE\n");
-		curr_state->sub_state = POLYLINE_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "LWPOLYLINE", 10)) {
-		if (verbose)
-		    bu_log("Found a LWPOLYLINE\n");
-		curr_state->sub_state = LWPOLYLINE_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "3DFACE", 6)) {
-		curr_state->sub_state = FACE3D_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "CIRCLE")) {
-		curr_state->sub_state = CIRCLE_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "ELLIPSE")) {
-		curr_state->sub_state = ELLIPSE_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "SPLINE")) {
-		curr_state->sub_state = SPLINE_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "ARC")) {
-		curr_state->sub_state = ARC_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "DIMENSION")) {
-		curr_state->sub_state = DIMENSION_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "LINE", 4)) {
-		curr_state->sub_state = LINE_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "POINT")) {
-		curr_state->sub_state = POINT_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "LEADER")) {
-		curr_state->sub_state = LEADER_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "MTEXT")) {
-		curr_state->sub_state = MTEXT_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "TEXT")) {
-		curr_state->sub_state = TEXT_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "ATTRIB")) {
-		curr_state->sub_state = ATTRIB_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "ATTDEF")) {
-		curr_state->sub_state = ATTDEF_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "SOLID")) {
-		curr_state->sub_state = SOLID_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (!bu_strncmp(line, "VIEWPORT", 8)) {
-		/* not a useful entity, just ignore it */
-		break;
-	    } else if (!bu_strncmp(line, "INSERT", 6)) {
-		curr_state->sub_state = INSERT_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("sub_state changed to %d\n", curr_state->sub_state);
-		}
-		break;
-	    } else if (BU_STR_EQUAL(line, "ENDBLK")) {
-		/* found end of an inserted block, pop the state stack */
-		tmp_state = curr_state;
-		BU_LIST_POP(state_data, &state_stack, curr_state);
-		if (!curr_state) {
-		    bu_log("ERROR: end of block encountered while not inserting!!!\n");
-		    curr_state = tmp_state;
-		    break;
-		}
-		bu_free((char *)tmp_state, "curr_state");
-		bu_fseek(dxf, curr_state->file_offset, SEEK_SET);
-		curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("Popped state at end of inserted block (seeked to %jd)\n", (intmax_t)curr_state->file_offset);
-		}
-		break;
-	    } else {
-		bu_log("Unrecognized entity type encountered (ignoring): %s\n",
-		       line);
-		break;
-	    }
-    }
+static void
+bezier_set_alloc(struct bezier_set *bs, int degree, int count)
+{
+    bs->degree = degree;
+    bs->count = count;
+    bs->breaks = (fastf_t *)bu_malloc((count + 1) * sizeof(fastf_t), "bezier breaks");
+    bs->ctl = (fastf_t *)bu_malloc(count * (degree + 1) * 4 * sizeof(fastf_t), "bezier ctl");
+}
 
-    return 0;
+
+static void
+bezier_set_free(struct bezier_set *bs)
+{
+    bu_free(bs->breaks, "bezier breaks");
+    bu_free(bs->ctl, "bezier ctl");
 }
 
 
+/* out = a p + b q for homogeneous points, out may be p or q */
 static void
-insert_init(struct insert_data *ins)
+hblend(fastf_t *out, fastf_t a, const fastf_t *p, fastf_t b, const fastf_t *q)
 {
-    VSETALL(ins->scale, 1.0);
-    ins->rotation = 0.0;
-    VSETALL(ins->insert_pt, 0.0);
-    VSET(ins->extrude_dir, 0, 0, 1);
+    out[0] = a * p[0] + b * q[0];
+    out[1] = a * p[1] + b * q[1];
+    out[2] = a * p[2] + b * q[2];
+    out[3] = a * p[3] + b * q[3];
 }
 
 
-static int
-process_insert_entities_code(int code)
+/*
+ * Blossom of the degree p B-spline at t[0..p-1], using the control
+ * points of knot span k: de Boor's algorithm with a different
+ * parameter at each level.
+ */
+static void
+spline_blossom(int p, int k, const fastf_t *knots, const fastf_t *pw, const fastf_t *t, fastf_t *out)
 {
-    static struct insert_data ins;
-    static struct state_data *new_state=NULL;
-    struct block_list *blk;
-    int coord;
+    fastf_t d[(SPLINE_MAX_DEGREE + 1) * 4];
+    int r, j;
 
-    if (!new_state) {
-	insert_init(&ins);
-	BU_ALLOC(new_state, struct state_data);
-	*new_state = *curr_state;
-	if (verbose) {
-	    bu_log("Created a new state for INSERT\n");
+    memcpy(d, &pw[(k - p) * 4], (p + 1) * 4 * sizeof(fastf_t));
+    for (r = 1; r <= p; r++) {
+	for (j = p; j >= r; j--) {
+	    int g = k - p + j;
+	    fastf_t denom = knots[g + p + 1 - r] - knots[g];
+	    fastf_t alpha = (denom > SMALL_FASTF) ? (t[r-1] - knots[g]) / denom : 0.0;
+
+	    hblend(&d[j*4], 1.0 - alpha, &d[(j-1)*4], alpha, &d[j*4]);
 	}
     }
+    HMOVE(out, &d[p*4]);
+}
 
-    switch (code) {
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 2:		/* block name */
-	    for (BU_LIST_FOR(blk, block_list, &block_head)) {
-		if (BU_STR_EQUAL(blk->block_name, line)) {
-		    break;
-		}
-	    }
-	    if (BU_LIST_IS_HEAD(blk, &block_head)) {
-		bu_log("ERROR: INSERT references non-existent block (%s)\n", line);
-		bu_log("\tignoring missing block\n");
-		blk = NULL;
-	    }
-	    new_state->curr_block = blk;
-	    if (verbose && blk) {
-		bu_log("Inserting block %s\n", blk->block_name);
-	    }
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	    coord = (code / 10) - 1;
-	    ins.insert_pt[coord] = atof(line);
-	    break;
-	case 41:
-	case 42:
-	case 43:
-	    coord = (code % 40) - 1;
-	    ins.scale[coord] = atof(line);
-	    break;
-	case 50:
-	    ins.rotation = atof(line);
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 70:
-	case 71:
-	    if (atoi(line) != 1) {
-		bu_log("Cannot yet handle insertion of a pattern\n\tignoring\n");
-	    }
-	    break;
-	case 44:
-	case 45:
-	    break;
-	case 210:
-	case 220:
-	case 230:
-	    coord = ((code / 10) % 20) - 1;
-	    ins.extrude_dir[coord] = atof(line);
-	    break;
-	case 0:		/* end of this insert */
-	    if (new_state->curr_block) {
-		mat_t xlate, scale, rot, tmp1, tmp2;
-		MAT_IDN(xlate);
-		MAT_IDN(scale);
-		MAT_SCALE_VEC(scale, ins.scale);
-		MAT_DELTAS_VEC(xlate, ins.insert_pt);
-		bn_mat_angles(rot, 0.0, 0.0, ins.rotation);
-		bn_mat_mul(tmp1, rot, scale);
-		bn_mat_mul(tmp2, xlate, tmp1);
-		bn_mat_mul(new_state->xform, tmp2, curr_state->xform);
-		BU_LIST_PUSH(&state_stack, &(curr_state->l));
-		curr_state = new_state;
-		new_state = NULL;
-		bu_fseek(dxf, curr_state->curr_block->offset, SEEK_SET);
-		curr_state->state = ENTITIES_SECTION;
-		curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-		if (verbose) {
-		    bu_log("Changing state for INSERT\n");
-		    bu_log("seeked to %jd\n", (intmax_t)curr_state->curr_block->offset);
-		    bn_mat_print("state xform", curr_state->xform);
-		}
-	    }
-	    break;
+
+/* whether the first and the last order knots are each all the same */
+static int
+knots_clamped(const fastf_t *knots, int k_size, int order)
+{
+    fastf_t tol = (knots[k_size - 1] - knots[0]) * 1.0e-12;
+    int i;
+
+    for (i = 1; i < order; i++) {
+	if (knots[i] - knots[0] > tol || knots[k_size - 1] - knots[k_size - 1 - i] > tol) {
+	    return 0;
+	}
     }
 
-    return 0;
+    return 1;
 }
 
 
+/*
+ * Bezier pieces of a B-spline, one per non-empty knot span of its
+ * domain, in the space of its control points.  Returns non-zero for
+ * a malformed spline.
+ */
 static int
-process_solid_entities_code(int code)
+spline_from_bspline(const struct spline_entity *ent, struct bezier_set *bs)
 {
-    int vert_no;
-    int coord;
-    point_t tmp_pt;
-    struct vertex *v0, *v1;
-    static int last_vert_no = -1;
-    static point_t solid_pt[4];
+    int p = ent->degree;
+    int n = ent->numCtlPts;
+    int rational = (ent->flag & SPLINE_RATIONAL) && ent->weightCount >= n;
+    fastf_t *pw;
+    fastf_t t[SPLINE_MAX_DEGREE];
+    int count = 0;
+    int i, k;
+
+    if (p < 1 || p > SPLINE_MAX_DEGREE || n <= p || !ent->ctlPts || !ent->knots ||
+	ent->numKnots != n + p + 1 || ent->knotCount < ent->numKnots || ent->ctlPtCount < n) {
+	return 1;
+    }
+    for (i = 1; i < ent->numKnots; i++) {
+	if (ent->knots[i] < ent->knots[i-1]) {
+	    return 1;
+	}
+    }
+    for (k = p; k < n; k++) {
+	if (ent->knots[k+1] > ent->knots[k]) {
+	    count++;
+	}
+    }
+    if (!count) {
+	return 1;
+    }
 
-    switch (code) {
-	case 8:
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    if (verbose) {
-		bu_log("LINE is in layer: %s\n", curr_layer_name);
-	    }
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	case 11:
-	case 21:
-	case 31:
-	case 12:
-	case 22:
-	case 32:
-	case 13:
-	case 23:
-	case 33:
-	    vert_no = code % 10;
-	    V_MAX(last_vert_no, vert_no);
+    pw = (fastf_t *)bu_malloc(n * 4 * sizeof(fastf_t), "spline pw");
+    for (i = 0; i < n; i++) {
+	fastf_t w = rational ? ent->weights[i] : 1.0;
 
-	    coord = code / 10 - 1;
-	    solid_pt[vert_no][coord] = atof(line) * units_conv[units] * scale_factor;
-	    if (verbose) {
-		bu_log("SOLID vertex #%d coord #%d = %g\n", vert_no, coord, solid_pt[vert_no][coord]);
-	    }
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    /* end of this solid */
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found end of SOLID\n");
-	    }
+	VSCALE(&pw[i*4], &ent->ctlPts[i*3], w);
+	pw[i*4 + 3] = w;
+    }
 
-	    layers[curr_layer]->solid_count++;
+    bezier_set_alloc(bs, p, count);
+    count = 0;
+    for (k = p; k < n; k++) {
+	fastf_t a = ent->knots[k], b = ent->knots[k+1];
+	fastf_t *q = &bs->ctl[count * (p + 1) * 4];
 
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
-	    }
+	if (b <= a) {
+	    continue;
+	}
 
-	    v0 = NULL;
-	    v1 = NULL;
-	    for (vert_no = 0; vert_no <= last_vert_no; vert_no ++) {
-		MAT4X3PNT(tmp_pt, curr_state->xform, solid_pt[vert_no]);
-		VMOVE(solid_pt[vert_no], tmp_pt);
+	/* the i-th Bezier point is the blossom at (a, ..., a, b, ..., b) with i b's */
+	for (i = 0; i <= p; i++) {
+	    int j;
 
-		if (vert_no > 0) {
-		    struct edgeuse *eu;
-		    /* create a wire edge in the NMG */
-		    eu = nmg_me(v1, NULL, layers[curr_layer]->s);
-		    if (v1 == NULL) {
-			nmg_vertex_gv(eu->vu_p->v_p, solid_pt[vert_no - 1]);
-			v0 = eu->vu_p->v_p;
-		    }
-		    nmg_vertex_gv(eu->eumate_p->vu_p->v_p, solid_pt[vert_no]);
-		    v1 = eu->eumate_p->vu_p->v_p;
-		    if (verbose) {
-			bu_log("Wire edge (solid): (%g %g %g) <-> (%g %g %g)\n",
-			       V3ARGS(eu->vu_p->v_p->vg_p->coord),
-			       V3ARGS(eu->eumate_p->vu_p->v_p->vg_p->coord));
-		    }
-		}
+	    for (j = 0; j < p; j++) {
+		t[j] = (j < p - i) ? a : b;
 	    }
-
-	    /* close the outline */
-	    nmg_me(v1, v0, layers[curr_layer]->s);
-
-	    last_vert_no = -1;
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+	    spline_blossom(p, k, ent->knots, pw, t, &q[i*4]);
+	}
+	bs->breaks[count] = a;
+	bs->breaks[++count] = b;
     }
 
+    bu_free(pw, "spline pw");
     return 0;
 }
 
 
+/*
+ * Cubic pieces through the fit points, with chord length parameters
+ * and continuous second derivatives.  The given end tangents are
+ * used, otherwise the ends are natural.  Returns non-zero if there
+ * are too few distinct points.
+ */
 static int
-process_lwpolyline_entities_code(int code)
+spline_from_fit(const struct spline_entity *ent, struct bezier_set *bs)
 {
-    point_t tmp_pt;
-    static int vert_no = 0;
-    static fastf_t x, y;
-
-    switch (code) {
-	case 8:
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    if (verbose) {
-		bu_log("LINE is in layer: %s\n", curr_layer_name);
-	    }
-	    break;
-	case 90:
-	    /* oops */
-	    break;
-	case 10:
-	    x = atof(line) * units_conv[units] * scale_factor;
-	    if (verbose) {
-		bu_log("LWPolyLine vertex #%d (x) = %g\n", vert_no, x);
-	    }
-	    break;
-	case 20:
-	    y = atof(line) * units_conv[units] * scale_factor;
-	    if (verbose) {
-		bu_log("LWPolyLine vertex #%d (y) = %g\n", vert_no, y);
-	    }
-	    add_polyline_vertex(x, y, 0.0);
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 70:
-	    polyline_flag = atoi(line);
-	    break;
-	case 0:
-	    /* end of this line */
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found end of LWPOLYLINE\n");
-	    }
-
-	    layers[curr_layer]->lwpolyline_count++;
+    int n = ent->fitPtCount;
+    const fastf_t *pts = ent->fitPts;
+    fastf_t *h, *m, *c, *rhs;
+    int i;
 
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
-	    }
+    if (n < 2 || !pts) {
+	return 1;
+    }
 
-	    if (polyline_vertex_count > 1) {
-		struct vertex *v0=NULL, *v1=NULL, *v2=NULL;
-		int i;
+    h = (fastf_t *)bu_malloc(n * sizeof(fastf_t), "fit h");
+    m = (fastf_t *)bu_malloc(n * 3 * sizeof(fastf_t), "fit m");
+    c = (fastf_t *)bu_malloc(n * sizeof(fastf_t), "fit c");
+    rhs = (fastf_t *)bu_malloc(n * 3 * sizeof(fastf_t), "fit rhs");
+
+    for (i = 0; i < n - 1; i++) {
+	h[i] = DIST_PNT_PNT(&pts[i*3], &pts[(i+1)*3]);
+	if (h[i] < SMALL_FASTF) {
+	    bu_free(h, "fit h");
+	    bu_free(m, "fit m");
+	    bu_free(c, "fit c");
+	    bu_free(rhs, "fit rhs");
+	    return 1;
+	}
+    }
 
-		if (!layers[curr_layer]->m) {
-		    create_nmg();
-		}
+    /* tridiagonal system for the first derivatives m[i], solved by the Thomas algorithm */
+    for (i = 0; i < n; i++) {
+	fastf_t lower = 0.0, diag, upper = 0.0;
+	vect_t r;
 
-		for (i = 0; i < polyline_vertex_count; i++) {
-		    MAT4X3PNT(tmp_pt, curr_state->xform, &polyline_verts[i*3]);
-		    VMOVE(&polyline_verts[i*3], tmp_pt);
-		}
+	if (i == 0) {
+	    if (ent->tanFlags & SPLINE_START_TANGENT) {
+		diag = 1.0;
+		VMOVE(r, ent->startTan);
+	    } else {
+		diag = 2.0;
+		upper = 1.0;
+		VSUB2(r, &pts[3], &pts[0]);
+		VSCALE(r, r, 3.0 / h[0]);
+	    }
+	} else if (i == n - 1) {
+	    if (ent->tanFlags & SPLINE_END_TANGENT) {
+		diag = 1.0;
+		VMOVE(r, ent->endTan);
+	    } else {
+		lower = 1.0;
+		diag = 2.0;
+		VSUB2(r, &pts[i*3], &pts[(i-1)*3]);
+		VSCALE(r, r, 3.0 / h[i-1]);
+	    }
+	} else {
+	    vect_t d0, d1;
+
+	    lower = h[i];
+	    diag = 2.0 * (h[i-1] + h[i]);
+	    upper = h[i-1];
+	    VSUB2(d0, &pts[i*3], &pts[(i-1)*3]);
+	    VSUB2(d1, &pts[(i+1)*3], &pts[i*3]);
+	    VCOMB2(r, 3.0 * h[i] / h[i-1], d0, 3.0 * h[i-1] / h[i], d1);
+	}
 
-		for (i = 0; i < polyline_vertex_count-1; i++) {
-		    struct edgeuse *eu;
+	if (i > 0) {
+	    fastf_t f = diag - lower * c[i-1];
 
-		    eu = nmg_me(v1, v2, layers[curr_layer]->s);
-		    if (i == 0) {
-			v1 = eu->vu_p->v_p;
-			nmg_vertex_gv(v1, polyline_verts);
-			v0 = v1;
-		    }
-		    v2 = eu->eumate_p->vu_p->v_p;
-		    nmg_vertex_gv(v2, &polyline_verts[(i+1)*3]);
-		    if (verbose) {
-			bu_log("Wire edge (lwpolyline): (%g %g %g) <-> (%g %g %g)\n",
-			       V3ARGS(v1->vg_p->coord),
-			       V3ARGS(v2->vg_p->coord));
-		    }
-		    v1 = v2;
-		    v2 = NULL;
-		}
+	    c[i] = upper / f;
+	    VJOIN1(&rhs[i*3], r, -lower, &rhs[(i-1)*3]);
+	    VSCALE(&rhs[i*3], &rhs[i*3], 1.0 / f);
+	} else {
+	    c[i] = upper / diag;
+	    VSCALE(&rhs[i*3], r, 1.0 / diag);
+	}
+    }
+    VMOVE(&m[(n-1)*3], &rhs[(n-1)*3]);
+    for (i = n - 2; i >= 0; i--) {
+	VJOIN1(&m[i*3], &rhs[i*3], -c[i], &m[(i+1)*3]);
+    }
 
-		if (polyline_flag & POLY_CLOSED) {
-		    v2 = v0;
-		    (void)nmg_me(v1, v2, layers[curr_layer]->s);
-		    if (verbose) {
-			bu_log("Wire edge (closing lwpolyline): (%g %g %g) <-> (%g %g %g)\n",
-			       V3ARGS(v1->vg_p->coord),
-			       V3ARGS(v2->vg_p->coord));
-		    }
-		}
-	    }
-	    polyline_vert_indices_count = 0;
-	    polyline_vertex_count = 0;
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+    bezier_set_alloc(bs, 3, n - 1);
+    bs->breaks[0] = 0.0;
+    for (i = 0; i < n - 1; i++) {
+	fastf_t *q = &bs->ctl[i * 16];
+
+	VMOVE(&q[0], &pts[i*3]);
+	VJOIN1(&q[4], &pts[i*3], h[i] / 3.0, &m[i*3]);
+	VJOIN1(&q[8], &pts[(i+1)*3], -h[i] / 3.0, &m[(i+1)*3]);
+	VMOVE(&q[12], &pts[(i+1)*3]);
+	q[3] = q[7] = q[11] = q[15] = 1.0;
+	bs->breaks[i+1] = bs->breaks[i] + h[i];
     }
 
+    bu_free(h, "fit h");
+    bu_free(m, "fit m");
+    bu_free(c, "fit c");
+    bu_free(rhs, "fit rhs");
     return 0;
 }
 
 
-static int
-process_line_entities_code(int code)
+/* the point at u in [0, 1] of a Bezier piece, by de Casteljau */
+static void
+bezier_point(int p, const fastf_t *q, fastf_t u, fastf_t *pt)
 {
-    int vert_no;
-    int coord;
-    static point_t line_pt[2];
-    struct edgeuse *eu;
-    point_t tmp_pt;
-
-    switch (code) {
-	case 8:
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    if (verbose) {
-		bu_log("LINE is in layer: %s\n", curr_layer_name);
-	    }
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	case 11:
-	case 21:
-	case 31:
-	    vert_no = code % 10;
-	    coord = code / 10 - 1;
-	    line_pt[vert_no][coord] = atof(line) * units_conv[units] * scale_factor;
-	    if (verbose) {
-		bu_log("LINE vertex #%d coord #%d = %g\n", vert_no, coord, line_pt[vert_no][coord]);
-	    }
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    /* end of this line */
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found end of LINE\n");
-	    }
+    fastf_t d[(SPLINE_MAX_DEGREE + 1) * 4];
+    int r, j;
 
-	    layers[curr_layer]->line_count++;
+    memcpy(d, q, (p + 1) * 4 * sizeof(fastf_t));
+    for (r = 1; r <= p; r++) {
+	for (j = 0; j <= p - r; j++) {
+	    hblend(&d[j*4], 1.0 - u, &d[j*4], u, &d[(j+1)*4]);
+	}
+    }
+    VSCALE(pt, d, 1.0 / d[3]);
+}
 
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
-	    }
 
-	    MAT4X3PNT(tmp_pt, curr_state->xform, line_pt[0]);
-	    VMOVE(line_pt[0], tmp_pt);
-	    MAT4X3PNT(tmp_pt, curr_state->xform, line_pt[1]);
-	    VMOVE(line_pt[1], tmp_pt);
+/*
+ * Emit chords for a Bezier piece starting at wire point *prev, by
+ * halving it until every control point is within err of the chord.
+ */
+static size_t
+bezier_flatten(struct dxf_import *ctx, int p, const fastf_t *q, int *prev, fastf_t err_sq, int depth)
+{
+    fastf_t left[(SPLINE_MAX_DEGREE + 1) * 4], right[(SPLINE_MAX_DEGREE + 1) * 4];
+    point_t a, b, c;
+    int flat = 1;
+    int r, j;
+
+    VSCALE(a, q, 1.0 / q[3]);
+    VSCALE(b, &q[p*4], 1.0 / q[p*4 + 3]);
+    for (j = 1; j < p && flat; j++) {
+	VSCALE(c, &q[j*4], 1.0 / q[j*4 + 3]);
+	flat = chord_dist_sq(a, b, c) <= err_sq;
+    }
+    if (flat || depth >= SPLINE_MAX_DEPTH) {
+	int curr = wire_point(ctx, b);
 
-	    /* create a wire edge in the NMG */
-	    eu = nmg_me(NULL, NULL, layers[curr_layer]->s);
-	    nmg_vertex_gv(eu->vu_p->v_p, line_pt[0]);
-	    nmg_vertex_gv(eu->eumate_p->vu_p->v_p, line_pt[1]);
-	    if (verbose) {
-		bu_log("Wire edge (line): (%g %g %g) <-> (%g %g %g)\n",
-		       V3ARGS(eu->vu_p->v_p->vg_p->coord),
-		       V3ARGS(eu->eumate_p->vu_p->v_p->vg_p->coord));
-	    }
+	wire_seg(ctx, *prev, curr, "spline");
+	*prev = curr;
+	return 1;
+    }
 
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+    /* split at u = 1/2, the triangle's edges are the halves */
+    memcpy(right, q, (p + 1) * 4 * sizeof(fastf_t));
+    HMOVE(left, right);
+    for (r = 1; r <= p; r++) {
+	for (j = 0; j <= p - r; j++) {
+	    hblend(&right[j*4], 0.5, &right[j*4], 0.5, &right[(j+1)*4]);
+	}
+	HMOVE(&left[r*4], right);
     }
 
-    return 0;
+    return bezier_flatten(ctx, p, left, prev, err_sq, depth + 1)
+	+ bezier_flatten(ctx, p, right, prev, err_sq, depth + 1);
 }
 
 
-static int
-process_ellipse_entities_code(int code)
-{
-    static point_t center={0, 0, 0};
-    static point_t majorAxis={1.0, 0, 0};
-    static double ratio=1.0;
-    static double startAngle = 0.0;
-    static double endAngle=M_2PI;
-    double angle, delta;
-    double majorRadius, minorRadius;
-    point_t tmp_pt;
-    vect_t xdir, ydir, zdir;
-    int coord;
-    int fullCircle;
-    int done;
-    struct vertex *v0 = NULL, *v1 = NULL, *v2 = NULL;
-    struct edgeuse *eu;
-
-    switch (code) {
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	    coord = code / 10 - 1;
-	    center[coord] = atof(line) * units_conv[units] * scale_factor;
-	    break;
-	case 11:
-	case 21:
-	case 31:
-	    coord = code / 10 - 1;
-	    majorAxis[coord] = atof(line) * units_conv[units] * scale_factor;
-	    break;
-	case 40:
-	    ratio = atof(line);
-	    break;
-	case 41:
-	    startAngle = atof(line);
-	    break;
-	case 42:
-	    endAngle = atof(line);
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    /* end of this ellipse entity
-	     * make a series of wire edges in the NMG to approximate a circle
-	     */
+/*
+ * Add chords for the pieces, flattened to err (output units) or at
+ * nsegs equal parameter steps when err is zero.  Returns the number
+ * of segments added.
+ */
+static size_t
+spline_chords(struct dxf_import *ctx, const struct bezier_set *bs, fastf_t err, int nsegs)
+{
+    int p = bs->degree;
+    const size_t stride = (p + 1) * 4;
+    fastf_t start = bs->breaks[0];
+    fastf_t len = bs->breaks[bs->count] - start;
+    point_t pt;
+    size_t count = 0;
+    int prev;
+    int piece = 0;
+    int i;
 
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found an ellipse\n");
-	    }
+    VSCALE(pt, bs->ctl, 1.0 / bs->ctl[3]);
+    prev = wire_point(ctx, pt);
 
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
-	    }
+    if (err > SMALL_FASTF) {
+	for (piece = 0; piece < bs->count; piece++) {
+	    count += bezier_flatten(ctx, p, &bs->ctl[piece * stride], &prev, err * err, 0);
+	}
+	return count;
+    }
 
-	    layers[curr_layer]->ellipse_count++;
+    /* walk the pieces once, evaluating every parameter that falls in each */
+    for (i = 1; i <= nsegs; i++) {
+	fastf_t t = (i == nsegs) ? bs->breaks[bs->count] : start + len * i / nsegs;
+	int curr;
 
-	    MAT4X3PNT(tmp_pt, curr_state->xform, center);
-	    VMOVE(center, tmp_pt);
-	    MAT4X3PNT(tmp_pt, curr_state->xform, majorAxis);
-	    VMOVE(majorAxis, tmp_pt);
+	while (piece < bs->count - 1 && t > bs->breaks[piece + 1]) {
+	    piece++;
+	}
+	bezier_point(p, &bs->ctl[piece * stride],
+		     (t - bs->breaks[piece]) / (bs->breaks[piece + 1] - bs->breaks[piece]), pt);
+	curr = wire_point(ctx, pt);
+	wire_seg(ctx, prev, curr, "spline");
+	prev = curr;
+	count++;
+    }
 
-	    majorRadius = MAGNITUDE(majorAxis);
-	    minorRadius = ratio * majorRadius;
+    return count;
+}
 
-	    VMOVE(xdir, majorAxis);
-	    VUNITIZE(xdir);
-	    VSET(zdir, 0, 0, 1);
-	    VCROSS(ydir, zdir, xdir);
 
-	    /* FIXME: arbitrary undefined tolerance */
-	    if (NEAR_EQUAL(endAngle, startAngle, 0.001)) {
-		fullCircle = 1;
-	    } else {
-		fullCircle = 0;
+/* write the pieces as one clamped NURBS with knots of full multiplicity at the breaks */
+static void
+bezier_to_nurb(struct dxf_import *ctx, const struct bezier_set *bs)
+{
+    int p = bs->degree;
+    int c_size = bs->count * p + 1;
+    int k_size = c_size + p + 1;
+    fastf_t *ctl = (fastf_t *)bu_malloc(c_size * 3 * sizeof(fastf_t), "bezier nurb ctl");
+    fastf_t *weights = (fastf_t *)bu_malloc(c_size * sizeof(fastf_t), "bezier nurb weights");
+    fastf_t *knots = (fastf_t *)bu_malloc(k_size * sizeof(fastf_t), "bezier nurb knots");
+    int rational = 0;
+    int i, j, k = 0;
+
+    for (i = 0; i < bs->count; i++) {
+	const fastf_t *q = &bs->ctl[i * (p + 1) * 4];
+
+	for (j = (i ? 1 : 0); j <= p; j++) {
+	    int idx = i * p + j;
+
+	    weights[idx] = q[j*4 + 3];
+	    VSCALE(&ctl[idx*3], &q[j*4], 1.0 / weights[idx]);
+	    if (!EQUAL(weights[idx], 1.0)) {
+		rational = 1;
 	    }
+	}
+    }
+    for (i = 0; i <= bs->count; i++) {
+	int mult = (i == 0 || i == bs->count) ? p + 1 : p;
 
-	    if (verbose) {
-		bu_log("Ellipse:\n");
-		bu_log("\tcenter = (%g %g %g)\n", V3ARGS(center));
-		bu_log("\tmajorAxis = (%g %g %g)\n", V3ARGS(majorAxis));
-		bu_log("\txdir = (%g %g %g)\n", V3ARGS(xdir));
-		bu_log("\tydir = (%g %g %g)\n", V3ARGS(ydir));
-		bu_log("\tradii = %g %g\n", majorRadius, minorRadius);
-		bu_log("\tangles = %g %g\n", startAngle, endAngle);
-		bu_log("\tfull circle = %d\n", fullCircle);
-	    }
+	for (j = 0; j < mult; j++) {
+	    knots[k++] = bs->breaks[i];
+	}
+    }
 
-	    /* make nmg wire edges */
-	    angle = startAngle;
-	    delta = M_PI / 15.0;
-	    if ((endAngle - startAngle)/delta < 4) {
-		delta = (endAngle - startAngle) / 5.0;
-	    }
-	    done = 0;
-	    while (!done) {
-		point_t p0, p1;
-		double r0, r1;
+    wire_nurb(ctx, p + 1, c_size, ctl, rational ? weights : NULL, k_size, knots);
 
-		if (angle >= endAngle) {
-		    angle = endAngle;
-		    done = 1;
-		}
+    bu_free(ctl, "bezier nurb ctl");
+    bu_free(weights, "bezier nurb weights");
+    bu_free(knots, "bezier nurb knots");
+}
 
-		r0 = majorRadius * cos(angle);
-		r1 = minorRadius * sin(angle);
-		VJOIN2(p1, center, r0, xdir, r1, ydir);
-		if (EQUAL(angle, startAngle)) {
-		    VMOVE(p0, p1);
-		    angle += delta;
-		    continue;
-		}
-		if (fullCircle && EQUAL(angle, endAngle)) {
-		    v2 = v0;
-		}
-		eu = nmg_me(v1, v2, layers[curr_layer]->s);
-		v1 = eu->vu_p->v_p;
-		if (v0 == NULL) {
-		    v0 = v1;
-		    nmg_vertex_gv(v0, p0);
-		}
-		v2 = eu->eumate_p->vu_p->v_p;
-		if (v2 != v0) {
-		    nmg_vertex_gv(v2, p1);
-		}
-		if (verbose) {
-		    bu_log("Wire edge (ellipse): (%g %g %g) <-> (%g %g %g)\n",
-			   V3ARGS(v1->vg_p->coord),
-			   V3ARGS(v2->vg_p->coord));
-		}
-		v1 = v2;
-		v2 = NULL;
 
-		angle += delta;
-	    }
+/* make room for npts more points and nsegs more segments */
+static void
+wire_reserve(struct wire_store *w, size_t npts, size_t nsegs)
+{
+    if (w->pt_count + npts > w->pt_max) {
+	w->pt_max = w->pt_max ? w->pt_max : WIRE_BLOCK;
+	while (w->pt_count + npts > w->pt_max) {
+	    w->pt_max *= 2;
+	}
+	w->pts = (fastf_t *)bu_realloc(w->pts, w->pt_max * 3 * sizeof(fastf_t), "wire points");
+    }
+    if (w->seg_count + nsegs > w->seg_max) {
+	w->seg_max = w->seg_max ? w->seg_max : WIRE_BLOCK;
+	while (w->seg_count + nsegs > w->seg_max) {
+	    w->seg_max *= 2;
+	}
+	w->segs = (int *)bu_realloc(w->segs, w->seg_max * 2 * sizeof(int), "wire segments");
+    }
+}
 
-	    VSET(center, 0, 0, 0);
-	    VSET(majorAxis, 0, 0, 0);
-	    ratio = 1.0;
-	    startAngle = 0.0;
-	    endAngle = M_2PI;
 
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+/* x[i] = c + ct[i] a + st[i] b, written so the loop vectorizes */
+static void
+conic_points(size_t n, const fastf_t *ct, const fastf_t *st, const fastf_t *c, const fastf_t *a, const fastf_t *b,
+	     fastf_t *x, fastf_t *y, fastf_t *z)
+{
+    const fastf_t cx = c[X], cy = c[Y], cz = c[Z];
+    const fastf_t ax = a[X], ay = a[Y], az = a[Z];
+    const fastf_t bx = b[X], by = b[Y], bz = b[Z];
+    size_t i;
+
+    for (i = 0; i < n; i++) {
+	x[i] = cx + ct[i] * ax + st[i] * bx;
+	y[i] = cy + ct[i] * ay + st[i] * by;
+	z[i] = cz + ct[i] * az + st[i] * bz;
     }
-
-    return 0;
 }
 
 
-static int
-process_circle_entities_code(int code)
+/* cos and sin of k*2pi/n for k from 0 to n, shared by every curve with n segments per turn */
+static const fastf_t *
+curve_template(struct curve_batch *cb, int n)
 {
-    static point_t center;
-    static fastf_t radius;
-    int coord, i;
-    struct vertex *v0=NULL, *v1=NULL, *v2=NULL;
-    struct edgeuse *eu;
-	vector<double> vcoord;
-
-    switch (code) {
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	    coord = code / 10 - 1;
-	    center[coord] = atof(line) * units_conv[units] * scale_factor;
-		vcoord.push_back(center[coord]);
-	    if (verbose) {
-		bu_log("CIRCLE center coord #%d = %g\n", coord, center[coord]);
-	    }
-	    break;
-	case 40:
-	    radius = atof(line) * units_conv[units] * scale_factor;
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    /* end of this circle entity
-	     * make a series of wire edges in the NMG to approximate a circle
-	     */
-		
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found a circle\n");
-	    }
+    int k;
 
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
-	    }
+    if (!cb->tmpl[n]) {
+	fastf_t *t = (fastf_t *)bu_malloc(2 * (n + 1) * sizeof(fastf_t), "curve template");
 
-	    layers[curr_layer]->circle_count++;
+	for (k = 0; k <= n; k++) {
+	    t[k] = cos(M_2PI * k / n);
+	    t[n + 1 + k] = sin(M_2PI * k / n);
+	}
+	cb->tmpl[n] = t;
+    }
 
-	    /* calculate circle at origin first */
-	    VSET(circle_pts[0], radius, 0.0, 0.0);
-	    for (i=1; i<segs_per_circle; i++) {
-		circle_pts[i][X] = circle_pts[i-1][X]*cos_delta - circle_pts[i-1][Y]*sin_delta;
-		circle_pts[i][Y] = circle_pts[i-1][Y]*cos_delta + circle_pts[i-1][X]*sin_delta;
-	    }
+    return cb->tmpl[n];
+}
 
-	    /* move everything to the specified center */
-	    for (i = 0; i < segs_per_circle; i++) {
-		point_t tmp_pt;
-		VADD2(circle_pts[i], circle_pts[i], center);
 
-		/* apply transformation */
-		MAT4X3PNT(tmp_pt, curr_state->xform, circle_pts[i]);
-		VMOVE(circle_pts[i], tmp_pt);
-	    }
+static void
+curve_templates_free(fastf_t **tmpl)
+{
+    int n;
 
-	    /* make nmg wire edges */
-	    for (i = 0; i < segs_per_circle; i++) {
-		if (i+1 == segs_per_circle) {
-		    v2 = v0;
-		}
-		eu = nmg_me(v1, v2, layers[curr_layer]->s);
-		if (i == 0) {
-		    v1 = eu->vu_p->v_p;
-		    v0 = v1;
-		    nmg_vertex_gv(v1, circle_pts[0]);
-		}
-		v2 = eu->eumate_p->vu_p->v_p;
-		if (i+1 < segs_per_circle) {
-		    nmg_vertex_gv(v2, circle_pts[i+1]);
-		}
-		if (verbose) {
-		    bu_log("Wire edge (circle): (%g %g %g) <-> (%g %g %g)\n",
-			   V3ARGS(v1->vg_p->coord),
-			   V3ARGS(v2->vg_p->coord));
-		}
-		v1 = v2;
-		v2 = NULL;
-	    }
+    for (n = 0; n <= CURVE_MAX_SEGS; n++) {
+	if (tmpl[n]) {
+	    bu_free(tmpl[n], "curve template");
+	}
+    }
+    bu_free(tmpl, "curve templates");
+}
 
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
-    }b
 
-    return 0;
+static void
+curve_scratch(struct curve_batch *cb, size_t n)
+{
+    if (n <= cb->scratch_max) {
+	return;
+    }
+    cb->scratch_max = n;
+    cb->ct = (fastf_t *)bu_realloc(cb->ct, n * sizeof(fastf_t), "curve cos");
+    cb->st = (fastf_t *)bu_realloc(cb->st, n * sizeof(fastf_t), "curve sin");
+    cb->x = (fastf_t *)bu_realloc(cb->x, n * sizeof(fastf_t), "curve x");
+    cb->y = (fastf_t *)bu_realloc(cb->y, n * sizeof(fastf_t), "curve y");
+    cb->z = (fastf_t *)bu_realloc(cb->z, n * sizeof(fastf_t), "curve z");
 }
 
 
-/* horizontal alignment codes for text */
-#define LEFT 0
-#define CENTER 1
-#define RIGHT 2
-#define ALIGNED 3
-#define HMIDDLE 4
-#define FIT 5
+/* generate the points and segments of one queued curve */
+static void
+curve_generate(struct dxf_import *ctx, const struct curve_job *job)
+{
+    struct curve_batch *cb = ctx->curves;
+    struct wire_store *w = &ctx->layers[job->layer]->wires;
+    const fastf_t *ct, *st;
+    size_t npts = job->closed ? (size_t)job->nsegs : (size_t)job->nsegs + 1;
+    size_t n = job->nsegs;
+    size_t i;
+    int first;
+
+    curve_scratch(cb, npts);
+    if (job->tmpl_n && (int)n <= job->tmpl_n) {
+	const fastf_t *t = curve_template(cb, job->tmpl_n);
+
+	ct = t;
+	st = t + job->tmpl_n + 1;
+    } else {
+	for (i = 0; i < n; i++) {
+	    cb->ct[i] = cos(job->delta * i);
+	    cb->st[i] = sin(job->delta * i);
+	}
+	ct = cb->ct;
+	st = cb->st;
+    }
 
-/* vertical alignment codes */
-#define BASELINE 0
-#define BOTTOM 1
-#define VMIDDLE 2
-#define TOP 3
+    conic_points(n, ct, st, job->c, job->a, job->b, cb->x, cb->y, cb->z);
+    if (!job->closed) {
+	point_t last;
 
-/* attachment point codes */
-#define TOPLEFT 1
-#define TOPCENTER 2
-#define TOPRIGHT 3
-#define MIDDLELEFT 4
-#define MIDDLECENTER 5
-#define MIDDLERIGHT 6
-#define BOTTOMLEFT 7
-#define BOTTOMCENTER 8
-#define BOTTOMRIGHT 9
+	VJOIN2(last, job->c, cos(job->t1), job->a, sin(job->t1), job->b);
+	cb->x[n] = last[X];
+	cb->y[n] = last[Y];
+	cb->z[n] = last[Z];
+    }
 
-/* secret codes for MTEXT entries
- * \P - new paragraph (line)
- * \X - new line (everything before is above the dimension line, everything after is below)
- * \~ - blank space
- * \f - TrueType font
- * \F - .SHX font
- * ex:
- * Hello \fArial;World
- * or:
- * Hello {\fArial;World}
- */
+    wire_reserve(w, npts, job->nsegs);
+    first = (int)w->pt_count;
+    for (i = 0; i < npts; i++) {
+	fastf_t *pt = &w->pts[(w->pt_count + i) * 3];
 
-int
-convertSecretCodes(char *c, char *cp, int *maxLineLen)
+	VSET(pt, cb->x[i], cb->y[i], cb->z[i]);
+    }
+    w->pt_count += npts;
+    for (i = 0; i < n; i++) {
+	w->segs[w->seg_count*2] = first + (int)i;
+	w->segs[w->seg_count*2 + 1] = (i + 1 < npts) ? first + (int)i + 1 : first;
+	w->seg_count++;
+    }
+
+    cb->curves[job->type]++;
+    cb->points[job->type] += npts;
+}
+
+
+/* generate everything queued, one curve type at a time so each can be timed */
+static void
+curve_flush(struct dxf_import *ctx)
 {
-    int lineCount = 0;
-    int lineLen = 0;
+    struct curve_batch *cb = ctx->curves;
+    int type;
+    size_t i;
 
-    while (*c) {
-	if (*c == '%' && *(c+1) == '%') {
-	    switch (*(c+2)) {
-		case 'o':
-		case 'O':
-		    overstrikemode = !overstrikemode;
-		    c += 3;
-		    break;
-		case 'u':
-		case 'U':
-		    underscoremode = !underscoremode;
-		    c += 3;
-		    break;
-		case 'd':	/* degree */
-		case 'D':
-		    *cp++ = 8;
-		    c += 3;
-		    break;
-		case 'p':	 /* plus/minus */
-		case 'P':
-		    *cp++ = 6;
-		    c += 3;
-		    break;
-		case 'c':	/* diameter */
-		case 'C':
-		    *cp++ = 7;
-		    c += 3;
-		    break;
-		case '%':
-		    *cp++ = '%';
-		    c += 3;
-		    break;
-		default:
-		    *cp++ = *c;
-		    c++;
-		    break;
-	    }
-	    lineLen++;
-	} else if (*c == '\\') {
-	    switch (*(c+1)) {
-		case 'P':
-		case 'X':
-		    *cp++ = '\n';
-		    c += 2;
-		    lineCount++;
-		    V_MAX(*maxLineLen, lineLen);
+    for (type = 0; type < CURVE_TYPES; type++) {
+	int64_t start = bu_gettime();
 
-		    lineLen = 0;
-		    break;
-		case 'A':
-		    while (*c != ';' && *c != '\0') c++;
-		    c++;
-		    break;
-		case '~':
-		    *cp++ = ' ';
-		    c += 2;
-		    lineLen++;
-		    break;
-		default:
-		    *cp++ = *c++;
-		    lineLen++;
-		    break;
+	for (i = 0; i < cb->count; i++) {
+	    if (cb->jobs[i].type == type) {
+		curve_generate(ctx, &cb->jobs[i]);
 	    }
-	} else {
-	    *cp++ = *c++;
-	    lineLen++;
 	}
+	cb->usec[type] += bu_gettime() - start;
     }
-    if (*(c-1) != '\n') {
-	lineCount++;
-    }
+    cb->count = 0;
+}
 
-    V_MAX(*maxLineLen, lineLen);
 
-    return lineCount;
+/*
+ * Queue the conic center + cos(t) a + sin(t) b, in drawing space,
+ * with nsegs chords from t0 in steps of delta.  An open curve ends
+ * at t1, a closed one joins back to t0.
+ */
+static void
+curve_queue(struct dxf_import *ctx, int type, const point_t center, const vect_t a, const vect_t b,
+	    fastf_t t0, fastf_t delta, fastf_t t1, int nsegs, int closed)
+{
+    struct curve_batch *cb = ctx->curves;
+    struct curve_job *job;
+    vect_t ra, rb;
+    fastf_t c0 = cos(t0), s0 = sin(t0);
+    int n;
+
+    if (cb->count >= CURVE_BATCH) {
+	curve_flush(ctx);
+    }
+    job = &cb->jobs[cb->count++];
+
+    /* rotate the start angle into the axes */
+    VCOMB2(ra, c0, a, s0, b);
+    VCOMB2(rb, -s0, a, c0, b);
+
+    job->type = type;
+    job->layer = ctx->curr_layer;
+    job->nsegs = nsegs;
+    job->closed = closed;
+    job->delta = delta;
+    job->t1 = t1 - t0;
+    MAT4X3PNT(job->c, ctx->curr_state->xform, center);
+    MAT4X3VEC(job->a, ctx->curr_state->xform, ra);
+    MAT4X3VEC(job->b, ctx->curr_state->xform, rb);
+
+    job->tmpl_n = 0;
+    n = (int)(M_2PI / delta + 0.5);
+    if (n > 0 && n <= CURVE_MAX_SEGS && NEAR_EQUAL(delta * n, M_2PI, 1.0e-12)) {
+	job->tmpl_n = n;
+    }
 }
 
 
-void
-drawString(char *theText, point_t firstAlignmentPoint, point_t secondAlignmentPoint,
-	   double textHeight, double UNUSED(textScale), double textRotation, int horizAlignment, int vertAlignment, int UNUSED(textFlag))
+/* log the time spent making curve points, by curve type */
+static void
+curve_report(const struct curve_batch *cb)
 {
-    double stringLength = 0.0;
-    char *copyOfText;
-    char *c, *cp;
-    vect_t diff;
-    struct bu_list vhead;
-    int maxLineLen = 0;
+    static const char *names[CURVE_TYPES] = {"circles", "arcs", "ellipses"};
+    int type;
 
-    BU_LIST_INIT(&vhead);
+    for (type = 0; type < CURVE_TYPES; type++) {
+	if (!cb->curves[type]) {
+	    continue;
+	}
+	bu_log("%zu %s, %zu points in %g s (%g ns per point)\n", cb->curves[type], names[type],
+	       cb->points[type], (double)cb->usec[type] / 1.0e6,
+	       (double)cb->usec[type] * 1.0e3 / (double)cb->points[type]);
+    }
+}
 
-    copyOfText = (char *)bu_calloc((unsigned int)strlen(theText)+1, 1, "copyOfText");
-    c = theText;
-    cp = copyOfText;
-    (void)convertSecretCodes(c, cp, &maxLineLen);
 
-    bu_free(theText, "theText");
-    stringLength = strlen(copyOfText);
+/* strokes of character c, from bn_vlist_2string() the first time */
+static const struct glyph *
+glyph_get(struct dxf_import *ctx, unsigned char c)
+{
+    struct glyph *g;
 
-    if (horizAlignment == FIT && vertAlignment == BASELINE) {
-	double allowedLength;
-	double xScale=1.0;
-	double yScale=1.0;
-	double scale;
+    if (!ctx->glyphs) {
+	ctx->glyphs = (struct glyph *)bu_calloc(GLYPH_COUNT, sizeof(struct glyph), "glyphs");
+    }
+    g = &ctx->glyphs[c];
 
-	/* fit along baseline */
-	VSUB2(diff, firstAlignmentPoint, secondAlignmentPoint);
-	allowedLength = MAGNITUDE(diff);
-	xScale = allowedLength / stringLength;
-	yScale = textHeight;
-	scale = xScale < yScale ? xScale : yScale;
-	bn_vlist_2string(&vhead, &free_hd, copyOfText,
-			 firstAlignmentPoint[X], firstAlignmentPoint[Y],
-			 scale, textRotation);
-	nmg_vlist_to_eu(&vhead, layers[curr_layer]->s);
-	BN_FREE_VLIST(&free_hd, &vhead);
-    } else if (horizAlignment == LEFT && vertAlignment == BASELINE) {
-	bn_vlist_2string(&vhead, &free_hd, copyOfText,
-			 firstAlignmentPoint[X], firstAlignmentPoint[Y],
-			 textHeight, textRotation);
-	nmg_vlist_to_eu(&vhead, layers[curr_layer]->s);
-	BN_FREE_VLIST(&free_hd, &vhead);
-    } else if ((horizAlignment == CENTER || horizAlignment == HMIDDLE) && vertAlignment == BASELINE) {
-	double len = stringLength * textHeight;
-	firstAlignmentPoint[X] = secondAlignmentPoint[X] - cos(textRotation) * len / 2.0;
-	firstAlignmentPoint[Y] = secondAlignmentPoint[Y] - sin(textRotation) * len / 2.0;
-	bn_vlist_2string(&vhead, &free_hd, copyOfText,
-			 firstAlignmentPoint[X], firstAlignmentPoint[Y],
-			 textHeight, textRotation);
-	nmg_vlist_to_eu(&vhead, layers[curr_layer]->s);
-	BN_FREE_VLIST(&free_hd, &vhead);
-    } else if ((horizAlignment == CENTER || horizAlignment == HMIDDLE) && vertAlignment == VMIDDLE) {
-	double len = stringLength * textHeight;
-	firstAlignmentPoint[X] = secondAlignmentPoint[X] - len / 2.0;
-	firstAlignmentPoint[Y] = secondAlignmentPoint[Y] - textHeight / 2.0;
-	firstAlignmentPoint[X] = firstAlignmentPoint[X] - (1.0 - cos(textRotation)) * len / 2.0;
-	firstAlignmentPoint[Y] = firstAlignmentPoint[Y] - sin(textRotation) * len / 2.0;
-	bn_vlist_2string(&vhead, &free_hd, copyOfText,
-			 firstAlignmentPoint[X], firstAlignmentPoint[Y],
-			 textHeight, textRotation);
-	nmg_vlist_to_eu(&vhead, layers[curr_layer]->s);
-	BN_FREE_VLIST(&free_hd, &vhead);
-    } else if (horizAlignment == RIGHT && vertAlignment == BASELINE) {
-	double len = stringLength * textHeight;
-	firstAlignmentPoint[X] = secondAlignmentPoint[X] - cos(textRotation) * len;
-	firstAlignmentPoint[Y] = secondAlignmentPoint[Y] - sin(textRotation) * len;
-	bn_vlist_2string(&vhead, &free_hd, copyOfText,
-			 firstAlignmentPoint[X], firstAlignmentPoint[Y],
-			 textHeight, textRotation);
-	nmg_vlist_to_eu(&vhead, layers[curr_layer]->s);
-	BN_FREE_VLIST(&free_hd, &vhead);
-    } else {
-	bu_log("cannot handle this alignment: horiz = %d, vert = %d\n", horizAlignment, vertAlignment);
+    if (!g->built) {
+	struct bu_list vhead;
+	struct bn_vlist *vp;
+	char str[2];
+	size_t i, n = 0;
+
+	str[0] = (char)c;
+	str[1] = '\0';
+	BU_LIST_INIT(&vhead);
+	bn_vlist_2string(&vhead, &ctx->free_hd, str, 0.0, 0.0, 1.0, 0.0);
+
+	for (BU_LIST_FOR(vp, bn_vlist, &vhead)) {
+	    n += vp->nused;
+	}
+	if (n) {
+	    g->pts = (fastf_t *)bu_malloc(n * 2 * sizeof(fastf_t), "glyph points");
+	    g->draw = (char *)bu_malloc(n, "glyph strokes");
+	}
+	for (BU_LIST_FOR(vp, bn_vlist, &vhead)) {
+	    for (i = 0; i < vp->nused; i++) {
+		if (vp->cmd[i] != BN_VLIST_LINE_MOVE && vp->cmd[i] != BN_VLIST_LINE_DRAW) {
+		    continue;
+		}
+		g->pts[g->count*2 + X] = vp->pt[i][X];
+		g->pts[g->count*2 + Y] = vp->pt[i][Y];
+		g->draw[g->count] = vp->cmd[i] == BN_VLIST_LINE_DRAW;
+		g->count++;
+	    }
+	}
+	BN_FREE_VLIST(&ctx->free_hd, &vhead);
+	g->built = 1;
     }
 
-    bu_free(copyOfText, "copyOfText");
+    return g;
 }
 
 
-void
-drawMtext(char *text, int attachPoint, int UNUSED(drawingDirection), double textHeight, double entityHeight,
-	  double charWidth, double UNUSED(rectWidth), double rotationAngle, double insertionPoint[3])
+static void
+glyphs_free(struct glyph *glyphs)
 {
-    struct bu_list vhead;
-    int done;
-    char *c;
-    char *cp;
-    int lineCount;
-    double lineSpace;
-    vect_t xdir, ydir;
-    double startx, starty;
-    int maxLineLen = 0;
-    double scale = 1.0;
-    double xdel = 0.0, ydel = 0.0;
-    double radians = rotationAngle * DEG2RAD;
-    char *copyOfText = (char *)bu_calloc((unsigned int)strlen(text)+1, 1, "copyOfText");
+    int i;
 
-    BU_LIST_INIT(&vhead);
+    for (i = 0; i < GLYPH_COUNT; i++) {
+	if (glyphs[i].pts) {
+	    bu_free(glyphs[i].pts, "glyph points");
+	    bu_free(glyphs[i].draw, "glyph strokes");
+	}
+    }
+    bu_free(glyphs, "glyphs");
+}
 
-    c = text;
-    cp = copyOfText;
-    lineCount = convertSecretCodes(c, cp, &maxLineLen);
 
-    if (textHeight > 0.0) {
-	scale = textHeight;
-    } else if (charWidth > 0.0) {
-	scale = charWidth;
-    } else if (entityHeight > 0.0) {
-	scale = (entityHeight / (double)lineCount) * 0.9;
+/*
+ * Add the strokes of str to the current layer's wires, as
+ * bn_vlist_2string() would draw it: characters scale apart from
+ * (x, y) along a baseline at theta degrees.
+ */
+static void
+wire_string(struct dxf_import *ctx, const char *str, fastf_t x, fastf_t y, fastf_t scale, fastf_t theta)
+{
+    const unsigned char *cp;
+    fastf_t ct = cos(theta * DEG2RAD) * scale;
+    fastf_t st = sin(theta * DEG2RAD) * scale;
+    fastf_t offset = 0.0;
+    size_t npts = 0;
+    size_t i;
+    int prev = -1;
+
+    for (cp = (const unsigned char *)str; *cp; cp++) {
+	npts += glyph_get(ctx, *cp)->count;
     }
+    wire_reserve(&ctx->layers[ctx->curr_layer]->wires, npts, npts);
 
-    lineSpace = 1.25 * scale;
+    for (cp = (const unsigned char *)str; *cp; cp++, offset += 1.0) {
+	const struct glyph *g = &ctx->glyphs[*cp];
 
-    VSET(xdir, cos(radians), sin(radians), 0.0);
-    VSET(ydir, -sin(radians), cos(radians), 0.0);
+	for (i = 0; i < g->count; i++) {
+	    fastf_t gx = g->pts[i*2 + X] + offset;
+	    fastf_t gy = g->pts[i*2 + Y];
+	    point_t pt;
+	    int curr;
 
-    switch (attachPoint) {
-	case TOPLEFT:
-	    xdel = 0.0;
-	    ydel =  -scale;
-	    break;
-	case TOPCENTER:
-	    xdel = -((double)maxLineLen * scale) / 2.0;
-	    ydel = -scale;
-	    break;
-	case TOPRIGHT:
-	    xdel = -(double)maxLineLen * scale;
-	    ydel = -scale;
-	    break;
-	case MIDDLELEFT:
-	    xdel = 0.0;
-	    ydel = -((double)lineCount * lineSpace) / 2.0;
-	    break;
-	case MIDDLECENTER:
-	    xdel = -((double)maxLineLen * scale) / 2.0;
-	    ydel = -((double)lineCount * lineSpace) / 2.0;
-	    break;
-	case MIDDLERIGHT:
-	    xdel = -(double)maxLineLen * scale;
-	    ydel = -((double)lineCount * lineSpace) / 2.0;
-	    break;
-	case BOTTOMLEFT:
-	    xdel = 0.0;
-	    ydel = (double)lineCount * lineSpace - scale;
-	    break;
-	case BOTTOMCENTER:
-	    xdel = -((double)maxLineLen * scale) / 2.0;
-	    ydel = (double)lineCount * lineSpace - scale;
-	    break;
-	case BOTTOMRIGHT:
-	    xdel = -(double)maxLineLen * scale;
-	    ydel = (double)lineCount * lineSpace - scale;
+	    VSET(pt, x + gx * ct - gy * st, y + gx * st + gy * ct, 0.0);
+	    curr = wire_point(ctx, pt);
+	    if (g->draw[i] && prev >= 0) {
+		wire_seg(ctx, prev, curr, "text");
+	    }
+	    prev = curr;
+	}
+    }
+}
+
+
+/*
+ * The vertices of a triangle in a canonical order: smallest first,
+ * keeping the winding unless either winding is to match.
+ */
+static void
+tri_key(int key[3], const int *v, int unoriented)
+{
+    int i = 0;
+
+    if (v[1] < v[i]) i = 1;
+    if (v[2] < v[i]) i = 2;
+    key[0] = v[i];
+    key[1] = v[(i + 1) % 3];
+    key[2] = v[(i + 2) % 3];
+    if (unoriented && key[2] < key[1]) {
+	int tmp = key[1];
+	key[1] = key[2];
+	key[2] = tmp;
+    }
+}
+
+
+/* hash slot of a triangle's key, or of the empty slot it would go in */
+static size_t
+tri_slot(const struct layer *lp, const int key[3], int unoriented)
+{
+    uint64_t h = ((uint64_t)(uint32_t)key[0] * 0x9e3779b97f4a7c15ULL) ^
+	((uint64_t)(uint32_t)key[1] * 0xc2b2ae3d27d4eb4fULL) ^
+	((uint64_t)(uint32_t)key[2] * 0x165667b19e3779f9ULL);
+    size_t mask = lp->tri_hash_size - 1;
+    size_t slot = (size_t)(h ^ (h >> 29)) & mask;
+
+    while (lp->tri_hash[slot] >= 0) {
+	int other[3];
+
+	tri_key(other, &lp->part_tris[lp->tri_hash[slot]*3], unoriented);
+	if (other[0] == key[0] && other[1] == key[1] && other[2] == key[2]) {
 	    break;
+	}
+	slot = (slot + 1) & mask;
     }
 
-    startx = insertionPoint[X] + xdel * xdir[X] + ydel * ydir[X];
-    starty = insertionPoint[Y] + xdel * xdir[Y] + ydel * ydir[Y];
+    return slot;
+}
 
-    cp = copyOfText;
-    c = copyOfText;
-    done = 0;
-    while (!done) {
-	if (*cp == '\n' || *cp == '\0') {
-	    if (*cp == '\0') {
-		done = 1;
-	    }
-	    *cp = '\0';
-	    bn_vlist_2string(&vhead, &free_hd, c,
-			     startx, starty,
-			     scale, rotationAngle);
-	    nmg_vlist_to_eu(&vhead, layers[curr_layer]->s);
-	    BN_FREE_VLIST(&free_hd, &vhead);
-	    c = ++cp;
-	    startx -= lineSpace * ydir[X];
-	    starty -= lineSpace * ydir[Y];
-	} else {
-	    cp++;
+
+/* keep the triangle hash at most half full */
+static void
+tri_hash_grow(struct layer *lp, int unoriented)
+{
+    size_t i;
+
+    if ((lp->curr_tri + 1) * 2 <= lp->tri_hash_size) {
+	return;
+    }
+
+    lp->tri_hash_size = lp->tri_hash_size ? lp->tri_hash_size * 2 : TRI_BLOCK * 2;
+    lp->tri_hash = (int *)bu_realloc(lp->tri_hash, lp->tri_hash_size * sizeof(int), "triangle hash");
+    memset(lp->tri_hash, 0xff, lp->tri_hash_size * sizeof(int));
+    for (i = 0; i < lp->curr_tri; i++) {
+	int key[3];
+
+	tri_key(key, &lp->part_tris[i*3], unoriented);
+	lp->tri_hash[tri_slot(lp, key, unoriented)] = (int)i;
+    }
+}
+
+
+/*
+ * routine to add a new triangle to the current part.  Degenerate
+ * triangles and repeats of a triangle already in the layer are
+ * dropped.
+ */
+static void
+add_triangle(struct dxf_import *ctx, int v1, int v2, int v3, int layer)
+{
+    struct layer *lp = ctx->layers[layer];
+    int v[3], key[3];
+    size_t slot;
+
+    if (ctx->verbose) {
+	bu_log("Adding triangle %d %d %d, to layer %s\n", v1, v2, v3, ctx->layers[layer]->name);
+    }
+    if (v1 == v2 || v2 == v3 || v3 == v1) {
+	if (ctx->verbose) {
+	    bu_log("\tSkipping degenerate triangle\n");
 	}
+	return;
     }
 
+    v[0] = v1;
+    v[1] = v2;
+    v[2] = v3;
+    tri_hash_grow(lp, ctx->dedup_reversed);
+    tri_key(key, v, ctx->dedup_reversed);
+    slot = tri_slot(lp, key, ctx->dedup_reversed);
+    if (lp->tri_hash[slot] >= 0) {
+	if (ctx->verbose) {
+	    bu_log("\tSkipping repeated triangle\n");
+	}
+	lp->dup_tris++;
+	return;
+    }
+    lp->tri_hash[slot] = (int)lp->curr_tri;
+    if (ctx->layers[layer]->curr_tri >= ctx->layers[layer]->max_tri) {
+	/* allocate more memory for triangles */
+	ctx->layers[layer]->max_tri += TRI_BLOCK;
+	ctx->layers[layer]->part_tris = (int *)bu_realloc(ctx->layers[layer]->part_tris, sizeof(int) * ctx->layers[layer]->max_tri * 3, "layers[layer]->part_tris");
+    }
 
-    bu_free(copyOfText, "copyOfText");
+    /* fill in triangle info */
+    ctx->layers[layer]->part_tris[ctx->layers[layer]->curr_tri*3 + 0] = v1;
+    ctx->layers[layer]->part_tris[ctx->layers[layer]->curr_tri*3 + 1] = v2;
+    ctx->layers[layer]->part_tris[ctx->layers[layer]->curr_tri*3 + 2] = v3;
+
+    /* increment count */
+    ctx->layers[layer]->curr_tri++;
 }
 
 
 static int
-process_leader_entities_code(int code)
+process_unknown_code(struct dxf_import *ctx, int code)
 {
-    static int arrowHeadFlag = 0;
-    static int vertNo = 0;
-    static point_t pt;
-    point_t tmp_pt;
-    int i;
-    struct edgeuse *eu;
-    struct vertex *v1=NULL, *v2=NULL;
-
     switch (code) {
-	case 8:
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 0:		/* text string */
+	    if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
 	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    if (verbose) {
-		bu_log("LINE is in layer: %s\n", curr_layer_name);
+	    break;
+	case 2:		/* name */
+	    if (!bu_strncmp(ctx->line, "HEADER", 6)) {
+		ctx->curr_state->state = HEADER_SECTION;
+		if (ctx->verbose) {
+		    bu_log("Change state to %d\n", ctx->curr_state->state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "CLASSES", 7)) {
+		ctx->curr_state->state = CLASSES_SECTION;
+		if (ctx->verbose) {
+		    bu_log("Change state to %d\n", ctx->curr_state->state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "TABLES", 6)) {
+		ctx->curr_state->state = TABLES_SECTION;
+		ctx->curr_state->sub_state = UNKNOWN_TABLE_STATE;
+		if (ctx->verbose) {
+		    bu_log("Change state to %d\n", ctx->curr_state->state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "BLOCKS", 6)) {
+		ctx->curr_state->state = BLOCKS_SECTION;
+		if (ctx->verbose) {
+		    bu_log("Change state to %d\n", ctx->curr_state->state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENTITIES", 8)) {
+		ctx->curr_state->state = ENTITIES_SECTION;
+		ctx->curr_state->sub_state =UNKNOWN_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("Change state to %d\n", ctx->curr_state->state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "OBJECTS", 7)) {
+		ctx->curr_state->state = OBJECTS_SECTION;
+		if (ctx->verbose) {
+		    bu_log("Change state to %d\n", ctx->curr_state->state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "THUMBNAILIMAGE", 14)) {
+		ctx->curr_state->state = THUMBNAILIMAGE_SECTION;
+		if (ctx->verbose) {
+		    bu_log("Change state to %d\n", ctx->curr_state->state);
+		}
+		break;
 	    }
 	    break;
 	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 71:
-	    arrowHeadFlag = atoi(line);
-	    break;
-	case 72:
-	    /* path type, unimplemented */
-	    break;
-	case 73:
-	    /* creation, unimplemented */
-	    break;
-	case 74:
-	    /* hookline direction, unimplemented */
-	    break;
-	case 75:
-	    /* hookline, unimplemented */
-	    break;
-	case 40:
-	    /* text height, unimplemented */
-	    break;
-	case 41:
-	    /* text width, unimplemented */
-	    break;
-	case 76:
-	    /* num vertices, unimplemented */
-	    break;
-	case 210:
-	    /* normal, unimplemented */
-	    break;
-	case 220:
-	    /* normal, unimplemented */
-	    break;
-	case 230:
-	    /* normal, unimplemented */
-	    break;
-	case 211:
-	    /* horizontal direction, unimplemented */
-	    break;
-	case 221:
-	    /* horizontal direction, unimplemented */
-	    break;
-	case 231:
-	    /* horizontal direction, unimplemented */
-	    break;
-	case 212:
-	    /* offsetB, unimplemented */
+	    ctx->curr_color = atoi(ctx->line);
 	    break;
-	case 222:
-	    /* offsetB, unimplemented */
-	    break;
-	case 232:
-	    /* offsetB, unimplemented */
-	    break;
-	case 213:
-	    /* offset, unimplemented */
-	    break;
-	case 223:
-	    /* offset, unimplemented */
-	    break;
-	case 233:
-	    /* offset, unimplemented */
-	    break;
-	case 10:
-	    pt[X] = atof(line);
+    }
+    return 0;
+}
+
+
+static int
+process_header_code(struct dxf_import *ctx, int code)
+{
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
 	    break;
-	case 20:
-	    pt[Y] = atof(line);
+	case 0:		/* text string */
+	    if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    }
 	    break;
-	case 30:
-	    pt[Z] = atof(line);
-	    if (verbose) {
-		bu_log("LEADER vertex #%d = (%g %g %g)\n", vertNo, V3ARGS(pt));
+	case 9:		/* variable name */
+	    if (!bu_strncmp(ctx->line, "$INSUNITS", 9)) {
+		ctx->int_ptr = &ctx->units;
+	    } else if (BU_STR_EQUAL(ctx->line, "$CECOLOR")) {
+		ctx->int_ptr = &ctx->color_by_layer;
+	    } else if (BU_STR_EQUAL(ctx->line, "$SPLINESEGS")) {
+		ctx->int_ptr = &ctx->splineSegs;
 	    }
-	    MAT4X3PNT(tmp_pt, curr_state->xform, pt);
-	    add_polyline_vertex(V3ARGS(tmp_pt));
 	    break;
-	case 0:
-	    /* end of this line */
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found end of LEADER: arrowhead flag = %d\n", arrowHeadFlag);
+	case 70:
+	case 62:
+	    if (ctx->int_ptr) {
+		(*ctx->int_ptr) = atoi(ctx->line);
 	    }
+	    ctx->int_ptr = NULL;
+	    break;
+    }
 
-	    layers[curr_layer]->leader_count++;
+    return 0;
+}
 
-	    if (polyline_vertex_count > 1) {
-		if (!layers[curr_layer]->m) {
-		    create_nmg();
-		}
 
-		for (i = 0; i < polyline_vertex_count-1; i++) {
-		    eu = nmg_me(v1, v2, layers[curr_layer]->s);
-		    if (i == 0) {
-			v1 = eu->vu_p->v_p;
-			nmg_vertex_gv(v1, polyline_verts);
-		    }
-		    v2 = eu->eumate_p->vu_p->v_p;
-		    nmg_vertex_gv(v2, &polyline_verts[(i+1)*3]);
-		    if (verbose) {
-			bu_log("Wire edge (LEADER): (%g %g %g) <-> (%g %g %g)\n",
-			       V3ARGS(v1->vg_p->coord),
-			       V3ARGS(v2->vg_p->coord));
-		    }
-		    v1 = v2;
-		    v2 = NULL;
-		}
+static int
+process_classes_code(struct dxf_import *ctx, int code)
+{
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 0:		/* text string */
+	    if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
 	    }
-	    polyline_vert_indices_count = 0;
-	    polyline_vertex_count = 0;
-	    arrowHeadFlag = 0;
-	    vertNo = 0;
-
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
 	    break;
     }
 
@@ -2221,123 +2205,172 @@ process_leader_entities_code(int code)
 
 
 static int
-process_mtext_entities_code(int code)
-{
-    static struct bu_vls *vls = NULL;
-    static int attachPoint = 0;
-    static int drawingDirection = 0;
-    static double textHeight = 0.0;
-    static double entityHeight = 0.0;
-    static double charWidth = 0.0;
-    static double rectWidth = 0.0;
-    static double rotationAngle = 0.0;
-    static double insertionPoint[3] = {0, 0, 0};
-    static double xAxisDirection[3] = {0, 0, 0};
-    point_t tmp_pt;
-    int coord;
-
+process_tables_unknown_code(struct dxf_import *ctx, int code)
+{
     switch (code) {
-	case 3:
-	    if (!vls) {
-		BU_GET(vls, struct bu_vls);
-		bu_vls_init(vls);
-	    }
-	    bu_vls_strcat(vls, line);
-	    break;
-	case 1:
-	    if (!vls) {
-		BU_GET(vls, struct bu_vls);
-		bu_vls_init(vls);
-	    }
-	    bu_vls_strcat(vls, line);
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
 	    break;
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
+	case 0:		/* text string */
+	    if (BU_STR_EQUAL(ctx->line, "LAYER")) {
+		if (ctx->curr_layer_name) {
+		    bu_free(ctx->curr_layer_name, "cur_layer_name");
+		    ctx->curr_layer_name = NULL;
+		}
+		ctx->curr_color = 0;
+		ctx->curr_state->sub_state = LAYER_TABLE_STATE;
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "ENDTAB")) {
+		if (ctx->curr_layer_name) {
+		    bu_free(ctx->curr_layer_name, "cur_layer_name");
+		    ctx->curr_layer_name = NULL;
+		}
+		ctx->curr_color = 0;
+		ctx->curr_state->sub_state = UNKNOWN_TABLE_STATE;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
 	    }
-	    curr_layer_name = make_brlcad_name(line);
 	    break;
-	case 10:
-	case 20:
-	case 30:
-	    coord = (code / 10) - 1;
-	    insertionPoint[coord] = atof(line) * units_conv[units] * scale_factor;
+    }
+
+    return 0;
+}
+
+
+static int
+process_tables_layer_code(struct dxf_import *ctx, int code)
+{
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
 	    break;
-	case 11:
-	case 21:
-	case 31:
-	    coord = (code / 10) - 1;
-	    xAxisDirection[coord] = atof(line);
-	    if (code == 31) {
-		rotationAngle = atan2(xAxisDirection[Y], xAxisDirection[X]) * RAD2DEG;
+	case 2:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("In LAYER in TABLES, layer name = %s\n", ctx->curr_layer_name);
 	    }
 	    break;
-	case 40:
-	    textHeight = atof(line);
-	    break;
-	case 41:
-	    rectWidth = atof(line);
-	    break;
-	case 42:
-	    charWidth = atof(line);
-	    break;
-	case 43:
-	    entityHeight = atof(line);
-	    break;
-	case 50:
-	    rotationAngle = atof(line);
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 71:
-	    attachPoint = atoi(line);
-	    break;
-	case 72:
-	    drawingDirection = atoi(line);
+	case 62:	/* layer color */
+	    ctx->curr_color = atoi(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("In LAYER in TABLES, layer color = %d\n", ctx->curr_color);
+	    }
 	    break;
-	case 0:
-	    if (verbose) {
-		bu_log("MTEXT (%s), height = %g, entityHeight = %g, rectWidth = %g\n", (vls) ? bu_vls_addr(vls) : "NO_NAME", textHeight, entityHeight, rectWidth);
-		bu_log("\tattachPoint = %d, charWidth = %g, insertPt = (%g %g %g)\n", attachPoint, charWidth, V3ARGS(insertionPoint));
+	case 0:		/* text string */
+	    if (ctx->curr_layer_name && ctx->curr_color) {
+		get_layer(ctx);
 	    }
-	    /* draw the text */
-	    get_layer();
 
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "cur_layer_name");
+		ctx->curr_layer_name = NULL;
 	    }
+	    ctx->curr_color = 0;
+	    ctx->curr_state->sub_state = UNKNOWN_TABLE_STATE;
+	    return process_tables_unknown_code(ctx, code);
+    }
 
-	    layers[curr_layer]->mtext_count++;
+    return 0;
+}
 
-	    /* apply transformation */
-	    MAT4X3PNT(tmp_pt, curr_state->xform, insertionPoint);
-	    VMOVE(insertionPoint, tmp_pt);
 
-	    {
-		char noname[] = "NO_NAME";
-		char *t = NULL;
-		if (vls) {
-		    t = bu_strdup(bu_vls_cstr(vls));
+static int
+process_tables_code(struct dxf_import *ctx, int code)
+{
+    return process_tables_sub_code[ctx->curr_state->sub_state](ctx, code);
+}
+
+
+/*
+ * Fold one group code of a BLOCK definition into its hash.  Handles
+ * and object pointers differ between files holding the same block,
+ * so they are left out.
+ */
+static void
+hash_block_code(struct block_list *blk, int code, const char *line)
+{
+    const unsigned char *c;
+
+    if (code == 5 || code == 105 || (code >= 320 && code <= 369) ||
+	(code >= 390 && code <= 399) || code == 1005) {
+	return;
+    }
+
+    /* FNV-1a */
+    blk->hash = (blk->hash ^ (uint64_t)(unsigned int)code) * 0x100000001b3ULL;
+    for (c = (const unsigned char *)line; *c; c++) {
+	blk->hash = (blk->hash ^ *c) * 0x100000001b3ULL;
+    }
+}
+
+
+static int
+process_blocks_code(struct dxf_import *ctx, int code)
+{
+    size_t len;
+    int coord;
+
+    if (ctx->curr_block) {
+	hash_block_code(ctx->curr_block, code, ctx->line);
+    }
+
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 0:		/* text string */
+	    if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "ENDBLK")) {
+		ctx->curr_block = NULL;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "BLOCK", 5)) {
+		/* start of a new block */
+		BU_ALLOC(ctx->curr_block, struct block_list);
+		ctx->curr_block->offset = bu_ftell(ctx->dxf);
+		/* the same text means different geometry under other units */
+		ctx->curr_block->hash = 0xcbf29ce484222325ULL;
+		hash_block_code(ctx->curr_block, ctx->units, "");
+		BU_LIST_INSERT(&(ctx->block_head), &(ctx->curr_block->l));
+		break;
+	    }
+	    break;
+	case 2:		/* block name */
+	    if (ctx->curr_block && ctx->curr_block->block_name == NULL) {
+		ctx->curr_block->block_name = bu_strdup(ctx->line);
+		if (ctx->verbose) {
+		    bu_log("BLOCK %s begins at %jd\n",
+			   ctx->curr_block->block_name,
+			   (intmax_t)ctx->curr_block->offset);
 		}
-		drawMtext((t) ? t : noname, attachPoint, drawingDirection, textHeight, entityHeight,
-			  charWidth, rectWidth, rotationAngle, insertionPoint);
-		if (t)
-		    bu_free(t, "temp char buf");
 	    }
-	    bu_vls_free(vls);
-	    BU_PUT(vls, struct bu_vls);
-
-	    attachPoint = 0;
-	    textHeight = 0.0;
-	    entityHeight = 0.0;
-	    charWidth = 0.0;
-	    rectWidth = 0.0;
-	    rotationAngle = 0.0;
-	    VSET(insertionPoint, 0, 0, 0);
-	    VSET(xAxisDirection, 0, 0, 0);
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
+	    break;
+	case 5:		/* block handle */
+	    if (ctx->curr_block && BU_STR_EMPTY(ctx->curr_block->handle)) {
+		len = strlen(ctx->line);
+		V_MIN(len, 16);
+		bu_strlcpy(ctx->curr_block->handle, ctx->line, len);
+	    }
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    if (ctx->curr_block) {
+		coord = code / 10 - 1;
+		ctx->curr_block->base[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    }
 	    break;
     }
 
@@ -2345,1073 +2378,5780 @@ process_mtext_entities_code(int code)
 }
 
 
-static int
-process_text_attrib_entities_code(int code)
+static void
+add_polyline_vertex(struct dxf_import *ctx, fastf_t x, fastf_t y, fastf_t z)
 {
-    /* Secret text code used in DXF files:
-     *
-     * %%o - toggle overstrike mode
-     * %%u - toggle underscore mode
-     * %%d - degree symbol
-     * %%p - tolerance symbol (plus/minus)
-     * %%c - diameter symbol (circle with line through it, lower left to upper right
-     * %%% - percent symbol
-     */
+    if (!ctx->polyline_verts) {
+	ctx->polyline_verts = (fastf_t *)bu_malloc(POLYLINE_VERTEX_BLOCK*3*sizeof(fastf_t), "polyline_verts");
+	ctx->polyline_vertex_count = 0;
+	ctx->polyline_vertex_max = POLYLINE_VERTEX_BLOCK;
+    } else if (ctx->polyline_vertex_count >= ctx->polyline_vertex_max) {
+	ctx->polyline_vertex_max += POLYLINE_VERTEX_BLOCK;
+	ctx->polyline_verts = (fastf_t *)bu_realloc(ctx->polyline_verts, ctx->polyline_vertex_max * 3 * sizeof(fastf_t), "polyline_verts");
+    }
+
+    VSET(&ctx->polyline_verts[ctx->polyline_vertex_count*3], x, y, z);
+    ctx->polyline_vertex_count++;
+
+    if (ctx->verbose) {
+	bu_log("Added polyline vertex (%g %g %g) #%d\n", x, y, z, ctx->polyline_vertex_count);
+    }
+}
+
+
+/* make room for count more POINTs on a layer */
+static void
+point_reserve(struct layer *lp, size_t count)
+{
+    if (lp->point_count + count > lp->point_max) {
+	lp->point_max = lp->point_max ? lp->point_max : WIRE_BLOCK;
+	while (lp->point_count + count > lp->point_max) {
+	    lp->point_max *= 2;
+	}
+	lp->point_pts = (fastf_t *)bu_realloc(lp->point_pts, lp->point_max * 3 * sizeof(fastf_t), "point_pts");
+    }
+}
 
-    static char *theText=NULL;
-    static int horizAlignment = 0;
-    static int vertAlignment = 0;
-    static int textFlag = 0;
-    static point_t firstAlignmentPoint = VINIT_ZERO;
-    static point_t secondAlignmentPoint = VINIT_ZERO;
-    static double textScale = 1.0;
-    static double textHeight;
-    static double textRotation = 0.0;
+
+static int
+process_point_entities_code(struct dxf_import *ctx, int code)
+{
+    struct point_entity *ent = &ctx->point_ent;
     point_t tmp_pt;
     int coord;
 
     switch (code) {
-	case 1:
-	    theText = bu_strdup(line);
-	    break;
 	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
 	    }
-	    curr_layer_name = make_brlcad_name(line);
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
 	    break;
 	case 10:
 	case 20:
 	case 30:
-	    coord = (code / 10) - 1;
-	    firstAlignmentPoint[coord] = atof(line) * units_conv[units] * scale_factor;
+	    coord = code / 10 - 1;
+	    ent->pt[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
 	    break;
-	case 11:
-	case 21:
-	case 31:
-	    coord = (code / 10) - 1;
-	    secondAlignmentPoint[coord] = atof(line) * units_conv[units] * scale_factor;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
 	    break;
-	case 40:
-	    textHeight = atof(line);
+	case 0:
+	    get_layer(ctx);
+	    VMOVE(tmp_pt, ent->pt);
+	    xform_points(ctx->curr_state, tmp_pt, 1);
+	    {
+		struct layer *lp = ctx->layers[ctx->curr_layer];
+
+		point_reserve(lp, 1);
+		VMOVE(&lp->point_pts[lp->point_count * 3], tmp_pt);
+		lp->point_count++;
+	    }
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
 	    break;
-	case 41:
-	    textScale = atof(line);
+    }
+
+    return 0;
+}
+
+
+static int
+process_entities_polyline_vertex_code(struct dxf_import *ctx, int code)
+{
+    struct vertex_entity *ent = &ctx->vertex_ent;
+    int coord;
+
+    switch (code) {
+	case -1:	/* initialize */
+	    ent->face[0] = 0;
+	    ent->face[1] = 0;
+	    ent->face[2] = 0;
+	    ent->face[3] = 0;
+	    ent->vertex_flag = 0;
+	    return 0;
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
 	    break;
-	case 50:
-	    textRotation = atof(line);
+	case 70:	/* vertex flag */
+	    ent->vertex_flag = atoi(ctx->line);
+	    break;
+	case 71:
+	case 72:
+	case 73:
+	case 74:
+	    coord = (code % 70) - 1;
+	    ent->face[coord] = abs(atoi(ctx->line));
+	    break;
+	case 0:
+	    get_layer(ctx);
+	    if (ent->vertex_flag == POLY_VERTEX_FACE) {
+		add_triangle(ctx, ctx->polyline_vert_indices[ent->face[0]-1],
+			     ctx->polyline_vert_indices[ent->face[1]-1],
+			     ctx->polyline_vert_indices[ent->face[2]-1],
+			     ctx->curr_layer);
+		if (ent->face[3] > 0) {
+		    add_triangle(ctx, ctx->polyline_vert_indices[ent->face[2]-1],
+				 ctx->polyline_vert_indices[ent->face[3]-1],
+				 ctx->polyline_vert_indices[ent->face[0]-1],
+				 ctx->curr_layer);
+		}
+	    } else if (ent->vertex_flag & POLY_VERTEX_3D_M) {
+		point_t tmp_pt1;
+		if (ctx->polyline_vert_indices_count >= ctx->polyline_vert_indices_max) {
+		    ctx->polyline_vert_indices_max += POLYLINE_VERTEX_BLOCK;
+		    ctx->polyline_vert_indices = (int *)bu_realloc(ctx->polyline_vert_indices,
+							      ctx->polyline_vert_indices_max * sizeof(int),
+							      "polyline_vert_indices");
+		}
+		VSET(tmp_pt1, ent->x, ent->y, ent->z);
+		xform_points(ctx->curr_state, tmp_pt1, 1);
+		ctx->polyline_vert_indices[ctx->polyline_vert_indices_count++] = bn_vert_tree_add(ctx->layers[ctx->curr_layer]->vert_tree, tmp_pt1[X], tmp_pt1[Y], tmp_pt1[Z], ctx->tol_sq);
+		if (ctx->verbose) {
+		    bu_log("Added 3D mesh vertex (%g %g %g) index = %d, number = %d\n",
+			   ent->x, ent->y, ent->z, ctx->polyline_vert_indices[ctx->polyline_vert_indices_count-1],
+			   ctx->polyline_vert_indices_count-1);
+		}
+	    } else {
+		add_polyline_vertex(ctx, ent->x, ent->y, ent->z);
+	    }
+	    ctx->curr_state->sub_state = POLYLINE_ENTITY_STATE;
+	    if (ctx->verbose) {
+		bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+	    }
+	    return process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 10:
+	    ent->x = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 20:
+	    ent->y = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 30:
+	    ent->z = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
 	    break;
 	case 62:	/* color number */
-	    curr_color = atoi(line);
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_entities_polyline_code(struct dxf_import *ctx, int code)
+{
+
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 0:		/* text string */
+	    get_layer(ctx);
+	    if (!bu_strncmp(ctx->line, "SEQEND", 6)) {
+		/* build any polyline meshes here */
+		if (ctx->polyline_flag & POLY_3D_MESH) {
+		    if (ctx->polyline_vert_indices_count == 0) {
+			return 0;
+		    } else if (ctx->polyline_vert_indices_count != ctx->mesh_m_count * ctx->mesh_n_count) {
+			bu_log("Incorrect number of vertices for polygon mesh!!!\n");
+			ctx->polyline_vert_indices_count = 0;
+		    } else {
+			int i, j;
+
+			if (ctx->polyline_vert_indices_count >= ctx->polyline_vert_indices_max) {
+			    ctx->polyline_vert_indices_max = ((ctx->polyline_vert_indices_count % POLYLINE_VERTEX_BLOCK) + 1) *
+				POLYLINE_VERTEX_BLOCK;
+			    ctx->polyline_vert_indices = (int *)bu_realloc(ctx->polyline_vert_indices,
+								      ctx->polyline_vert_indices_max * sizeof(int),
+								      "polyline_vert_indices");
+			}
+
+			if (ctx->mesh_m_count < 2) {
+			    if (ctx->mesh_n_count > 4) {
+				bu_log("Cannot handle polyline meshes with m<2 and n>4\n");
+				ctx->polyline_vert_indices_count = 0;
+				ctx->polyline_vert_indices_count = 0;
+				break;
+			    }
+			    if (ctx->mesh_n_count < 3) {
+				ctx->polyline_vert_indices_count = 0;
+				ctx->polyline_vert_indices_count = 0;
+				break;
+			    }
+			    add_triangle(ctx, ctx->polyline_vert_indices[0],
+					 ctx->polyline_vert_indices[1],
+					 ctx->polyline_vert_indices[2],
+					 ctx->curr_layer);
+			    if (ctx->mesh_n_count == 4) {
+				add_triangle(ctx, ctx->polyline_vert_indices[2],
+					     ctx->polyline_vert_indices[3],
+					     ctx->polyline_vert_indices[0],
+					     ctx->curr_layer);
+			    }
+			}
+
+			for (j = 1; j < ctx->mesh_n_count; j++) {
+			    for (i = 1; i < ctx->mesh_m_count; i++) {
+				add_triangle(ctx, ctx->polyline_vert_indices[PVINDEX(i-1, j-1)],
+					     ctx->polyline_vert_indices[PVINDEX(i-1, j)],
+					     ctx->polyline_vert_indices[PVINDEX(i, j-1)],
+					     ctx->curr_layer);
+				add_triangle(ctx, ctx->polyline_vert_indices[PVINDEX(i-1, j-1)],
+					     ctx->polyline_vert_indices[PVINDEX(i, j-1)],
+					     ctx->polyline_vert_indices[PVINDEX(i, j)],
+					     ctx->curr_layer);
+			    }
+			}
+			ctx->polyline_vert_indices_count = 0;
+			ctx->polyline_vertex_count = 0;
+		    }
+		} else {
+		    xform_points(ctx->curr_state, ctx->polyline_verts, ctx->polyline_vertex_count);
+		    wire_polyline(ctx, ctx->polyline_verts, ctx->polyline_vertex_count,
+				  ctx->polyline_flag & POLY_CLOSED, "polyline");
+		    ctx->polyline_vert_indices_count = 0;
+		    ctx->polyline_vertex_count = 0;
+		}
+
+		ctx->layers[ctx->curr_layer]->polyline_count++;
+		ctx->curr_state->state = ENTITIES_SECTION;
+		ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "VERTEX", 6)) {
+		if (ctx->verbose)
+		    bu_log("Found a POLYLINE VERTEX\n");
+		ctx->curr_state->sub_state = POLYLINE_VERTEX_ENTITY_STATE;
+		process_entities_code[POLYLINE_VERTEX_ENTITY_STATE](ctx, -1);
+		break;
+	    } else {
+		if (ctx->verbose) {
+		    bu_log("Unrecognized text string while in polyline entity: %s\n", ctx->line);
+		}
+		break;
+	    }
+	case 70:	/* polyline flag */
+	    ctx->polyline_flag = atoi(ctx->line);
 	    break;
 	case 71:
-	    textFlag = atoi(line);
+	    ctx->mesh_m_count = atoi(ctx->line);
 	    break;
 	case 72:
-	    horizAlignment = atoi(line);
+	    ctx->mesh_n_count = atoi(ctx->line);
 	    break;
-	case 73:
-	    vertAlignment = atoi(line);
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
 	    break;
-	case 0:
-	    if (theText != NULL) {
-		if (verbose) {
-		    bu_log("TEXT (%s), height = %g, scale = %g\n", theText, textHeight, textScale);
-		}
-		/* draw the text */
-		get_layer();
+	case 60:
+	    ctx->invisible = atoi(ctx->line);
+	    break;
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static void
+insert_init(struct insert_data *ins)
+{
+    VSETALL(ins->scale, 1.0);
+    ins->rotation = 0.0;
+    VSETALL(ins->insert_pt, 0.0);
+    VSET(ins->extrude_dir, 0, 0, 1);
+    ins->cols = ins->rows = 1;
+    ins->col_spacing = ins->row_spacing = 0.0;
+}
+
+
+/*
+ * Transform of one cell of an INSERT grid, counted along the rows.
+ * The spacing is measured along the rotated block axes, unscaled.
+ * The insertion point and spacing are in mm, like the block contents.
+ */
+static void
+insert_xform(mat_t xform, const struct insert_data *ins, int cell, const mat_t parent)
+{
+    mat_t xlate, scale, rot, tmp1, tmp2;
+    fastf_t angle = ins->rotation * DEG2RAD;
+    fastf_t dx = (cell % ins->cols) * ins->col_spacing;
+    fastf_t dy = (cell / ins->cols) * ins->row_spacing;
+    point_t pt;
+
+    VSET(pt, ins->insert_pt[X] + dx * cos(angle) - dy * sin(angle),
+	 ins->insert_pt[Y] + dx * sin(angle) + dy * cos(angle),
+	 ins->insert_pt[Z]);
+
+    MAT_IDN(xlate);
+    MAT_IDN(scale);
+    MAT_SCALE_VEC(scale, ins->scale);
+    MAT_DELTAS_VEC(xlate, pt);
+    bn_mat_angles(rot, 0.0, 0.0, ins->rotation);
+    bn_mat_mul(tmp1, rot, scale);
+    bn_mat_mul(tmp2, xlate, tmp1);
+    bn_mat_mul(xform, tmp2, parent);
+}
+
+
+static int
+process_entities_unknown_code(struct dxf_import *ctx, int code)
+{
+    struct state_data *tmp_state;
+
+    ctx->invisible = 0;
+
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 0:		/* text string */
+	    if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "POLYLINE", 8)) {
+		if (ctx->verbose)
+		    bu_log("Found a POLYLINE\n");
+		ctx->curr_state->sub_state = POLYLINE_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "LWPOLYLINE", 10)) {
+		if (ctx->verbose)
+		    bu_log("Found a LWPOLYLINE\n");
+		ctx->curr_state->sub_state = LWPOLYLINE_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "3DFACE", 6)) {
+		ctx->curr_state->sub_state = FACE3D_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "CIRCLE")) {
+		ctx->curr_state->sub_state = CIRCLE_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "ELLIPSE")) {
+		ctx->curr_state->sub_state = ELLIPSE_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "SPLINE")) {
+		ctx->curr_state->sub_state = SPLINE_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "ARC")) {
+		ctx->curr_state->sub_state = ARC_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "DIMENSION")) {
+		ctx->curr_state->sub_state = DIMENSION_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "LINE", 4)) {
+		ctx->curr_state->sub_state = LINE_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "POINT")) {
+		ctx->curr_state->sub_state = POINT_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "LEADER")) {
+		ctx->curr_state->sub_state = LEADER_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "MTEXT")) {
+		ctx->curr_state->sub_state = MTEXT_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "TEXT")) {
+		ctx->curr_state->sub_state = TEXT_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "ATTRIB")) {
+		ctx->curr_state->sub_state = ATTRIB_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "ATTDEF")) {
+		ctx->curr_state->sub_state = ATTDEF_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "SOLID")) {
+		ctx->curr_state->sub_state = SOLID_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (!bu_strncmp(ctx->line, "VIEWPORT", 8)) {
+		/* not a useful entity, just ignore it */
+		break;
+	    } else if (!bu_strncmp(ctx->line, "INSERT", 6)) {
+		ctx->curr_state->sub_state = INSERT_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("sub_state changed to %d\n", ctx->curr_state->sub_state);
+		}
+		break;
+	    } else if (BU_STR_EQUAL(ctx->line, "ENDBLK")) {
+		if (ctx->block_body && BU_LIST_IS_EMPTY(&ctx->state_stack)) {
+		    /* end of the definition being imported */
+		    fclose(ctx->dxf);
+		    ctx->dxf = NULL;
+		    break;
+		}
+		if (++ctx->curr_state->cell < ctx->curr_state->cells && BU_LIST_NON_EMPTY(&ctx->state_stack)) {
+		    /* on to the next cell of the grid */
+		    tmp_state = BU_LIST_FIRST(state_data, &ctx->state_stack);
+		    insert_xform(ctx->curr_state->xform, &ctx->curr_state->ins, ctx->curr_state->cell, tmp_state->xform);
+		    ctx->curr_state->xform_type = xform_classify(ctx->curr_state->xform);
+		    bu_fseek(ctx->dxf, ctx->curr_state->curr_block->offset, SEEK_SET);
+		    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		    break;
+		}
+		/* found end of an inserted block, pop the state stack */
+		tmp_state = ctx->curr_state;
+		BU_LIST_POP(state_data, &ctx->state_stack, ctx->curr_state);
+		if (!ctx->curr_state) {
+		    bu_log("ERROR: end of block encountered while not inserting!!!\n");
+		    ctx->curr_state = tmp_state;
+		    break;
+		}
+		bu_free((char *)tmp_state, "curr_state");
+		bu_fseek(ctx->dxf, ctx->curr_state->file_offset, SEEK_SET);
+		ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("Popped state at end of inserted block (seeked to %jd)\n", (intmax_t)ctx->curr_state->file_offset);
+		}
+		break;
+	    } else {
+		bu_log("Unrecognized entity type encountered (ignoring): %s\n",
+		       ctx->line);
+		break;
+	    }
+    }
+
+    return 0;
+}
+
+
+static void add_block_instance(struct dxf_import *ctx, struct block_list *blk, mat_t xform);
+static int replay_block(struct dxf_import *ctx, struct block_list *blk, const mat_t xform);
+
+
+static int
+process_insert_entities_code(struct dxf_import *ctx, int code)
+{
+    struct insert_entity *ent = &ctx->insert_ent;
+    struct block_list *blk;
+    int coord;
+
+    if (!ent->new_state) {
+	insert_init(&ent->ins);
+	BU_ALLOC(ent->new_state, struct state_data);
+	*ent->new_state = *ctx->curr_state;
+	ent->new_state->cell = ent->new_state->cells = 0;
+	if (ctx->verbose) {
+	    bu_log("Created a new state for INSERT\n");
+	}
+    }
+
+    switch (code) {
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 2:		/* block name */
+	    for (BU_LIST_FOR(blk, block_list, &ctx->block_head)) {
+		if (BU_STR_EQUAL(blk->block_name, ctx->line)) {
+		    break;
+		}
+	    }
+	    if (BU_LIST_IS_HEAD(blk, &ctx->block_head)) {
+		bu_log("ERROR: INSERT references non-existent block (%s)\n", ctx->line);
+		bu_log("\tignoring missing block\n");
+		blk = NULL;
+	    }
+	    ent->new_state->curr_block = blk;
+	    if (ctx->verbose && blk) {
+		bu_log("Inserting block %s\n", blk->block_name);
+	    }
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    coord = (code / 10) - 1;
+	    ent->ins.insert_pt[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 41:
+	case 42:
+	case 43:
+	    coord = (code % 40) - 1;
+	    ent->ins.scale[coord] = atof(ctx->line);
+	    break;
+	case 50:
+	    ent->ins.rotation = atof(ctx->line);
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 70:	/* column count */
+	    ent->ins.cols = atoi(ctx->line);
+	    V_MAX(ent->ins.cols, 1);
+	    break;
+	case 71:	/* row count */
+	    ent->ins.rows = atoi(ctx->line);
+	    V_MAX(ent->ins.rows, 1);
+	    break;
+	case 44:
+	    ent->ins.col_spacing = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 45:
+	    ent->ins.row_spacing = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 210:
+	case 220:
+	case 230:
+	    coord = ((code / 10) % 20) - 1;
+	    ent->ins.extrude_dir[coord] = atof(ctx->line);
+	    break;
+	case 0:		/* end of this insert */
+	    if (ent->new_state->curr_block) {
+		int cells = ent->ins.cols * ent->ins.rows;
+		int cell;
+
+		/* every cell of a grid references the same library entry or recording */
+		get_layer(ctx);
+		for (cell = 0; cell < cells; cell++) {
+		    insert_xform(ent->new_state->xform, &ent->ins, cell, ctx->curr_state->xform);
+		    if (ctx->recording) {
+			struct block_ref *ref;
+
+			BU_ALLOC(ref, struct block_ref);
+			ref->blk = ent->new_state->curr_block;
+			MAT_COPY(ref->xform, ent->new_state->xform);
+			bu_ptbl_ins(&ctx->layers[ctx->curr_layer]->refs, (long *)ref);
+		    } else if (ctx->blocks) {
+			add_block_instance(ctx, ent->new_state->curr_block, ent->new_state->xform);
+		    } else if (!replay_block(ctx, ent->new_state->curr_block, ent->new_state->xform)) {
+			break;
+		    }
+		}
+		ent->new_state->xform_type = xform_classify(ent->new_state->xform);
+		if (cell >= cells) {
+		    bu_free(ent->new_state, "new_state");
+		    ent->new_state = NULL;
+		    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+		    break;
+		}
+
+		/* the recording cannot be replayed under this transform, expand the rest of the grid in place */
+		ent->new_state->ins = ent->ins;
+		ent->new_state->cell = cell;
+		ent->new_state->cells = cells;
+		BU_LIST_PUSH(&ctx->state_stack, &(ctx->curr_state->l));
+		ctx->curr_state = ent->new_state;
+		ent->new_state = NULL;
+		bu_fseek(ctx->dxf, ctx->curr_state->curr_block->offset, SEEK_SET);
+		ctx->curr_state->state = ENTITIES_SECTION;
+		ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		if (ctx->verbose) {
+		    bu_log("Changing state for INSERT\n");
+		    bu_log("seeked to %jd\n", (intmax_t)ctx->curr_state->curr_block->offset);
+		    bn_mat_print("state xform", ctx->curr_state->xform);
+		}
+	    }
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_solid_entities_code(struct dxf_import *ctx, int code)
+{
+    struct solid_entity *ent = &ctx->solid_ent;
+    int vert_no;
+    int coord;
+
+    switch (code) {
+	case 8:
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("LINE is in layer: %s\n", ctx->curr_layer_name);
+	    }
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	case 11:
+	case 21:
+	case 31:
+	case 12:
+	case 22:
+	case 32:
+	case 13:
+	case 23:
+	case 33:
+	    vert_no = code % 10;
+	    V_MAX(ent->last_vert_no, vert_no);
+
+	    coord = code / 10 - 1;
+	    ent->solid_pt[vert_no][coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("SOLID vertex #%d coord #%d = %g\n", vert_no, coord, ent->solid_pt[vert_no][coord]);
+	    }
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* end of this solid */
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found end of SOLID\n");
+	    }
+
+	    ctx->layers[ctx->curr_layer]->solid_count++;
+
+	    xform_points(ctx->curr_state, ent->solid_pt[0], ent->last_vert_no + 1);
+
+	    /* closed outline */
+	    wire_polyline(ctx, ent->solid_pt[0], ent->last_vert_no + 1, 1, "solid");
+
+	    ent->last_vert_no = -1;
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_lwpolyline_entities_code(struct dxf_import *ctx, int code)
+{
+    struct lwpolyline_entity *ent = &ctx->lwpolyline_ent;
+
+    switch (code) {
+	case 8:
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("LINE is in layer: %s\n", ctx->curr_layer_name);
+	    }
+	    break;
+	case 90:
+	    /* oops */
+	    break;
+	case 10:
+	    ent->x = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("LWPolyLine vertex #%d (x) = %g\n", ent->vert_no, ent->x);
+	    }
+	    break;
+	case 20:
+	    ent->y = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("LWPolyLine vertex #%d (y) = %g\n", ent->vert_no, ent->y);
+	    }
+	    add_polyline_vertex(ctx, ent->x, ent->y, 0.0);
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 70:
+	    ctx->polyline_flag = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* end of this line */
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found end of LWPOLYLINE\n");
+	    }
+
+	    ctx->layers[ctx->curr_layer]->lwpolyline_count++;
+
+	    if (ctx->polyline_vertex_count > 1) {
+		xform_points(ctx->curr_state, ctx->polyline_verts, ctx->polyline_vertex_count);
+		wire_polyline(ctx, ctx->polyline_verts, ctx->polyline_vertex_count,
+			      ctx->polyline_flag & POLY_CLOSED, "lwpolyline");
+	    }
+	    ctx->polyline_vert_indices_count = 0;
+	    ctx->polyline_vertex_count = 0;
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_line_entities_code(struct dxf_import *ctx, int code)
+{
+    struct line_entity *ent = &ctx->line_ent;
+    int vert_no;
+    int coord;
+
+    switch (code) {
+	case 8:
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("LINE is in layer: %s\n", ctx->curr_layer_name);
+	    }
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	case 11:
+	case 21:
+	case 31:
+	    vert_no = code % 10;
+	    coord = code / 10 - 1;
+	    ent->line_pt[vert_no][coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("LINE vertex #%d coord #%d = %g\n", vert_no, coord, ent->line_pt[vert_no][coord]);
+	    }
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* end of this line */
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found end of LINE\n");
+	    }
+
+	    ctx->layers[ctx->curr_layer]->line_count++;
+
+	    xform_points(ctx->curr_state, ent->line_pt[0], 2);
+
+	    wire_polyline(ctx, ent->line_pt[0], 2, 0, "line");
+
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_ellipse_entities_code(struct dxf_import *ctx, int code)
+{
+    struct ellipse_entity *ent = &ctx->ellipse_ent;
+    double delta, sweep;
+    double majorRadius, minorRadius;
+    vect_t xdir, ydir, zdir;
+    int coord;
+    int num_segs;
+
+    switch (code) {
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    coord = code / 10 - 1;
+	    ent->center[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 11:
+	case 21:
+	case 31:
+	    coord = code / 10 - 1;
+	    ent->majorAxis[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 40:
+	    ent->ratio = atof(ctx->line);
+	    break;
+	case 41:
+	    ent->startAngle = atof(ctx->line);
+	    break;
+	case 42:
+	    ent->endAngle = atof(ctx->line);
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* end of this ellipse entity
+	     * make a series of wire edges in the NMG to approximate a circle
+	     */
+
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found an ellipse\n");
+	    }
+
+	    ctx->layers[ctx->curr_layer]->ellipse_count++;
+
+	    while (ent->endAngle <= ent->startAngle) {
+		ent->endAngle += M_2PI;
+	    }
+
+	    if (ctx->native_curves) {
+		vect_t minorAxis;
+
+		VSET(zdir, 0, 0, 1);
+		VCROSS(minorAxis, zdir, ent->majorAxis);
+		VSCALE(minorAxis, minorAxis, ent->ratio);
+		wire_conic(ctx, ent->center, ent->majorAxis, minorAxis, ent->startAngle, ent->endAngle);
+
+		VSET(ent->center, 0, 0, 0);
+		VSET(ent->majorAxis, 0, 0, 0);
+		ent->ratio = 1.0;
+		ent->startAngle = 0.0;
+		ent->endAngle = M_2PI;
+
+		ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		process_entities_code[ctx->curr_state->sub_state](ctx, code);
+		break;
+	    }
+
+	    majorRadius = MAGNITUDE(ent->majorAxis);
+	    minorRadius = ent->ratio * majorRadius;
+
+	    VMOVE(xdir, ent->majorAxis);
+	    VUNITIZE(xdir);
+	    VSET(zdir, 0, 0, 1);
+	    VCROSS(ydir, zdir, xdir);
+
+	    if (ctx->verbose) {
+		bu_log("Ellipse:\n");
+		bu_log("\tcenter = (%g %g %g)\n", V3ARGS(ent->center));
+		bu_log("\tmajorAxis = (%g %g %g)\n", V3ARGS(ent->majorAxis));
+		bu_log("\txdir = (%g %g %g)\n", V3ARGS(xdir));
+		bu_log("\tydir = (%g %g %g)\n", V3ARGS(ydir));
+		bu_log("\tradii = %g %g\n", majorRadius, minorRadius);
+		bu_log("\tangles = %g %g\n", ent->startAngle, ent->endAngle);
+	    }
+
+	    /* make wire edges */
+	    sweep = ent->endAngle - ent->startAngle;
+	    delta = M_PI / 15.0;
+	    if (sweep/delta < 4) {
+		delta = sweep / 5.0;
+	    }
+	    num_segs = (delta > SMALL_FASTF) ? (int)ceil(sweep / delta - 1.0e-9) : 1;
+	    num_segs = curve_segments(ctx, majorRadius * xform_scale(ctx->curr_state->xform), sweep, num_segs);
+	    if (ctx->chord_error > SMALL_FASTF) {
+		delta = sweep / (fastf_t)num_segs;
+	    }
+	    VSCALE(ydir, ydir, minorRadius);
+	    curve_queue(ctx, CURVE_ELLIPSE, ent->center, ent->majorAxis, ydir,
+			ent->startAngle, delta, ent->endAngle, num_segs, 0);
+
+	    VSET(ent->center, 0, 0, 0);
+	    VSET(ent->majorAxis, 0, 0, 0);
+	    ent->ratio = 1.0;
+	    ent->startAngle = 0.0;
+	    ent->endAngle = M_2PI;
+
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_circle_entities_code(struct dxf_import *ctx, int code)
+{
+    struct circle_entity *ent = &ctx->circle_ent;
+    vect_t a, b;
+    int num_segs;
+    int coord;
+
+    switch (code) {
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    coord = code / 10 - 1;
+	    ent->center[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("CIRCLE center coord #%d = %g\n", coord, ent->center[coord]);
+	    }
+	    break;
+	case 40:
+	    ent->radius = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* end of this circle entity
+	     * make a series of wire edges in the NMG to approximate a circle
+	     */
+		
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found a circle\n");
+	    }
+
+	    ctx->layers[ctx->curr_layer]->circle_count++;
+
+	    if (ctx->native_curves) {
+		wire_arc(ctx, ent->center, ent->radius, 0.0, M_2PI);
+		ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		process_entities_code[ctx->curr_state->sub_state](ctx, code);
+		break;
+	    }
+
+	    num_segs = curve_segments(ctx, ent->radius * xform_scale(ctx->curr_state->xform), M_2PI, ctx->segs_per_circle);
+	    VSET(a, ent->radius, 0.0, 0.0);
+	    VSET(b, 0.0, ent->radius, 0.0);
+	    curve_queue(ctx, CURVE_CIRCLE, ent->center, a, b, 0.0, M_2PI / num_segs, M_2PI, num_segs, 1);
+
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+/* horizontal alignment codes for text */
+#define LEFT 0
+#define CENTER 1
+#define RIGHT 2
+#define ALIGNED 3
+#define HMIDDLE 4
+#define FIT 5
+
+/* vertical alignment codes */
+#define BASELINE 0
+#define BOTTOM 1
+#define VMIDDLE 2
+#define TOP 3
+
+/* attachment point codes */
+#define TOPLEFT 1
+#define TOPCENTER 2
+#define TOPRIGHT 3
+#define MIDDLELEFT 4
+#define MIDDLECENTER 5
+#define MIDDLERIGHT 6
+#define BOTTOMLEFT 7
+#define BOTTOMCENTER 8
+#define BOTTOMRIGHT 9
+
+/* secret codes for MTEXT entries
+ * \P - new paragraph (line)
+ * \X - new line (everything before is above the dimension line, everything after is below)
+ * \~ - blank space
+ * \f - TrueType font
+ * \F - .SHX font
+ * ex:
+ * Hello \fArial;World
+ * or:
+ * Hello {\fArial;World}
+ */
+
+static int
+convertSecretCodes(struct dxf_import *ctx, char *c, char *cp, int *maxLineLen)
+{
+    int lineCount = 0;
+    int lineLen = 0;
+
+    while (*c) {
+	if (*c == '%' && *(c+1) == '%') {
+	    switch (*(c+2)) {
+		case 'o':
+		case 'O':
+		    ctx->overstrikemode = !ctx->overstrikemode;
+		    c += 3;
+		    break;
+		case 'u':
+		case 'U':
+		    ctx->underscoremode = !ctx->underscoremode;
+		    c += 3;
+		    break;
+		case 'd':	/* degree */
+		case 'D':
+		    *cp++ = 8;
+		    c += 3;
+		    break;
+		case 'p':	 /* plus/minus */
+		case 'P':
+		    *cp++ = 6;
+		    c += 3;
+		    break;
+		case 'c':	/* diameter */
+		case 'C':
+		    *cp++ = 7;
+		    c += 3;
+		    break;
+		case '%':
+		    *cp++ = '%';
+		    c += 3;
+		    break;
+		default:
+		    *cp++ = *c;
+		    c++;
+		    break;
+	    }
+	    lineLen++;
+	} else if (*c == '\\') {
+	    switch (*(c+1)) {
+		case 'P':
+		case 'X':
+		    *cp++ = '\n';
+		    c += 2;
+		    lineCount++;
+		    V_MAX(*maxLineLen, lineLen);
+
+		    lineLen = 0;
+		    break;
+		case 'A':
+		    while (*c != ';' && *c != '\0') c++;
+		    c++;
+		    break;
+		case '~':
+		    *cp++ = ' ';
+		    c += 2;
+		    lineLen++;
+		    break;
+		default:
+		    *cp++ = *c++;
+		    lineLen++;
+		    break;
+	    }
+	} else {
+	    *cp++ = *c++;
+	    lineLen++;
+	}
+    }
+    if (*(c-1) != '\n') {
+	lineCount++;
+    }
+
+    V_MAX(*maxLineLen, lineLen);
+
+    return lineCount;
+}
+
+
+/* height and rotation of note once m is applied to it */
+static void
+annotation_xform(struct annotation *note, const mat_t m)
+{
+    vect_t dir, x_dir;
+
+    VSET(dir, cos(note->rotation * DEG2RAD), sin(note->rotation * DEG2RAD), 0.0);
+    MAT4X3VEC(x_dir, m, dir);
+    note->rotation = atan2(x_dir[Y], x_dir[X]) * RAD2DEG;
+    note->height *= xform_scale(m);
+}
+
+
+/*
+ * Keep a string on the current layer instead of stroking it.  pt is
+ * already transformed, height is in drawing units and rotation in
+ * degrees, both before the current transform.
+ */
+static void
+add_annotation(struct dxf_import *ctx, const char *kind, const char *text, const point_t pt, fastf_t height, fastf_t rotation)
+{
+    struct layer *lp = ctx->layers[ctx->curr_layer];
+    struct annotation *note;
+
+    if (lp->note_count >= lp->note_max) {
+	lp->note_max = lp->note_max ? lp->note_max * 2 : 16;
+	lp->notes = (struct annotation *)bu_realloc(lp->notes, lp->note_max * sizeof(struct annotation), "annotations");
+    }
+    note = &lp->notes[lp->note_count++];
+    note->kind = kind;
+    note->text = bu_strdup(text);
+    VMOVE(note->pt, pt);
+    note->height = height * units_conv[ctx->units] * ctx->scale_factor;
+    note->rotation = rotation;
+    if (ctx->curr_state->xform_type != XFORM_IDENTITY) {
+	annotation_xform(note, ctx->curr_state->xform);
+    }
+}
+
+
+static void
+drawString(struct dxf_import *ctx, char *theText, point_t firstAlignmentPoint, point_t secondAlignmentPoint,
+	   double textHeight, double UNUSED(textScale), double textRotation, int horizAlignment, int vertAlignment, int UNUSED(textFlag))
+{
+    double stringLength = 0.0;
+    char *copyOfText;
+    char *c, *cp;
+    vect_t diff;
+    int maxLineLen = 0;
+
+    copyOfText = (char *)bu_calloc((unsigned int)strlen(theText)+1, 1, "copyOfText");
+    c = theText;
+    cp = copyOfText;
+    (void)convertSecretCodes(ctx, c, cp, &maxLineLen);
+
+    bu_free(theText, "theText");
+    stringLength = strlen(copyOfText);
+
+    if (horizAlignment == FIT && vertAlignment == BASELINE) {
+	double allowedLength;
+	double xScale=1.0;
+	double yScale=1.0;
+	double scale;
+
+	/* fit along baseline */
+	VSUB2(diff, firstAlignmentPoint, secondAlignmentPoint);
+	allowedLength = MAGNITUDE(diff);
+	xScale = allowedLength / stringLength;
+	yScale = textHeight;
+	scale = xScale < yScale ? xScale : yScale;
+	wire_string(ctx, copyOfText,
+		    firstAlignmentPoint[X], firstAlignmentPoint[Y],
+		    scale, textRotation);
+    } else if (horizAlignment == LEFT && vertAlignment == BASELINE) {
+	wire_string(ctx, copyOfText,
+		    firstAlignmentPoint[X], firstAlignmentPoint[Y],
+		    textHeight, textRotation);
+    } else if ((horizAlignment == CENTER || horizAlignment == HMIDDLE) && vertAlignment == BASELINE) {
+	double len = stringLength * textHeight;
+	firstAlignmentPoint[X] = secondAlignmentPoint[X] - cos(textRotation) * len / 2.0;
+	firstAlignmentPoint[Y] = secondAlignmentPoint[Y] - sin(textRotation) * len / 2.0;
+	wire_string(ctx, copyOfText,
+		    firstAlignmentPoint[X], firstAlignmentPoint[Y],
+		    textHeight, textRotation);
+    } else if ((horizAlignment == CENTER || horizAlignment == HMIDDLE) && vertAlignment == VMIDDLE) {
+	double len = stringLength * textHeight;
+	firstAlignmentPoint[X] = secondAlignmentPoint[X] - len / 2.0;
+	firstAlignmentPoint[Y] = secondAlignmentPoint[Y] - textHeight / 2.0;
+	firstAlignmentPoint[X] = firstAlignmentPoint[X] - (1.0 - cos(textRotation)) * len / 2.0;
+	firstAlignmentPoint[Y] = firstAlignmentPoint[Y] - sin(textRotation) * len / 2.0;
+	wire_string(ctx, copyOfText,
+		    firstAlignmentPoint[X], firstAlignmentPoint[Y],
+		    textHeight, textRotation);
+    } else if (horizAlignment == RIGHT && vertAlignment == BASELINE) {
+	double len = stringLength * textHeight;
+	firstAlignmentPoint[X] = secondAlignmentPoint[X] - cos(textRotation) * len;
+	firstAlignmentPoint[Y] = secondAlignmentPoint[Y] - sin(textRotation) * len;
+	wire_string(ctx, copyOfText,
+		    firstAlignmentPoint[X], firstAlignmentPoint[Y],
+		    textHeight, textRotation);
+    } else {
+	bu_log("cannot handle this alignment: horiz = %d, vert = %d\n", horizAlignment, vertAlignment);
+    }
+
+    bu_free(copyOfText, "copyOfText");
+}
+
+
+static void
+drawMtext(struct dxf_import *ctx, char *text, int attachPoint, int UNUSED(drawingDirection), double textHeight, double entityHeight,
+	  double charWidth, double UNUSED(rectWidth), double rotationAngle, double insertionPoint[3])
+{
+    int done;
+    char *c;
+    char *cp;
+    int lineCount;
+    double lineSpace;
+    vect_t xdir, ydir;
+    double startx, starty;
+    int maxLineLen = 0;
+    double scale = 1.0;
+    double xdel = 0.0, ydel = 0.0;
+    double radians = rotationAngle * DEG2RAD;
+    char *copyOfText = (char *)bu_calloc((unsigned int)strlen(text)+1, 1, "copyOfText");
+
+    c = text;
+    cp = copyOfText;
+    lineCount = convertSecretCodes(ctx, c, cp, &maxLineLen);
+
+    if (textHeight > 0.0) {
+	scale = textHeight;
+    } else if (charWidth > 0.0) {
+	scale = charWidth;
+    } else if (entityHeight > 0.0) {
+	scale = (entityHeight / (double)lineCount) * 0.9;
+    }
+
+    lineSpace = 1.25 * scale;
+
+    VSET(xdir, cos(radians), sin(radians), 0.0);
+    VSET(ydir, -sin(radians), cos(radians), 0.0);
+
+    switch (attachPoint) {
+	case TOPLEFT:
+	    xdel = 0.0;
+	    ydel =  -scale;
+	    break;
+	case TOPCENTER:
+	    xdel = -((double)maxLineLen * scale) / 2.0;
+	    ydel = -scale;
+	    break;
+	case TOPRIGHT:
+	    xdel = -(double)maxLineLen * scale;
+	    ydel = -scale;
+	    break;
+	case MIDDLELEFT:
+	    xdel = 0.0;
+	    ydel = -((double)lineCount * lineSpace) / 2.0;
+	    break;
+	case MIDDLECENTER:
+	    xdel = -((double)maxLineLen * scale) / 2.0;
+	    ydel = -((double)lineCount * lineSpace) / 2.0;
+	    break;
+	case MIDDLERIGHT:
+	    xdel = -(double)maxLineLen * scale;
+	    ydel = -((double)lineCount * lineSpace) / 2.0;
+	    break;
+	case BOTTOMLEFT:
+	    xdel = 0.0;
+	    ydel = (double)lineCount * lineSpace - scale;
+	    break;
+	case BOTTOMCENTER:
+	    xdel = -((double)maxLineLen * scale) / 2.0;
+	    ydel = (double)lineCount * lineSpace - scale;
+	    break;
+	case BOTTOMRIGHT:
+	    xdel = -(double)maxLineLen * scale;
+	    ydel = (double)lineCount * lineSpace - scale;
+	    break;
+    }
+
+    startx = insertionPoint[X] + xdel * xdir[X] + ydel * ydir[X];
+    starty = insertionPoint[Y] + xdel * xdir[Y] + ydel * ydir[Y];
+
+    cp = copyOfText;
+    c = copyOfText;
+    done = 0;
+    while (!done) {
+	if (*cp == '\n' || *cp == '\0') {
+	    if (*cp == '\0') {
+		done = 1;
+	    }
+	    *cp = '\0';
+	    wire_string(ctx, c, startx, starty, scale, rotationAngle);
+	    c = ++cp;
+	    startx -= lineSpace * ydir[X];
+	    starty -= lineSpace * ydir[Y];
+	} else {
+	    cp++;
+	}
+    }
+
+
+    bu_free(copyOfText, "copyOfText");
+}
+
+
+static int
+process_leader_entities_code(struct dxf_import *ctx, int code)
+{
+    struct leader_entity *ent = &ctx->leader_ent;
+
+    switch (code) {
+	case 8:
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("LINE is in layer: %s\n", ctx->curr_layer_name);
+	    }
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 71:
+	    ent->arrowHeadFlag = atoi(ctx->line);
+	    break;
+	case 72:
+	    /* path type, unimplemented */
+	    break;
+	case 73:
+	    /* creation, unimplemented */
+	    break;
+	case 74:
+	    /* hookline direction, unimplemented */
+	    break;
+	case 75:
+	    /* hookline, unimplemented */
+	    break;
+	case 40:
+	    /* text height, unimplemented */
+	    break;
+	case 41:
+	    /* text width, unimplemented */
+	    break;
+	case 76:
+	    /* num vertices, unimplemented */
+	    break;
+	case 210:
+	    /* normal, unimplemented */
+	    break;
+	case 220:
+	    /* normal, unimplemented */
+	    break;
+	case 230:
+	    /* normal, unimplemented */
+	    break;
+	case 211:
+	    /* horizontal direction, unimplemented */
+	    break;
+	case 221:
+	    /* horizontal direction, unimplemented */
+	    break;
+	case 231:
+	    /* horizontal direction, unimplemented */
+	    break;
+	case 212:
+	    /* offsetB, unimplemented */
+	    break;
+	case 222:
+	    /* offsetB, unimplemented */
+	    break;
+	case 232:
+	    /* offsetB, unimplemented */
+	    break;
+	case 213:
+	    /* offset, unimplemented */
+	    break;
+	case 223:
+	    /* offset, unimplemented */
+	    break;
+	case 233:
+	    /* offset, unimplemented */
+	    break;
+	case 10:
+	    ent->pt[X] = atof(ctx->line);
+	    break;
+	case 20:
+	    ent->pt[Y] = atof(ctx->line);
+	    break;
+	case 30:
+	    ent->pt[Z] = atof(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("LEADER vertex #%d = (%g %g %g)\n", ent->vertNo, V3ARGS(ent->pt));
+	    }
+	    add_polyline_vertex(ctx, V3ARGS(ent->pt));
+	    break;
+	case 0:
+	    /* end of this line */
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found end of LEADER: arrowhead flag = %d\n", ent->arrowHeadFlag);
+	    }
+
+	    ctx->layers[ctx->curr_layer]->leader_count++;
+
+	    xform_points(ctx->curr_state, ctx->polyline_verts, ctx->polyline_vertex_count);
+	    wire_polyline(ctx, ctx->polyline_verts, ctx->polyline_vertex_count, 0, "LEADER");
+	    ctx->polyline_vert_indices_count = 0;
+	    ctx->polyline_vertex_count = 0;
+	    ent->arrowHeadFlag = 0;
+	    ent->vertNo = 0;
+
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_mtext_entities_code(struct dxf_import *ctx, int code)
+{
+    struct mtext_entity *ent = &ctx->mtext_ent;
+    point_t tmp_pt;
+    int coord;
+
+    switch (code) {
+	case 3:
+	    if (!ent->vls) {
+		BU_GET(ent->vls, struct bu_vls);
+		bu_vls_init(ent->vls);
+	    }
+	    bu_vls_strcat(ent->vls, ctx->line);
+	    break;
+	case 1:
+	    if (!ent->vls) {
+		BU_GET(ent->vls, struct bu_vls);
+		bu_vls_init(ent->vls);
+	    }
+	    bu_vls_strcat(ent->vls, ctx->line);
+	    break;
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    coord = (code / 10) - 1;
+	    ent->insertionPoint[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 11:
+	case 21:
+	case 31:
+	    coord = (code / 10) - 1;
+	    ent->xAxisDirection[coord] = atof(ctx->line);
+	    if (code == 31) {
+		ent->rotationAngle = atan2(ent->xAxisDirection[Y], ent->xAxisDirection[X]) * RAD2DEG;
+	    }
+	    break;
+	case 40:
+	    ent->textHeight = atof(ctx->line);
+	    break;
+	case 41:
+	    ent->rectWidth = atof(ctx->line);
+	    break;
+	case 42:
+	    ent->charWidth = atof(ctx->line);
+	    break;
+	case 43:
+	    ent->entityHeight = atof(ctx->line);
+	    break;
+	case 50:
+	    ent->rotationAngle = atof(ctx->line);
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 71:
+	    ent->attachPoint = atoi(ctx->line);
+	    break;
+	case 72:
+	    ent->drawingDirection = atoi(ctx->line);
+	    break;
+	case 0:
+	    if (ctx->verbose) {
+		bu_log("MTEXT (%s), height = %g, entityHeight = %g, rectWidth = %g\n", (ent->vls) ? bu_vls_addr(ent->vls) : "NO_NAME", ent->textHeight, ent->entityHeight, ent->rectWidth);
+		bu_log("\tattachPoint = %d, charWidth = %g, insertPt = (%g %g %g)\n", ent->attachPoint, ent->charWidth, V3ARGS(ent->insertionPoint));
+	    }
+	    /* draw the text */
+	    get_layer(ctx);
+
+	    ctx->layers[ctx->curr_layer]->mtext_count++;
+
+	    /* apply transformation */
+	    MAT4X3PNT(tmp_pt, ctx->curr_state->xform, ent->insertionPoint);
+	    VMOVE(ent->insertionPoint, tmp_pt);
+
+	    if (ctx->annotations) {
+		add_annotation(ctx, "MTEXT", ent->vls ? bu_vls_cstr(ent->vls) : "", ent->insertionPoint,
+			       ent->textHeight, ent->rotationAngle);
+	    } else {
+		char noname[] = "NO_NAME";
+		char *t = NULL;
+		if (ent->vls) {
+		    t = bu_strdup(bu_vls_cstr(ent->vls));
+		}
+		drawMtext(ctx, (t) ? t : noname, ent->attachPoint, ent->drawingDirection, ent->textHeight, ent->entityHeight,
+			  ent->charWidth, ent->rectWidth, ent->rotationAngle, ent->insertionPoint);
+		if (t)
+		    bu_free(t, "temp char buf");
+	    }
+	    bu_vls_free(ent->vls);
+	    BU_PUT(ent->vls, struct bu_vls);
+
+	    ent->attachPoint = 0;
+	    ent->textHeight = 0.0;
+	    ent->entityHeight = 0.0;
+	    ent->charWidth = 0.0;
+	    ent->rectWidth = 0.0;
+	    ent->rotationAngle = 0.0;
+	    VSET(ent->insertionPoint, 0, 0, 0);
+	    VSET(ent->xAxisDirection, 0, 0, 0);
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_text_attrib_entities_code(struct dxf_import *ctx, int code)
+{
+    struct text_entity *ent = &ctx->text_ent;
+    /* Secret text code used in DXF files:
+     *
+     * %%o - toggle overstrike mode
+     * %%u - toggle underscore mode
+     * %%d - degree symbol
+     * %%p - tolerance symbol (plus/minus)
+     * %%c - diameter symbol (circle with line through it, lower left to upper right
+     * %%% - percent symbol
+     */
+
+    point_t tmp_pt;
+    int coord;
+
+    switch (code) {
+	case 1:
+	    ent->theText = bu_strdup(ctx->line);
+	    break;
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    coord = (code / 10) - 1;
+	    ent->firstAlignmentPoint[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 11:
+	case 21:
+	case 31:
+	    coord = (code / 10) - 1;
+	    ent->secondAlignmentPoint[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    break;
+	case 40:
+	    ent->textHeight = atof(ctx->line);
+	    break;
+	case 41:
+	    ent->textScale = atof(ctx->line);
+	    break;
+	case 50:
+	    ent->textRotation = atof(ctx->line);
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 71:
+	    ent->textFlag = atoi(ctx->line);
+	    break;
+	case 72:
+	    ent->horizAlignment = atoi(ctx->line);
+	    break;
+	case 73:
+	    ent->vertAlignment = atoi(ctx->line);
+	    break;
+	case 0:
+	    if (ent->theText != NULL) {
+		if (ctx->verbose) {
+		    bu_log("TEXT (%s), height = %g, scale = %g\n", ent->theText, ent->textHeight, ent->textScale);
+		}
+		/* draw the text */
+		get_layer(ctx);
+
+		/* apply transformation */
+		MAT4X3PNT(tmp_pt, ctx->curr_state->xform, ent->firstAlignmentPoint);
+		VMOVE(ent->firstAlignmentPoint, tmp_pt);
+		MAT4X3PNT(tmp_pt, ctx->curr_state->xform, ent->secondAlignmentPoint);
+		VMOVE(ent->secondAlignmentPoint, tmp_pt);
+
+		if (ctx->annotations) {
+		    const char *kind = "TEXT";
+
+		    if (ctx->curr_state->sub_state == ATTRIB_ENTITY_STATE) {
+			kind = "ATTRIB";
+		    } else if (ctx->curr_state->sub_state == ATTDEF_ENTITY_STATE) {
+			kind = "ATTDEF";
+		    }
+		    add_annotation(ctx, kind, ent->theText, ent->firstAlignmentPoint, ent->textHeight, ent->textRotation);
+		    bu_free(ent->theText, "theText");
+		} else {
+		    /* drawString() frees the text */
+		    drawString(ctx, ent->theText, ent->firstAlignmentPoint, ent->secondAlignmentPoint,
+			       ent->textHeight, ent->textScale, ent->textRotation, ent->horizAlignment, ent->vertAlignment, ent->textFlag);
+		}
+		ent->theText = NULL;
+		ctx->layers[ctx->curr_layer]->text_count++;
+	    }
+	    ent->horizAlignment = 0;
+	    ent->vertAlignment = 0;
+	    ent->textFlag = 0;
+	    VSET(ent->firstAlignmentPoint, 0.0, 0.0, 0.0);
+	    VSET(ent->secondAlignmentPoint, 0.0, 0.0, 0.0);
+	    ent->textScale = 1.0;
+	    ent->textRotation = 0.0;
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_dimension_entities_code(struct dxf_import *ctx, int code)
+{
+    struct dimension_entity *ent = &ctx->dimension_ent;
+    struct block_list *blk;
+
+    switch (code) {
+	case 10:
+	case 20:
+	case 30:
+	    break;
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 2:	/* block name */
+	    ent->block_name = bu_strdup(ctx->line);
+	    break;
+	case 0:
+	    if (ent->block_name != NULL) {
+		/* insert this dimension block */
+		get_layer(ctx);
+		BU_ALLOC(ent->new_state, struct state_data);
+		*ent->new_state = *ctx->curr_state;
+		ent->new_state->cell = ent->new_state->cells = 0;
+		if (ctx->verbose) {
+		    bu_log("Created a new state for DIMENSION\n");
+		}
+		for (BU_LIST_FOR(blk, block_list, &ctx->block_head)) {
+		    if (ent->block_name) {
+			if (BU_STR_EQUAL(blk->block_name, ent->block_name)) {
+			    break;
+			}
+		    }
+		}
+		if (BU_LIST_IS_HEAD(blk, &ctx->block_head)) {
+		    bu_log("ERROR: DIMENSION references non-existent block (%s)\n", ent->block_name);
+		    bu_log("\tignoring missing block\n");
+		    blk = NULL;
+		}
+		ent->new_state->curr_block = blk;
+		if (ctx->verbose && blk) {
+		    bu_log("Inserting block %s\n", blk->block_name);
+		}
+
+		if (ent->block_name) {
+		    bu_free(ent->block_name, "block_name");
+		    ent->block_name = NULL;
+		}
+
+		if (!ent->new_state->curr_block) {
+		    bu_free(ent->new_state, "new_state");
+		    ent->new_state = NULL;
+		} else {
+		    BU_LIST_PUSH(&ctx->state_stack, &(ctx->curr_state->l));
+		    ctx->curr_state = ent->new_state;
+		    ent->new_state = NULL;
+		    bu_fseek(ctx->dxf, ctx->curr_state->curr_block->offset, SEEK_SET);
+		    ctx->curr_state->state = ENTITIES_SECTION;
+		    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		    if (ctx->verbose) {
+			bu_log("Changing state for INSERT\n");
+			bu_log("seeked to %jd\n", (intmax_t)ctx->curr_state->curr_block->offset);
+		    }
+		    ctx->layers[ctx->curr_layer]->dimension_count++;
+		}
+	    } else {
+		ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    }
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_arc_entities_code(struct dxf_import *ctx, int code)
+{
+    struct arc_entity *ent = &ctx->arc_ent;
+    fastf_t delta;
+    vect_t a, b;
+    int num_segs;
+    int coord;
+
+    switch (code) {
+	case 8:		/* layer name */
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    coord = code / 10 - 1;
+	    ent->center[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("ARC center coord #%d = %g\n", coord, ent->center[coord]);
+	    }
+	    break;
+	case 40:
+	    ent->radius = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("ARC radius = %g\n", ent->radius);
+	    }
+	    break;
+	case 50:
+	    ent->start_angle = atof(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("ARC start angle = %g\n", ent->start_angle);
+	    }
+	    break;
+	case 51:
+	    ent->end_angle = atof(ctx->line);
+	    if (ctx->verbose) {
+		bu_log("ARC end angle = %g\n", ent->end_angle);
+	    }
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* end of this arc entity
+	     * make a series of wire edges in the NMG to approximate an arc
+	     */
+
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found an arc\n");
+	    }
+
+	    ctx->layers[ctx->curr_layer]->arc_count++;
+
+	    while (ent->end_angle < ent->start_angle) {
+		ent->end_angle += 360.0;
+	    }
+
+	    if (ctx->native_curves) {
+		fastf_t end_angle = ent->end_angle;
+
+		if (NEAR_EQUAL(end_angle, ent->start_angle, SMALL_FASTF)) {
+		    end_angle += 360.0;
+		}
+		wire_arc(ctx, ent->center, ent->radius, ent->start_angle * DEG2RAD, end_angle * DEG2RAD);
+
+		VSETALL(ent->center, 0.0);
+		ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+		process_entities_code[ctx->curr_state->sub_state](ctx, code);
+		break;
+	    }
+
+	    /* fixed steps of a full circle's chord angle, the last chord ends at end_angle */
+	    num_segs = (ent->end_angle - ent->start_angle) / 360.0 * ctx->segs_per_circle;
+	    ent->start_angle *= DEG2RAD;
+	    ent->end_angle *= DEG2RAD;
+	    V_MAX(num_segs, 1);
+	    num_segs = curve_segments(ctx, ent->radius * xform_scale(ctx->curr_state->xform), ent->end_angle - ent->start_angle, num_segs);
+	    if (ctx->verbose) {
+		bu_log("arc has %d segs\n", num_segs);
+	    }
+
+	    delta = (ctx->chord_error > SMALL_FASTF) ? (ent->end_angle - ent->start_angle) / num_segs : M_2PI / ctx->segs_per_circle;
+	    VSET(a, ent->radius, 0.0, 0.0);
+	    VSET(b, 0.0, ent->radius, 0.0);
+	    curve_queue(ctx, CURVE_ARC, ent->center, a, b, ent->start_angle, delta, ent->end_angle, num_segs, 0);
+
+	    VSETALL(ent->center, 0.0);
+
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_spline_entities_code(struct dxf_import *ctx, int code)
+{
+    struct spline_entity *ent = &ctx->spline_ent;
+    struct bezier_set bs;
+    int i;
+    int coord;
+
+    switch (code) {
+	case 8:
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 210:
+	case 220:
+	case 230:
+	    coord = code / 10 - 21;
+	    break;
+	case 70:
+	    ent->flag = atoi(ctx->line);
+	    break;
+	case 71:
+	    ent->degree = atoi(ctx->line);
+	    break;
+	case 72:
+	    ent->numKnots = atoi(ctx->line);
+	    if (ent->numKnots > 0) {
+		ent->knots = (fastf_t *)bu_malloc(ent->numKnots*sizeof(fastf_t),
+					     "spline knots");
+	    }
+	    break;
+	case 73:
+	    ent->numCtlPts = atoi(ctx->line);
+	    if (ent->numCtlPts > 0) {
+		ent->ctlPts = (fastf_t *)bu_malloc(ent->numCtlPts*3*sizeof(fastf_t),
+					      "spline control points");
+		ent->weights = (fastf_t *)bu_malloc(ent->numCtlPts*sizeof(fastf_t),
+					       "spline weights");
+	    }
+	    for (i = 0; i < ent->numCtlPts; i++) {
+		ent->weights[i] = 1.0;
+	    }
+	    break;
+	case 74:
+	    ent->numFitPts = atoi(ctx->line);
+	    if (ent->numFitPts > 0) {
+		ent->fitPts = (fastf_t *)bu_malloc(ent->numFitPts*3*sizeof(fastf_t),
+					      "fit control points");
+	    }
+	    break;
+	case 42:
+	    break;
+	case 43:
+	    break;
+	case 44:
+	    break;
+	case 12:
+	case 22:
+	case 32:
+	    coord = code / 10 - 1;
+	    ent->startTan[coord] = atof(ctx->line);
+	    ent->tanFlags |= SPLINE_START_TANGENT;
+	    break;
+	case 13:
+	case 23:
+	case 33:
+	    coord = code / 10 - 1;
+	    ent->endTan[coord] = atof(ctx->line);
+	    ent->tanFlags |= SPLINE_END_TANGENT;
+	    break;
+	case 40:
+	    ent->knots[ent->knotCount++] = atof(ctx->line);
+	    break;
+	case 41:
+	    ent->weights[ent->weightCount++] = atof(ctx->line);
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	    coord = (code / 10) - 1 + ent->ctlPtCount*3;
+	    ent->ctlPts[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    ent->subCounter++;
+	    if (ent->subCounter > 2) {
+		ent->ctlPtCount++;
+		ent->subCounter = 0;
+	    }
+	    break;
+	case 11:
+	case 21:
+	case 31:
+	    coord = (code / 10) - 1 + ent->fitPtCount*3;
+	    ent->fitPts[coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    ent->subCounter2++;
+	    if (ent->subCounter2 > 2) {
+		ent->fitPtCount++;
+		ent->subCounter2 = 0;
+	    }
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* draw the spline */
+	    get_layer(ctx);
+	    ctx->layers[ctx->curr_layer]->spline_count++;
+
+	    if ((ent->tanFlags & SPLINE_START_TANGENT) && MAGNITUDE(ent->startTan) > SMALL_FASTF) {
+		VUNITIZE(ent->startTan);
+	    } else {
+		ent->tanFlags &= ~SPLINE_START_TANGENT;
+	    }
+	    if ((ent->tanFlags & SPLINE_END_TANGENT) && MAGNITUDE(ent->endTan) > SMALL_FASTF) {
+		VUNITIZE(ent->endTan);
+	    } else {
+		ent->tanFlags &= ~SPLINE_END_TANGENT;
+	    }
+
+	    if (ctx->native_curves && ent->degree > 0 && ent->ctlPts && ent->knots &&
+		ent->numCtlPts > ent->degree && ent->numKnots == ent->numCtlPts + ent->degree + 1 &&
+		ent->knotCount >= ent->numKnots && ent->ctlPtCount >= ent->numCtlPts &&
+		knots_clamped(ent->knots, ent->numKnots, ent->degree + 1)) {
+		int rational = (ent->flag & SPLINE_RATIONAL) && ent->weights && ent->weightCount >= ent->numCtlPts;
+
+		wire_nurb(ctx, ent->degree + 1, ent->numCtlPts, ent->ctlPts,
+			  rational ? ent->weights : NULL, ent->numKnots, ent->knots);
+	    } else if (ctx->native_curves && ent->numCtlPts > 0 && !spline_from_bspline(ent, &bs)) {
+		/* unclamped or periodic, the same curve over its domain as clamped pieces */
+		bezier_to_nurb(ctx, &bs);
+		bezier_set_free(&bs);
+	    } else if (ctx->native_curves && ent->numCtlPts == 0 && !spline_from_fit(ent, &bs)) {
+		bezier_to_nurb(ctx, &bs);
+		bezier_set_free(&bs);
+	    } else {
+		/* the pieces are built in output space */
+		if (ent->ctlPts) {
+		    xform_points(ctx->curr_state, ent->ctlPts, ent->ctlPtCount);
+		}
+		if (ent->fitPts) {
+		    xform_points(ctx->curr_state, ent->fitPts, ent->fitPtCount);
+		}
+		if (ent->tanFlags & SPLINE_START_TANGENT) {
+		    vect_t tmp_vec;
+
+		    MAT4X3VEC(tmp_vec, ctx->curr_state->xform, ent->startTan);
+		    VUNITIZE(tmp_vec);
+		    VMOVE(ent->startTan, tmp_vec);
+		}
+		if (ent->tanFlags & SPLINE_END_TANGENT) {
+		    vect_t tmp_vec;
+
+		    MAT4X3VEC(tmp_vec, ctx->curr_state->xform, ent->endTan);
+		    VUNITIZE(tmp_vec);
+		    VMOVE(ent->endTan, tmp_vec);
+		}
+
+		if (!spline_from_bspline(ent, &bs) || (ent->numCtlPts == 0 && !spline_from_fit(ent, &bs))) {
+		    fastf_t err = ctx->chord_error * units_conv[ctx->units] * ctx->scale_factor;
+
+		    ctx->layers[ctx->curr_layer]->curve_segs_fixed += ctx->splineSegs;
+		    ctx->layers[ctx->curr_layer]->curve_segs += spline_chords(ctx, &bs, err, ctx->splineSegs);
+		    bezier_set_free(&bs);
+		} else if (ctx->verbose) {
+		    bu_log("ignoring malformed SPLINE\n");
+		}
+	    }
+
+	    if (ent->knots != NULL) bu_free(ent->knots, "spline knots");
+	    if (ent->weights != NULL) bu_free(ent->weights, "spline weights");
+	    if (ent->ctlPts != NULL) bu_free(ent->ctlPts, "spline control points");
+	    if (ent->fitPts != NULL) bu_free(ent->fitPts, "spline fit points");
+	    ent->flag = 0;
+	    ent->degree = 0;
+	    ent->numKnots = 0;
+	    ent->numCtlPts = 0;
+	    ent->numFitPts = 0;
+	    VSETALL(ent->startTan, 0.0);
+	    VSETALL(ent->endTan, 0.0);
+	    ent->tanFlags = 0;
+	    ent->knotCount = 0;
+	    ent->weightCount = 0;
+	    ent->ctlPtCount = 0;
+	    ent->fitPtCount = 0;
+	    ent->subCounter = 0;
+	    ent->subCounter2 = 0;
+	    ent->knots = NULL;
+	    ent->weights = NULL;
+	    ent->ctlPts = NULL;
+	    ent->fitPts = NULL;
+
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+static int
+process_3dface_entities_code(struct dxf_import *ctx, int code)
+{
+    int vert_no;
+    int coord;
+    int face[5];
+
+    switch (code) {
+	case 8:
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = make_brlcad_name(ctx->line);
+	    break;
+	case 10:
+	case 20:
+	case 30:
+	case 11:
+	case 21:
+	case 31:
+	case 12:
+	case 22:
+	case 32:
+	case 13:
+	case 23:
+	case 33:
+	    vert_no = code % 10;
+	    coord = code / 10 - 1;
+	    ctx->pts[vert_no][coord] = atof(ctx->line) * units_conv[ctx->units] * ctx->scale_factor;
+	    if (ctx->verbose) {
+		bu_log("3dface vertex #%d coord #%d = %g\n", vert_no, coord, ctx->pts[vert_no][coord]);
+	    }
+	    if (vert_no == 2) {
+		ctx->pts[3][coord] = ctx->pts[2][coord];
+	    }
+	    break;
+	case 62:	/* color number */
+	    ctx->curr_color = atoi(ctx->line);
+	    break;
+	case 0:
+	    /* end of this 3dface */
+	    get_layer(ctx);
+	    if (ctx->verbose) {
+		bu_log("Found end of 3DFACE\n");
+	    }
+	    if (ctx->verbose) {
+		bu_log("\tmaking two triangles\n");
+	    }
+	    ctx->layers[ctx->curr_layer]->face3d_count++;
+	    xform_points(ctx->curr_state, ctx->pts[0], 4);
+	    for (vert_no = 0; vert_no < 4; vert_no++) {
+		face[vert_no] = bn_vert_tree_add(ctx->layers[ctx->curr_layer]->vert_tree,
+						 V3ARGS(ctx->pts[vert_no]),
+						 ctx->tol_sq);
+	    }
+	    add_triangle(ctx, face[0], face[1], face[2], ctx->curr_layer);
+	    add_triangle(ctx, face[2], face[3], face[0], ctx->curr_layer);
+	    if (ctx->verbose) {
+		bu_log("finished face\n");
+	    }
+
+	    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+	    process_entities_code[ctx->curr_state->sub_state](ctx, code);
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_entity_code(struct dxf_import *ctx, int code)
+{
+    return process_entities_code[ctx->curr_state->sub_state](ctx, code);
+}
+
+
+static int
+process_objects_code(struct dxf_import *ctx, int code)
+{
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 0:		/* text string */
+	    if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    }
+	    break;
+    }
+
+    return 0;
+}
+
+
+static int
+process_thumbnail_code(struct dxf_import *ctx, int code)
+{
+    switch (code) {
+	case 999:	/* comment */
+	    printf("%s\n", ctx->line);
+	    break;
+	case 0:		/* text string */
+	    if (!bu_strncmp(ctx->line, "SECTION", 7)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    } else if (!bu_strncmp(ctx->line, "ENDSEC", 6)) {
+		ctx->curr_state->state = UNKNOWN_SECTION;
+		break;
+	    }
+	    break;
+    }
+
+    return 0;
+}
+
+
+/* drop repeated line segments, either way round, keeping the first of each */
+static size_t
+dedup_lines(int *lines, size_t count)
+{
+    uint64_t *table;
+    size_t size = 16;
+    size_t i, n = 0;
+
+    while (size < count * 2) {
+	size *= 2;
+    }
+    table = (uint64_t *)bu_malloc(size * sizeof(uint64_t), "line hash");
+    memset(table, 0xff, size * sizeof(uint64_t));
+
+    for (i = 0; i < count; i++) {
+	int a = lines[i*2], b = lines[i*2 + 1];
+	uint64_t key = a < b ? ((uint64_t)a << 32) | (uint32_t)b : ((uint64_t)b << 32) | (uint32_t)a;
+	size_t slot = (size_t)((key * 0x9e3779b97f4a7c15ULL) >> 32) & (size - 1);
+
+	while (table[slot] != UINT64_MAX && table[slot] != key) {
+	    slot = (slot + 1) & (size - 1);
+	}
+	if (table[slot] == key) {
+	    continue;
+	}
+	table[slot] = key;
+	lines[n*2] = lines[i*2];
+	lines[n*2 + 1] = lines[i*2 + 1];
+	n++;
+    }
+
+    bu_free(table, "line hash");
+    return n;
+}
+
+
+/*
+ * Douglas-Peucker over the vertices run[0..n-1], marking those to keep.
+ * The ends are always kept.
+ */
+static void
+simplify_run(const fastf_t *verts, const int *run, size_t n, fastf_t tol_sq, char *keep, size_t *stack)
+{
+    size_t depth = 0;
+    size_t i;
+
+    memset(keep, 0, n);
+    keep[0] = keep[n - 1] = 1;
+    stack[depth++] = 0;
+    stack[depth++] = n - 1;
+    while (depth) {
+	size_t hi = stack[--depth];
+	size_t lo = stack[--depth];
+	size_t far = lo;
+	fastf_t far_sq = tol_sq;
+
+	for (i = lo + 1; i < hi; i++) {
+	    fastf_t d_sq = chord_dist_sq(&verts[run[lo]*3], &verts[run[hi]*3], &verts[run[i]*3]);
+
+	    if (d_sq > far_sq) {
+		far_sq = d_sq;
+		far = i;
+	    }
+	}
+	if (far != lo) {
+	    keep[far] = 1;
+	    stack[depth++] = lo;
+	    stack[depth++] = far;
+	    stack[depth++] = far;
+	    stack[depth++] = hi;
+	}
+    }
+}
+
+
+/*
+ * Clean up the welded line segments of a sketch.  Duplicates are
+ * dropped, then each run of lines through vertices that join exactly
+ * two lines (and nothing else) is simplified: vertices within tol of
+ * the run are removed, which merges collinear lines.  degree holds
+ * the number of curve ends at each vertex.  Returns the new count and
+ * adds the segments removed to dups and merged.
+ */
+static size_t
+clean_lines(const fastf_t *verts, size_t nverts, const int *degree, int *lines, size_t count, fastf_t tol,
+	    size_t *dups, size_t *merged)
+{
+    size_t *first, *adj, *fill, *stack;
+    int *run, *out;
+    char *used, *keep;
+    size_t n, nout = 0;
+    size_t e, k;
+    int pass, v;
+
+    n = dedup_lines(lines, count);
+    *dups += count - n;
+    count = n;
+    if (!count) {
+	return 0;
+    }
+
+    first = (size_t *)bu_calloc(nverts + 1, sizeof(size_t), "line vertex index");
+    adj = (size_t *)bu_malloc(2 * count * sizeof(size_t), "line adjacency");
+    fill = (size_t *)bu_malloc((nverts + 1) * sizeof(size_t), "line fill");
+    for (e = 0; e < count; e++) {
+	first[lines[e*2] + 1]++;
+	first[lines[e*2 + 1] + 1]++;
+    }
+    for (v = 0; (size_t)v < nverts; v++) {
+	first[v + 1] += first[v];
+    }
+    memcpy(fill, first, (nverts + 1) * sizeof(size_t));
+    for (e = 0; e < count; e++) {
+	adj[fill[lines[e*2]]++] = e;
+	adj[fill[lines[e*2 + 1]]++] = e;
+    }
+
+#define LINE_INTERIOR(_v) (first[(_v) + 1] - first[(_v)] == 2 && !degree[(_v)])
+
+    used = (char *)bu_calloc(count, 1, "line used");
+    run = (int *)bu_malloc((count + 1) * sizeof(int), "line run");
+    keep = (char *)bu_malloc(count + 1, "line keep");
+    stack = (size_t *)bu_malloc(4 * (count + 1) * sizeof(size_t), "line stack");
+    out = (int *)bu_malloc(count * 2 * sizeof(int), "cleaned lines");
+
+    /* runs between branch points first, then the closed runs left over */
+    for (pass = 0; pass < 2; pass++) {
+	for (e = 0; e < count; e++) {
+	    size_t seg = e;
+	    size_t len = 0;
+	    int start;
+
+	    if (used[e]) {
+		continue;
+	    }
+	    start = lines[e*2];
+	    if (pass == 0) {
+		if (!LINE_INTERIOR(lines[e*2])) {
+		    start = lines[e*2];
+		} else if (!LINE_INTERIOR(lines[e*2 + 1])) {
+		    start = lines[e*2 + 1];
+		} else {
+		    continue;
+		}
+	    }
+
+	    v = start;
+	    run[len++] = v;
+	    for (;;) {
+		used[seg] = 1;
+		v = (lines[seg*2] == v) ? lines[seg*2 + 1] : lines[seg*2];
+		run[len++] = v;
+		if (v == start || !LINE_INTERIOR(v)) {
+		    break;
+		}
+		for (k = first[v]; k < first[v + 1] && used[adj[k]]; k++)
+		    ;
+		if (k == first[v + 1]) {
+		    break;
+		}
+		seg = adj[k];
+	    }
+
+	    simplify_run(verts, run, len, tol * tol, keep, stack);
+	    for (k = 1, v = run[0]; k < len; k++) {
+		if (keep[k]) {
+		    out[nout*2] = v;
+		    out[nout*2 + 1] = run[k];
+		    nout++;
+		    v = run[k];
+		}
+	    }
+	}
+    }
+
+#undef LINE_INTERIOR
+
+    *merged += count - nout;
+    memcpy(lines, out, nout * 2 * sizeof(int));
+
+    bu_free(first, "line vertex index");
+    bu_free(adj, "line adjacency");
+    bu_free(fill, "line fill");
+    bu_free(used, "line used");
+    bu_free(run, "line run");
+    bu_free(keep, "line keep");
+    bu_free(stack, "line stack");
+    bu_free(out, "cleaned lines");
+
+    return nout;
+}
+
+
+/*
+ * Reorder count sketch segments into chains that run end to start,
+ * setting reverse where a segment is walked backwards.  ends holds
+ * the start and end vertex of each segment, -1 for one that cannot
+ * join another (a full circle).  Chains run between vertices that do
+ * not join exactly two segments; what is left over forms loops.
+ */
+static void
+chain_segments(void **segment, int *reverse, const int *ends, size_t count, size_t nverts,
+	       size_t *chains, size_t *loops)
+{
+    size_t *first = (size_t *)bu_calloc(nverts + 1, sizeof(size_t), "chain vertex index");
+    size_t *adj = (size_t *)bu_malloc((2 * count + 1) * sizeof(size_t), "chain adjacency");
+    size_t *fill = (size_t *)bu_malloc((nverts + 1) * sizeof(size_t), "chain fill");
+    char *used = (char *)bu_calloc(count + 1, 1, "chain used");
+    void **out = (void **)bu_malloc((count + 1) * sizeof(void *), "chain segments");
+    int *out_rev = (int *)bu_calloc(count + 1, sizeof(int), "chain reverse");
+    size_t n = 0;
+    size_t e, k;
+    int pass, v;
+
+    /* segments at each vertex, as offsets into adj */
+    for (e = 0; e < count; e++) {
+	if (ends[e*2] >= 0) {
+	    first[ends[e*2] + 1]++;
+	    first[ends[e*2 + 1] + 1]++;
+	}
+    }
+    for (v = 0; (size_t)v < nverts; v++) {
+	first[v + 1] += first[v];
+    }
+    memcpy(fill, first, (nverts + 1) * sizeof(size_t));
+    for (e = 0; e < count; e++) {
+	if (ends[e*2] >= 0) {
+	    adj[fill[ends[e*2]]++] = e;
+	    adj[fill[ends[e*2 + 1]]++] = e;
+	}
+    }
+
+#define CHAIN_DEGREE(_v) (first[(_v) + 1] - first[(_v)])
+
+    *chains = *loops = 0;
+    for (pass = 0; pass < 2; pass++) {
+	for (e = 0; e < count; e++) {
+	    size_t seg = e;
+	    int start;
+
+	    if (used[e] || ends[e*2] < 0) {
+		continue;
+	    }
+	    /* open chains first, starting where the mesh of segments branches or ends */
+	    start = ends[e*2];
+	    if (pass == 0) {
+		if (CHAIN_DEGREE(ends[e*2]) != 2) {
+		    start = ends[e*2];
+		} else if (CHAIN_DEGREE(ends[e*2 + 1]) != 2) {
+		    start = ends[e*2 + 1];
+		} else {
+		    continue;
+		}
+	    }
+
+	    v = start;
+	    for (;;) {
+		used[seg] = 1;
+		out_rev[n] = ends[seg*2] != v;
+		out[n++] = segment[seg];
+		v = out_rev[n - 1] ? ends[seg*2] : ends[seg*2 + 1];
+		if (v == start || CHAIN_DEGREE(v) != 2) {
+		    break;
+		}
+		for (k = first[v]; k < first[v + 1] && used[adj[k]]; k++)
+		    ;
+		if (k == first[v + 1]) {
+		    break;
+		}
+		seg = adj[k];
+	    }
+	    if (v == start) {
+		(*loops)++;
+	    } else {
+		(*chains)++;
+	    }
+	}
+    }
+
+#undef CHAIN_DEGREE
+
+    /* full circles close on themselves */
+    for (e = 0; e < count; e++) {
+	if (ends[e*2] < 0) {
+	    out_rev[n] = 0;
+	    out[n++] = segment[e];
+	    (*loops)++;
+	}
+    }
+
+    memcpy(segment, out, count * sizeof(void *));
+    memcpy(reverse, out_rev, count * sizeof(int));
+
+    bu_free(first, "chain vertex index");
+    bu_free(adj, "chain adjacency");
+    bu_free(fill, "chain fill");
+    bu_free(used, "chain used");
+    bu_free(out, "chain segments");
+    bu_free(out_rev, "chain reverse");
+}
+
+
+/*
+ * Create a sketch object from the wire segments of a layer.  Points
+ * closer than the tolerance are welded together first, then the
+ * segments are chained into contiguous runs.
+ */
+static struct rt_sketch_internal *
+wires_to_sketch(struct dxf_import *ctx, struct wire_store *w)
+{
+    struct rt_sketch_internal *skt;
+    struct bn_vert_tree *tree;
+    int *remap;
+    int *ends;
+    int *lines, *degree;
+    size_t idx, count, nlines;
+    fastf_t tol;
+
+    if (w->seg_count + w->curve_count < 1) {
+	return NULL;
+    }
+
+    tree = bn_vert_tree_create();
+    remap = (int *)bu_malloc(w->pt_count * sizeof(int), "wire point remap");
+    for (idx = 0; idx < w->pt_count; idx++) {
+	remap[idx] = bn_vert_tree_add(tree, V3ARGS(&w->pts[idx*3]), ctx->tol_sq);
+    }
+
+    /* welded lines, less duplicates and needless vertices */
+    lines = (int *)bu_malloc((w->seg_count + 1) * 2 * sizeof(int), "welded lines");
+    nlines = 0;
+    for (idx = 0; idx < w->seg_count; idx++) {
+	lines[nlines*2] = remap[w->segs[idx*2]];
+	lines[nlines*2 + 1] = remap[w->segs[idx*2 + 1]];
+	/* welded down to nothing */
+	if (lines[nlines*2] != lines[nlines*2 + 1]) {
+	    nlines++;
+	}
+    }
+    degree = (int *)bu_calloc(tree->curr_vert + 1, sizeof(int), "curve ends");
+    for (idx = 0; idx < w->curve_count; idx++) {
+	const struct wire_curve *crv = &w->curves[idx];
+
+	if (crv->type == CURVE_CARC_MAGIC) {
+	    degree[remap[crv->start]]++;
+	    degree[remap[crv->end]]++;
+	} else {
+	    degree[remap[crv->ctl]]++;
+	    degree[remap[crv->ctl + crv->c_size - 1]]++;
+	}
+    }
+    tol = FMAX(ctx->tol, ctx->simplify_tol * units_conv[ctx->units] * ctx->scale_factor);
+    w->dup_count = w->merged_count = 0;
+    nlines = clean_lines(tree->the_array, tree->curr_vert, degree, lines, nlines, tol,
+			 &w->dup_count, &w->merged_count);
+    bu_free(degree, "curve ends");
+
+    BU_ALLOC(skt, struct rt_sketch_internal);
+    skt->magic = RT_SKETCH_INTERNAL_MAGIC;
+    VSET(skt->V, 0.0, 0.0, 0.0);
+    VSET(skt->u_vec, 1.0, 0.0, 0.0);
+    VSET(skt->v_vec, 0.0, 1.0, 0.0);
+
+    skt->vert_count = tree->curr_vert;
+    skt->verts = (point2d_t *)bu_malloc(skt->vert_count * sizeof(point2d_t), "skt->verts");
+    for (idx = 0 ; idx < tree->curr_vert ; idx++) {
+	skt->verts[idx][0] = tree->the_array[idx*3];
+	skt->verts[idx][1] = tree->the_array[idx*3 + 1];
+    }
+
+    skt->curve.reverse = (int *)bu_calloc(w->seg_count + w->curve_count, sizeof(int), "curve segment reverse");
+    skt->curve.segment = (void **)bu_malloc((w->seg_count + w->curve_count) * sizeof(void *), "curve segments");
+    ends = (int *)bu_malloc((w->seg_count + w->curve_count) * 2 * sizeof(int), "curve segment ends");
+    count = 0;
+    for (idx = 0; idx < nlines; idx++) {
+	struct line_seg *lseg;
+	int start = lines[idx*2];
+	int end = lines[idx*2 + 1];
+
+	BU_ALLOC(lseg, struct line_seg);
+	lseg->magic = CURVE_LSEG_MAGIC;
+	lseg->start = start;
+	lseg->end = end;
+	if (ctx->verbose) {
+	    bu_log("making sketch line seg from #%d (%g %g %g) to #%d (%g %g %g)\n",
+		   lseg->start, V3ARGS(&tree->the_array[lseg->start*3]),
+		   lseg->end, V3ARGS(&tree->the_array[lseg->end*3]));
+	}
+	ends[count*2] = start;
+	ends[count*2 + 1] = end;
+	skt->curve.segment[count++] = (void *)lseg;
+    }
+
+    for (idx = 0; idx < w->curve_count; idx++) {
+	struct wire_curve *crv = &w->curves[idx];
+
+	if (crv->type == CURVE_CARC_MAGIC) {
+	    struct carc_seg *cseg;
+
+	    if (remap[crv->start] == remap[crv->end]) {
+		continue;
+	    }
+	    BU_ALLOC(cseg, struct carc_seg);
+	    cseg->magic = CURVE_CARC_MAGIC;
+	    cseg->start = remap[crv->start];
+	    cseg->end = remap[crv->end];
+	    cseg->radius = crv->radius;
+	    cseg->center_is_left = crv->center_is_left;
+	    cseg->orientation = crv->orientation;
+	    ends[count*2] = crv->radius < 0.0 ? -1 : cseg->start;
+	    ends[count*2 + 1] = crv->radius < 0.0 ? -1 : cseg->end;
+	    skt->curve.segment[count++] = (void *)cseg;
+	} else {
+	    struct nurb_seg *nseg;
+	    int ncoords = crv->weights ? 3 : 2;
+	    int rat = crv->weights ? RT_NURB_PT_RATIONAL : RT_NURB_PT_NONRAT;
+	    int i;
+
+	    BU_ALLOC(nseg, struct nurb_seg);
+	    nseg->magic = CURVE_NURB_MAGIC;
+	    nseg->order = crv->order;
+	    nseg->pt_type = RT_NURB_MAKE_PT_TYPE(ncoords, RT_NURB_PT_XY, rat);
+	    nseg->k.magic = NMG_KNOT_VECTOR_MAGIC;
+	    nseg->k.k_size = crv->k_size;
+	    nseg->c_size = crv->c_size;
+	    nseg->ctl_points = (int *)bu_malloc(crv->c_size * sizeof(int), "nurb_seg ctl_points");
+	    for (i = 0; i < crv->c_size; i++) {
+		nseg->ctl_points[i] = remap[crv->ctl + i];
+	    }
+
+	    /* the sketch takes over the knots and weights */
+	    nseg->k.knots = crv->knots;
+	    nseg->weights = crv->weights;
+	    crv->knots = NULL;
+	    crv->weights = NULL;
+	    ends[count*2] = nseg->ctl_points[0];
+	    ends[count*2 + 1] = nseg->ctl_points[crv->c_size - 1];
+	    skt->curve.segment[count++] = (void *)nseg;
+	}
+    }
+    skt->curve.count = count;
+
+    chain_segments(skt->curve.segment, skt->curve.reverse, ends, count, tree->curr_vert,
+		   &w->chain_count, &w->loop_count);
+    bu_free(ends, "curve segment ends");
+    bu_free(lines, "welded lines");
+
+    bn_vert_tree_destroy(tree);
+    bu_free(remap, "wire point remap");
+
+    if (count < 1) {
+	rt_curve_free(&skt->curve);
+	bu_free(skt->verts, "skt->verts");
+	bu_free(skt, "rt_sketch_internal");
+	return NULL;
+    }
+
+    return skt;
+}
+
+
+static int
+readcodes(struct dxf_import *ctx)
+{
+    int code;
+    size_t line_len;
+
+    ctx->curr_state->file_offset = bu_ftell(ctx->dxf);
+
+    if (bu_fgets(ctx->line, MAX_LINE_SIZE, ctx->dxf) == NULL) {
+	return ERROR_FLAG;
+    } else {
+	code = atoi(ctx->line);
+    }
+
+    if (bu_fgets(ctx->line, MAX_LINE_SIZE, ctx->dxf) == NULL) {
+	return ERROR_FLAG;
+    }
+
+    if (!bu_strncmp(ctx->line, "EOF", 3)) {
+	return EOF_FLAG;
+    }
+
+    line_len = strlen(ctx->line);
+    if (line_len) {
+	ctx->line[line_len-1] = '\0';
+	line_len--;
+    }
+
+    if (line_len && ctx->line[line_len-1] == '\r') {
+	ctx->line[line_len-1] = '\0';
+	line_len--;
+    }
+
+    if (ctx->verbose) {
+	ctx->line_num++;
+	bu_log("%d:\t%d\n", ctx->line_num, code);
+	ctx->line_num++;
+	bu_log("%d:\t%s\n", ctx->line_num, ctx->line);
+    }
+
+    return code;
+}
+
+void
+dxf_import_opts_init(struct dxf_import_opts *opts)
+{
+    opts->verbose = 0;
+    opts->ignore_colors = 0;
+    opts->native_curves = 0;
+    opts->dedup_reversed = 0;
+    opts->spatial_order = 0;
+    opts->chunk_tris = 0;
+    opts->split_components = 0;
+    opts->tile_size = 0.0;
+    opts->ncpu = 1;
+    opts->annotations = 0;
+    opts->chord_error = 0.0;
+    opts->simplify_tol = 0.0;
+    opts->tol = 0.01;
+    opts->scale_factor = 1.0;
+    opts->cache = NULL;
+    opts->prefix = NULL;
+    opts->top_name = NULL;
+    opts->blocks = NULL;
+    opts->instance_blocks = 0;
+}
+
+
+struct dxf_import_cache *
+dxf_import_cache_create(void)
+{
+    struct dxf_import_cache *cache;
+
+    size_t i;
+
+    BU_ALLOC(cache, struct dxf_import_cache);
+    BU_LIST_INIT(&cache->free_hd);
+    for (i = 0; i < RECORDED_FILES; i++) {
+	bu_vls_init(&cache->recorded[i].key);
+	bu_ptbl_init(&cache->recorded[i].blocks, 8, "recorded blocks");
+    }
+
+    return cache;
+}
+
+
+static void free_parsed_block(struct parsed_block *pb);
+
+
+static void
+recorded_file_clear(struct recorded_file *rf)
+{
+    size_t i;
+
+    for (i = 0; i < BU_PTBL_LEN(&rf->blocks); i++) {
+	free_parsed_block((struct parsed_block *)BU_PTBL_GET(&rf->blocks, i));
+    }
+    bu_ptbl_reset(&rf->blocks);
+    bu_vls_trunc(&rf->key, 0);
+}
+
+
+/* the recordings kept for key, taking the oldest slot for a new key if create is set */
+static struct recorded_file *
+recorded_file_find(struct dxf_import_cache *cache, const struct bu_vls *key, int create)
+{
+    struct recorded_file *rf;
+    size_t i;
+
+    if (!bu_vls_strlen(key)) {
+	return NULL;
+    }
+    for (i = 0; i < RECORDED_FILES; i++) {
+	if (BU_STR_EQUAL(bu_vls_cstr(&cache->recorded[i].key), bu_vls_cstr(key))) {
+	    return &cache->recorded[i];
+	}
+    }
+    if (!create) {
+	return NULL;
+    }
+
+    rf = &cache->recorded[cache->recorded_next];
+    cache->recorded_next = (cache->recorded_next + 1) % RECORDED_FILES;
+    recorded_file_clear(rf);
+    bu_vls_strcpy(&rf->key, bu_vls_cstr(key));
+
+    return rf;
+}
+
+
+/* nanoseconds of the modification time, where the system keeps them */
+static long
+mtime_nsec(const struct stat *sb)
+{
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+    return (long)sb->st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return (long)sb->st_mtimespec.tv_nsec;
+#else
+    (void)sb;
+    return 0;
+#endif
+}
+
+
+/*
+ * The file, as of its size and modification time, and the options
+ * that shape a block recording.  Left empty if the file cannot be
+ * looked at, so nothing is kept.
+ */
+static void
+record_key(struct dxf_import *ctx)
+{
+    struct stat sb;
+
+    bu_vls_trunc(&ctx->record_key, 0);
+    if (stat(ctx->dxf_file, &sb)) {
+	return;
+    }
+    bu_vls_printf(&ctx->record_key, "%s|%ld.%09ld|%lld|%d|%d|%d|%d|%g|%g|%g|%g",
+		  ctx->dxf_file, (long)sb.st_mtime, mtime_nsec(&sb), (long long)sb.st_size,
+		  ctx->ignore_colors, ctx->native_curves, ctx->dedup_reversed, ctx->annotations,
+		  ctx->chord_error, ctx->simplify_tol, ctx->tol, ctx->scale_factor);
+}
+
+
+void
+dxf_import_cache_destroy(struct dxf_import_cache *cache)
+{
+    size_t i;
+
+    for (i = 0; i < RECORDED_FILES; i++) {
+	recorded_file_clear(&cache->recorded[i]);
+	bu_ptbl_free(&cache->recorded[i].blocks);
+	bu_vls_free(&cache->recorded[i].key);
+    }
+    if (cache->polyline_verts) {
+	bu_free(cache->polyline_verts, "polyline_verts");
+    }
+    if (cache->polyline_vert_indices) {
+	bu_free(cache->polyline_vert_indices, "polyline_vert_indices");
+    }
+    bn_vlist_cleanup(&cache->free_hd);
+    if (cache->glyphs) {
+	glyphs_free(cache->glyphs);
+    }
+    if (cache->curve_tmpl) {
+	curve_templates_free(cache->curve_tmpl);
+    }
+    bu_free(cache, "dxf_import_cache");
+}
+
+
+/* starting values for the per-entity data */
+static void
+entity_init(struct dxf_import *ctx)
+{
+    ctx->solid_ent.last_vert_no = -1;
+    VSET(ctx->ellipse_ent.majorAxis, 1.0, 0.0, 0.0);
+    ctx->ellipse_ent.ratio = 1.0;
+    ctx->ellipse_ent.startAngle = 0.0;
+    ctx->ellipse_ent.endAngle = M_2PI;
+    ctx->text_ent.textScale = 1.0;
+}
+
+
+struct dxf_import *
+dxf_import_open(const char *dxf_file, struct rt_wdb *wdbp, const struct dxf_import_opts *opts)
+{
+    struct dxf_import *ctx;
+    struct dxf_import_opts default_opts;
+    int i;
+
+    if (!opts) {
+	dxf_import_opts_init(&default_opts);
+	opts = &default_opts;
+    }
+
+    BU_ALLOC(ctx, struct dxf_import);
+
+    if ((ctx->dxf=fopen(dxf_file, "rb")) == NULL) {
+	perror(dxf_file);
+	bu_log("Cannot open DXF file (%s)\n", dxf_file);
+	bu_free(ctx, "dxf_import");
+	return NULL;
+    }
+
+    ctx->dxf_file = bu_strdup(dxf_file);
+    ctx->out_fp = wdbp;
+    ctx->prefix = bu_strdup(opts->prefix ? opts->prefix : "");
+    ctx->top_name = opts->top_name ? bu_strdup(opts->top_name) : NULL;
+    ctx->blocks = opts->blocks;
+    if (!ctx->blocks && opts->instance_blocks) {
+	ctx->blocks = dxf_block_library_create();
+	ctx->own_blocks = 1;
+    }
+
+    ctx->verbose = opts->verbose;
+    ctx->ignore_colors = opts->ignore_colors;
+    ctx->native_curves = opts->native_curves;
+    ctx->dedup_reversed = opts->dedup_reversed;
+    ctx->spatial_order = opts->spatial_order;
+    ctx->chunk_tris = opts->chunk_tris;
+    ctx->split_components = opts->split_components;
+    ctx->tile_size = opts->tile_size;
+    ctx->ncpu = opts->ncpu;
+    ctx->annotations = opts->annotations;
+    ctx->chord_error = opts->chord_error;
+    ctx->simplify_tol = opts->simplify_tol;
+    ctx->tol = opts->tol;
+    ctx->tol_sq = ctx->tol * ctx->tol;
+    ctx->scale_factor = opts->scale_factor;
+
+    ctx->segs_per_circle = 32;
+    ctx->splineSegs = 16;
+    BU_ALLOC(ctx->curves, struct curve_batch);
+
+    BU_LIST_INIT(&ctx->block_head);
+    BU_LIST_INIT(&ctx->free_hd);
+
+    /* borrow any warm buffers from the cache */
+    ctx->cache = opts->cache;
+    bu_vls_init(&ctx->record_key);
+    if (ctx->cache) {
+	record_key(ctx);
+	ctx->polyline_verts = ctx->cache->polyline_verts;
+	ctx->polyline_vertex_max = ctx->cache->polyline_vertex_max;
+	ctx->cache->polyline_verts = NULL;
+	ctx->polyline_vert_indices = ctx->cache->polyline_vert_indices;
+	ctx->polyline_vert_indices_max = ctx->cache->polyline_vert_indices_max;
+	ctx->cache->polyline_vert_indices = NULL;
+	BU_LIST_APPEND_LIST(&ctx->free_hd, &ctx->cache->free_hd);
+	ctx->glyphs = ctx->cache->glyphs;
+	ctx->cache->glyphs = NULL;
+	ctx->curves->tmpl = ctx->cache->curve_tmpl;
+	ctx->cache->curve_tmpl = NULL;
+    }
+    if (!ctx->curves->tmpl) {
+	ctx->curves->tmpl = (fastf_t **)bu_calloc(CURVE_MAX_SEGS + 1, sizeof(fastf_t *), "curve templates");
+    }
+
+    /* initialize state stack */
+    BU_LIST_INIT(&ctx->state_stack);
+
+    /* create initial state */
+    BU_ALLOC(ctx->curr_state, struct state_data);
+    ctx->curr_state->file_offset = 0;
+    ctx->curr_state->state = UNKNOWN_SECTION;
+    ctx->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+    MAT_IDN(ctx->curr_state->xform);
+    ctx->curr_state->xform_type = XFORM_IDENTITY;
+
+    /* make space for 5 layers to start */
+    ctx->max_layers = 5;
+    ctx->next_layer = 1;
+    ctx->curr_layer = 0;
+    ctx->layers = (struct layer **)bu_calloc(5, sizeof(struct layer *), "layers");
+    for (i = 0; i < ctx->max_layers; i++) {
+	BU_ALLOC(ctx->layers[i], struct layer);
+    }
+    ctx->layers[0]->name = bu_strdup("noname");
+    ctx->layers[0]->color_number = 7;	/* default white */
+    ctx->layers[0]->vert_tree = bn_vert_tree_create();
+    bu_ptbl_init(&ctx->layers[0]->instances, 8, "layers[curr_layer]->instances");
+    bu_ptbl_init(&ctx->layers[0]->refs, 8, "layers[curr_layer]->refs");
+
+    ctx->curr_color = ctx->layers[0]->color_number;
+    ctx->curr_layer_name = bu_strdup(ctx->layers[0]->name);
+
+    entity_init(ctx);
+
+    return ctx;
+}
+
+
+int
+dxf_import_feed(struct dxf_import *ctx, size_t max_codes)
+{
+    size_t count = 0;
+    int code;
+
+    if (!ctx->dxf) {
+	return 0;
+    }
+
+    while (max_codes == 0 || count < max_codes) {
+	if ((code=readcodes(ctx)) <= -900) {
+	    fclose(ctx->dxf);
+	    ctx->dxf = NULL;
+	    return 0;
+	}
+	process_code[ctx->curr_state->state](ctx, code);
+	count++;
+	if (!ctx->dxf) {
+	    return 0;
+	}
+    }
+
+    return 1;
+}
+
+
+/* non-zero if triangle u runs from a to b, as does the triangle sharing that edge with it */
+static int
+tri_same_direction(const int *tris, size_t u, int a, int b)
+{
+    int i;
+
+    for (i = 0; i < 3; i++) {
+	if (tris[u*3 + i] == a) {
+	    return tris[u*3 + (i + 1) % 3] == b;
+	}
+    }
+    return 0;
+}
+
+
+/*
+ * Split ntri triangles of a layer mesh into edge connected pieces and
+ * make the winding of each orientable piece consistent.  Pieces that
+ * are closed manifolds are turned to face outward.  tris is rewritten
+ * one piece after another, closed pieces first, and *pieces is set to the
+ * npieces + 1 offsets (in triangles) where the pieces start.  Returns
+ * the number of triangles in closed pieces.
+ */
+static size_t
+orient_mesh(struct layer *lp, int *tris, size_t ntri, size_t *shells, size_t **pieces, size_t *npieces)
+{
+    size_t nverts = lp->vert_tree->curr_vert;
+    const fastf_t *pts = lp->vert_tree->the_array;
+    size_t *first = (size_t *)bu_calloc(nverts + 1, sizeof(size_t), "mesh vertex index");
+    size_t *adj = (size_t *)bu_malloc(3 * ntri * sizeof(size_t), "mesh adjacency");
+    size_t *fill = (size_t *)bu_malloc((nverts + 1) * sizeof(size_t), "mesh fill");
+    long *nbr = (long *)bu_malloc(3 * ntri * sizeof(long), "mesh neighbors");
+    char *seen = (char *)bu_calloc(ntri, 1, "mesh seen");
+    char *flip = (char *)bu_calloc(ntri, 1, "mesh flip");
+    size_t *queue = (size_t *)bu_malloc(ntri * sizeof(size_t), "mesh queue");
+    size_t *start = (size_t *)bu_malloc((ntri + 1) * sizeof(size_t), "mesh piece start");
+    char *shell = (char *)bu_calloc(ntri, 1, "mesh piece closed");
+    size_t ncomp = 0;
+    int *out;
+    size_t nclosed = 0;
+    size_t t, k, c, n = 0;
+    int e;
+
+    *shells = 0;
+
+    /* triangles at each vertex, as offsets into adj */
+    for (k = 0; k < 3 * ntri; k++) {
+	first[tris[k] + 1]++;
+    }
+    for (k = 0; k < nverts; k++) {
+	first[k + 1] += first[k];
+    }
+    memcpy(fill, first, (nverts + 1) * sizeof(size_t));
+    for (k = 0; k < 3 * ntri; k++) {
+	adj[fill[tris[k]]++] = k / 3;
+    }
+
+    /* the face across each edge, -1 on a boundary and -2 where more than two faces meet */
+    for (t = 0; t < ntri; t++) {
+	for (e = 0; e < 3; e++) {
+	    int a = tris[t*3 + e];
+	    int b = tris[t*3 + (e + 1) % 3];
+	    long other = -1;
+
+	    for (k = first[a]; k < first[a + 1]; k++) {
+		size_t u = adj[k];
+
+		if (u == t || (tris[u*3] != b && tris[u*3 + 1] != b && tris[u*3 + 2] != b)) {
+		    continue;
+		}
+		other = (other == -1) ? (long)u : -2;
+	    }
+	    nbr[t*3 + e] = other;
+	}
+    }
+
+    for (t = 0; t < ntri; t++) {
+	int open = 0;
+	int orientable = 1;
+	size_t head;
+	fastf_t volume = 0.0;
+
+	if (seen[t]) {
+	    continue;
+	}
+
+	/* walk the piece, deciding which faces to turn over to agree with this one */
+	start[ncomp++] = head = n;
+	queue[n++] = t;
+	seen[t] = 1;
+	while (head < n) {
+	    size_t f = queue[head++];
+
+	    for (e = 0; e < 3; e++) {
+		long u = nbr[f*3 + e];
+		char want;
+
+		if (u < 0) {
+		    open = 1;
+		    continue;
+		}
+		want = flip[f] ^ tri_same_direction(tris, (size_t)u, tris[f*3 + e], tris[f*3 + (e + 1) % 3]);
+		if (!seen[u]) {
+		    seen[u] = 1;
+		    flip[u] = want;
+		    queue[n++] = (size_t)u;
+		} else if (flip[u] != want) {
+		    orientable = 0;
+		}
+	    }
+	}
+
+	if (!orientable) {
+	    continue;
+	}
+	for (k = start[ncomp - 1]; k < n; k++) {
+	    int *v = &tris[queue[k]*3];
+
+	    if (flip[queue[k]]) {
+		int tmp = v[1];
+		v[1] = v[2];
+		v[2] = tmp;
+	    }
+	}
+	if (open) {
+	    continue;
+	}
+
+	/* six times the enclosed volume, negative if the faces point in */
+	for (k = start[ncomp - 1]; k < n; k++) {
+	    const int *v = &tris[queue[k]*3];
+	    vect_t cross;
+
+	    VCROSS(cross, &pts[v[1]*3], &pts[v[2]*3]);
+	    volume += VDOT(&pts[v[0]*3], cross);
+	}
+	if (NEAR_ZERO(volume, SMALL_FASTF)) {
+	    continue;
+	}
+	if (volume < 0.0) {
+	    for (k = start[ncomp - 1]; k < n; k++) {
+		int *v = &tris[queue[k]*3];
+		int tmp = v[1];
+
+		v[1] = v[2];
+		v[2] = tmp;
+	    }
+	}
+	shell[ncomp - 1] = 1;
+	nclosed += n - start[ncomp - 1];
+	(*shells)++;
+    }
+    start[ncomp] = n;
+
+    /* closed pieces first, each in the order it was walked */
+    out = (int *)bu_malloc(3 * ntri * sizeof(int) + sizeof(int), "oriented triangles");
+    *pieces = (size_t *)bu_malloc((ncomp + 1) * sizeof(size_t), "mesh pieces");
+    *npieces = 0;
+    n = 0;
+    for (k = 0; k < 2; k++) {
+	for (c = 0; c < ncomp; c++) {
+	    size_t j;
+
+	    if (shell[c] != (k == 0)) {
+		continue;
+	    }
+	    (*pieces)[(*npieces)++] = n;
+	    for (j = start[c]; j < start[c + 1]; j++) {
+		memcpy(&out[n*3], &tris[queue[j]*3], 3 * sizeof(int));
+		n++;
+	    }
+	}
+    }
+    (*pieces)[*npieces] = n;
+    memcpy(tris, out, 3 * ntri * sizeof(int));
+
+    /* the duplicate hash refers to the old order */
+    if (lp->tri_hash) {
+	bu_free(lp->tri_hash, "triangle hash");
+	lp->tri_hash = NULL;
+	lp->tri_hash_size = 0;
+    }
+
+    bu_free(first, "mesh vertex index");
+    bu_free(adj, "mesh adjacency");
+    bu_free(fill, "mesh fill");
+    bu_free(nbr, "mesh neighbors");
+    bu_free(seen, "mesh seen");
+    bu_free(flip, "mesh flip");
+    bu_free(queue, "mesh queue");
+    bu_free(start, "mesh piece start");
+    bu_free(shell, "mesh piece closed");
+    bu_free(out, "oriented triangles");
+
+    return nclosed;
+}
+
+
+struct morton_item {
+    uint64_t code;
+    size_t idx;
+};
+
+
+static int
+morton_cmp(const void *a, const void *b, void *UNUSED(data))
+{
+    const struct morton_item *ma = (const struct morton_item *)a;
+    const struct morton_item *mb = (const struct morton_item *)b;
+
+    if (ma->code != mb->code) {
+	return (ma->code < mb->code) ? -1 : 1;
+    }
+    return (ma->idx < mb->idx) ? -1 : (ma->idx > mb->idx);
+}
+
+
+/* position of pt along a Morton curve through the box at min, 21 bits per axis */
+static uint64_t
+morton_code(const fastf_t *pt, const point_t min, fastf_t scale)
+{
+    uint64_t c[3];
+    uint64_t code = 0;
+    int i, b;
+
+    for (i = 0; i < 3; i++) {
+	fastf_t f = (pt[i] - min[i]) * scale;
+
+	c[i] = (f <= 0.0) ? 0 : (f >= 2097151.0) ? 2097151 : (uint64_t)f;
+    }
+    for (b = 20; b >= 0; b--) {
+	code = (code << 3) | (((c[0] >> b) & 1) << 2) | (((c[1] >> b) & 1) << 1) | ((c[2] >> b) & 1);
+    }
+
+    return code;
+}
+
+
+/* box around the vertices used by ntri triangles, and the scale that fills the Morton grid with it */
+static fastf_t
+morton_bounds(const fastf_t *pts, const int *tris, size_t ntri, point_t min)
+{
+    point_t max;
+    fastf_t extent;
+    size_t k;
+
+    VSETALL(min, INFINITY);
+    VSETALL(max, -INFINITY);
+    for (k = 0; k < 3 * ntri; k++) {
+	VMINMAX(min, max, &pts[tris[k]*3]);
+    }
+    extent = FMAX(FMAX(max[X] - min[X], max[Y] - min[Y]), max[Z] - min[Z]);
+
+    return (extent > SMALL_FASTF) ? 2097151.0 / extent : 0.0;
+}
+
+
+/* sort triangles along a Morton curve through their centroids */
+static void
+morton_sort_tris(const fastf_t *pts, int *tris, size_t ntri)
+{
+    struct morton_item *items;
+    int *sorted;
+    point_t min;
+    fastf_t scale;
+    size_t k;
+
+    if (ntri < 2) {
+	return;
+    }
+
+    scale = morton_bounds(pts, tris, ntri, min);
+    items = (struct morton_item *)bu_malloc(ntri * sizeof(struct morton_item), "morton triangles");
+    for (k = 0; k < ntri; k++) {
+	point_t c;
+
+	VADD3(c, &pts[tris[k*3]*3], &pts[tris[k*3 + 1]*3], &pts[tris[k*3 + 2]*3]);
+	VSCALE(c, c, 1.0/3.0);
+	items[k].code = morton_code(c, min, scale);
+	items[k].idx = k;
+    }
+    bu_sort(items, ntri, sizeof(struct morton_item), morton_cmp, NULL);
+
+    sorted = (int *)bu_malloc(3 * ntri * sizeof(int), "morton sorted triangles");
+    for (k = 0; k < ntri; k++) {
+	memcpy(&sorted[k*3], &tris[items[k].idx*3], 3 * sizeof(int));
+    }
+    memcpy(tris, sorted, 3 * ntri * sizeof(int));
+
+    bu_free(items, "morton triangles");
+    bu_free(sorted, "morton sorted triangles");
+}
+
+
+/*
+ * Record the extents of an object as its bbox.min and bbox.max
+ * attributes, and add them to the extents of layer lp unless it is
+ * NULL.
+ */
+static void
+write_bbox(struct dxf_import *ctx, const char *name, const point_t min, const point_t max, struct layer *lp)
+{
+    struct bu_attribute_value_set avs;
+    struct bu_vls value = BU_VLS_INIT_ZERO;
+    struct directory *dp;
+
+    if (min[X] > max[X]) {
+	return;
+    }
+    if (lp) {
+	VMINMAX(lp->bb_min, lp->bb_max, min);
+	VMINMAX(lp->bb_min, lp->bb_max, max);
+    }
+    if ((dp = db_lookup(ctx->out_fp->dbip, name, LOOKUP_QUIET)) == RT_DIR_NULL) {
+	return;
+    }
+
+    bu_avs_init_empty(&avs);
+    bu_vls_sprintf(&value, "%.12g %.12g %.12g", V3ARGS(min));
+    (void)bu_avs_add(&avs, "bbox.min", bu_vls_cstr(&value));
+    bu_vls_sprintf(&value, "%.12g %.12g %.12g", V3ARGS(max));
+    (void)bu_avs_add(&avs, "bbox.max", bu_vls_cstr(&value));
+    if (db5_update_attributes(dp, &avs, ctx->out_fp->dbip)) {
+	bu_log("Failed to write the extents of %s\n", name);
+    }
+    bu_avs_free(&avs);
+    bu_vls_free(&value);
+}
+
+
+/*
+ * Write ntri triangles of a layer as a BOT holding only the vertices
+ * they use, numbered in the order the triangles first use them or, if
+ * the layer is written in spatial order, along a Morton curve.  map
+ * has an entry for each vertex of the layer, all -1, and is left that
+ * way.
+ */
+static int
+write_bot(struct dxf_import *ctx, const char *name, struct layer *lp, const int *tris, size_t ntri,
+	  unsigned char mode, unsigned char orientation, int *map)
+{
+    const fastf_t *pts = lp->vert_tree->the_array;
+    struct morton_item *items;
+    fastf_t *verts;
+    int *faces;
+    point_t min;
+    fastf_t scale = 0.0;
+    size_t nverts = 0;
+    size_t k;
+    int ret;
+
+    items = (struct morton_item *)bu_malloc((3 * ntri + 1) * sizeof(struct morton_item), "bot vertices");
+    if (ctx->spatial_order || ctx->chunk_tris) {
+	scale = morton_bounds(pts, tris, ntri, min);
+    }
+    for (k = 0; k < 3 * ntri; k++) {
+	if (map[tris[k]] < 0) {
+	    map[tris[k]] = (int)nverts;
+	    items[nverts].code = (scale > 0.0) ? morton_code(&pts[tris[k]*3], min, scale) : 0;
+	    items[nverts].idx = (size_t)tris[k];
+	    nverts++;
+	}
+    }
+    if (scale > 0.0) {
+	bu_sort(items, nverts, sizeof(struct morton_item), morton_cmp, NULL);
+    }
+
+    verts = (fastf_t *)bu_malloc((3 * nverts + 1) * sizeof(fastf_t), "bot vertex array");
+    for (k = 0; k < nverts; k++) {
+	VMOVE(&verts[k*3], &pts[items[k].idx*3]);
+	map[items[k].idx] = (int)k;
+    }
+    faces = (int *)bu_malloc((3 * ntri + 1) * sizeof(int), "bot faces");
+    for (k = 0; k < 3 * ntri; k++) {
+	faces[k] = map[tris[k]];
+    }
+
+    ret = mk_bot(ctx->out_fp, name, mode, orientation, 0, nverts, ntri, verts, faces,
+		 (fastf_t *)NULL, (struct bu_bitv *)NULL);
+    if (!ret) {
+	point_t max;
+
+	VSETALL(min, INFINITY);
+	VSETALL(max, -INFINITY);
+	for (k = 0; k < nverts; k++) {
+	    VMINMAX(min, max, &verts[k*3]);
+	}
+	write_bbox(ctx, name, min, max, lp);
+    }
+
+    for (k = 0; k < nverts; k++) {
+	map[items[k].idx] = -1;
+    }
+    bu_free(items, "bot vertices");
+    bu_free(verts, "bot vertex array");
+    bu_free(faces, "bot faces");
+
+    return ret;
+}
+
+
+/* all the POINTs of a layer as one point cloud, 0.1 mm across as the spheres they replace */
+static int
+write_points(struct dxf_import *ctx, const char *name, struct layer *lp)
+{
+    struct rt_pnts_internal *pnts;
+    struct pnt *head, *p;
+    point_t min, max;
+    size_t k;
+
+    BU_ALLOC(pnts, struct rt_pnts_internal);
+    pnts->magic = RT_PNTS_INTERNAL_MAGIC;
+    pnts->scale = 0.1;
+    pnts->type = RT_PNT_TYPE_PNT;
+    pnts->count = lp->point_count;
+
+    BU_ALLOC(head, struct pnt);
+    BU_LIST_INIT(&head->l);
+    pnts->point = head;
+    for (k = 0; k < lp->point_count; k++) {
+	BU_ALLOC(p, struct pnt);
+	VMOVE(p->v, &lp->point_pts[k*3]);
+	BU_LIST_INSERT(&head->l, &p->l);
+    }
+
+    /* the internal form is released by the export */
+    if (wdb_export(ctx->out_fp, name, (void *)pnts, ID_PNTS, 1.0)) {
+	return 1;
+    }
+
+    VSETALL(min, INFINITY);
+    VSETALL(max, -INFINITY);
+    for (k = 0; k < lp->point_count; k++) {
+	VMINMAX(min, max, &lp->point_pts[k*3]);
+    }
+    write_bbox(ctx, name, min, max, lp);
+
+    return 0;
+}
+
+
+/*
+ * Write the annotations of a layer as attributes of an empty
+ * combination, annotation.N holding the text and annotation.N.type,
+ * .point, .height and .rotation the rest.
+ */
+static void
+write_annotations(struct dxf_import *ctx, int layer, struct bu_list *head)
+{
+    struct layer *lp = ctx->layers[layer];
+    struct bu_attribute_value_set avs;
+    struct bu_list empty;
+    struct bu_vls name = BU_VLS_INIT_ZERO;
+    struct bu_vls value = BU_VLS_INIT_ZERO;
+    struct directory *dp;
+    size_t k;
+
+    snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%s%s.annotations.%d", ctx->prefix, lp->name, layer);
+    BU_LIST_INIT(&empty);
+    if (mk_comb(ctx->out_fp, ctx->tmp_name, &empty, 0, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0) ||
+	(dp = db_lookup(ctx->out_fp->dbip, ctx->tmp_name, LOOKUP_QUIET)) == RT_DIR_NULL) {
+	bu_log("Failed to make annotations for layer %s\n", lp->name);
+	return;
+    }
+
+    bu_avs_init_empty(&avs);
+    for (k = 0; k < lp->note_count; k++) {
+	const struct annotation *note = &lp->notes[k];
+
+	bu_vls_sprintf(&name, "annotation.%zu", k);
+	(void)bu_avs_add(&avs, bu_vls_cstr(&name), note->text);
+	bu_vls_sprintf(&name, "annotation.%zu.type", k);
+	(void)bu_avs_add(&avs, bu_vls_cstr(&name), note->kind);
+	bu_vls_sprintf(&name, "annotation.%zu.point", k);
+	bu_vls_sprintf(&value, "%.12g %.12g %.12g", V3ARGS(note->pt));
+	(void)bu_avs_add(&avs, bu_vls_cstr(&name), bu_vls_cstr(&value));
+	bu_vls_sprintf(&name, "annotation.%zu.height", k);
+	bu_vls_sprintf(&value, "%.12g", note->height);
+	(void)bu_avs_add(&avs, bu_vls_cstr(&name), bu_vls_cstr(&value));
+	bu_vls_sprintf(&name, "annotation.%zu.rotation", k);
+	bu_vls_sprintf(&value, "%.12g", note->rotation);
+	(void)bu_avs_add(&avs, bu_vls_cstr(&name), bu_vls_cstr(&value));
+    }
+    if (db5_update_attributes(dp, &avs, ctx->out_fp->dbip)) {
+	bu_log("Failed to write annotations for layer %s\n", lp->name);
+    }
+    bu_avs_free(&avs);
+    bu_vls_free(&name);
+    bu_vls_free(&value);
+
+    (void)mk_addmember(ctx->tmp_name, head, NULL, WMOP_UNION);
+}
+
+
+/*
+ * Orient the triangles of a mesh cell and decide which go in each BOT:
+ * closed shells in one and the rest in another or, with -p, one for
+ * each connected piece.
+ */
+static void
+prepare_mesh(struct dxf_import *ctx, struct layer *lp, struct mesh_cell *cell)
+{
+    int *tris = &lp->part_tris[cell->start*3];
+    size_t *pieces, npieces, shells;
+
+    cell->nclosed = orient_mesh(lp, tris, cell->count, &shells, &pieces, &npieces);
+    lp->shell_count += shells;
+
+    if (ctx->split_components) {
+	cell->parts = pieces;
+	cell->nparts = npieces;
+    } else {
+	bu_free(pieces, "mesh pieces");
+	cell->parts = (size_t *)bu_malloc(3 * sizeof(size_t), "mesh parts");
+	cell->nparts = 0;
+	cell->parts[0] = 0;
+	if (cell->nclosed) {
+	    cell->parts[++cell->nparts] = cell->nclosed;
+	}
+	if (cell->nclosed < cell->count) {
+	    cell->parts[++cell->nparts] = cell->count;
+	}
+    }
+}
+
+
+/* with -o or -k, sort each part of a mesh cell in Morton order */
+static void
+sort_mesh(struct dxf_import *ctx, struct layer *lp, struct mesh_cell *cell)
+{
+    size_t p;
+
+    if (!ctx->spatial_order && !ctx->chunk_tris) {
+	return;
+    }
+    for (p = 0; p < cell->nparts; p++) {
+	morton_sort_tris(lp->vert_tree->the_array, &lp->part_tris[(cell->start + cell->parts[p])*3],
+			 cell->parts[p + 1] - cell->parts[p]);
+    }
+}
+
+
+/*
+ * Write a mesh cell of layer i as BOTs: closed shells as solids and
+ * the rest as surfaces, in chunks of at most chunk_tris triangles.
+ * tag follows the prefix in the names.
+ */
+static void
+write_mesh(struct dxf_import *ctx, int i, const char *tag, const struct mesh_cell *cell, struct bu_list *head)
+{
+    struct layer *lp = ctx->layers[i];
+    size_t solid_no = 0, surf_no = 0;
+    int *map;
+    size_t p;
+
+    map = (int *)bu_malloc(lp->vert_tree->curr_vert * sizeof(int), "bot vertex map");
+    memset(map, 0xff, lp->vert_tree->curr_vert * sizeof(int));
+    for (p = 0; p < cell->nparts; p++) {
+	int *tris = &lp->part_tris[(cell->start + cell->parts[p])*3];
+	size_t n = cell->parts[p + 1] - cell->parts[p];
+	size_t start;
+
+	/* a closed shell is kept whole, chunks of it would not be solid */
+	if (cell->parts[p] < cell->nclosed) {
+	    if (ctx->split_components) {
+		snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%s%sbot.solid.%d.%zu", ctx->prefix, tag, i, solid_no++);
+	    } else {
+		snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%s%sbot.solid.%d", ctx->prefix, tag, i);
+	    }
+	    if (write_bot(ctx, ctx->tmp_name, lp, tris, n, RT_BOT_SOLID, RT_BOT_CCW, map)) {
+		bu_log("Failed to make Bot\n");
+	    } else {
+		(void)mk_addmember(ctx->tmp_name, head, NULL, WMOP_UNION);
+	    }
+	    continue;
+	}
+
+	for (start = 0; start < n; start += ctx->chunk_tris ? ctx->chunk_tris : n) {
+	    size_t count = n - start;
+
+	    if (ctx->chunk_tris && count > ctx->chunk_tris) {
+		count = ctx->chunk_tris;
+	    }
+	    if (ctx->split_components || (ctx->chunk_tris && n > ctx->chunk_tris)) {
+		snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%s%sbot.s%d.%zu", ctx->prefix, tag, i, surf_no++);
+	    } else {
+		snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%s%sbot.s%d", ctx->prefix, tag, i);
+	    }
+	    if (write_bot(ctx, ctx->tmp_name, lp, &tris[start*3], count,
+			  RT_BOT_SURFACE, RT_BOT_UNORIENTED, map)) {
+		bu_log("Failed to make Bot\n");
+	    } else {
+		(void)mk_addmember(ctx->tmp_name, head, NULL, WMOP_UNION);
+	    }
+	}
+    }
+    bu_free(map, "bot vertex map");
+}
+
+
+/* a box around a sketch in the xy plane, taking in the whole circle of each arc */
+static void
+sketch_bounds(const struct rt_sketch_internal *skt, point_t min, point_t max)
+{
+    point_t p;
+    size_t k;
+
+    VSETALL(min, INFINITY);
+    VSETALL(max, -INFINITY);
+    for (k = 0; k < skt->vert_count; k++) {
+	VSET(p, skt->verts[k][0], skt->verts[k][1], 0.0);
+	VMINMAX(min, max, p);
+    }
+
+    for (k = 0; k < skt->curve.count; k++) {
+	const struct carc_seg *cseg = (const struct carc_seg *)skt->curve.segment[k];
+	const fastf_t *s, *e;
+	fastf_t r, cx, cy;
+
+	if (cseg->magic != CURVE_CARC_MAGIC) {
+	    continue;
+	}
+	s = skt->verts[cseg->start];
+	e = skt->verts[cseg->end];
+	if (cseg->radius < 0.0) {
+	    /* full circle, end is the center */
+	    cx = e[X];
+	    cy = e[Y];
+	    r = hypot(s[X] - e[X], s[Y] - e[Y]);
+	} else {
+	    fastf_t dx = e[X] - s[X];
+	    fastf_t dy = e[Y] - s[Y];
+	    fastf_t chord = hypot(dx, dy);
+	    fastf_t d;
+
+	    r = cseg->radius;
+	    if (chord < SMALL_FASTF) {
+		continue;
+	    }
+	    d = sqrt(FMAX(r * r - chord * chord * 0.25, 0.0)) / chord;
+	    if (!cseg->center_is_left) {
+		d = -d;
+	    }
+	    cx = (s[X] + e[X]) * 0.5 - dy * d;
+	    cy = (s[Y] + e[Y]) * 0.5 + dx * d;
+	}
+	VSET(p, cx - r, cy - r, 0.0);
+	VMINMAX(min, max, p);
+	VSET(p, cx + r, cy + r, 0.0);
+	VMINMAX(min, max, p);
+    }
+}
+
+
+static void
+free_sketch(struct rt_sketch_internal *skt)
+{
+    rt_curve_free(&skt->curve);
+    if (skt->verts)
+	bu_free(skt->verts, "free verts");
+    bu_free(skt, "free sketch");
+}
+
+
+/* write a sketch made from the wires of layer lp */
+static void
+write_sketch(struct dxf_import *ctx, const char *name, struct layer *lp, struct rt_sketch_internal *skt, struct bu_list *head)
+{
+    point_t min, max;
+
+    mk_sketch(ctx->out_fp, name, skt);
+    sketch_bounds(skt, min, max);
+    write_bbox(ctx, name, min, max, lp);
+    (void) mk_addmember(name, head, NULL, WMOP_UNION);
+}
+
+
+/* one triangle, segment or curve and the grid cell it falls in */
+struct cell_item {
+    int ix, iy;
+    size_t idx;
+};
+
+
+static int
+cell_cmp(const void *a, const void *b, void *UNUSED(data))
+{
+    const struct cell_item *ca = (const struct cell_item *)a;
+    const struct cell_item *cb = (const struct cell_item *)b;
+
+    if (ca->ix != cb->ix) {
+	return (ca->ix < cb->ix) ? -1 : 1;
+    }
+    if (ca->iy != cb->iy) {
+	return (ca->iy < cb->iy) ? -1 : 1;
+    }
+    return (ca->idx < cb->idx) ? -1 : (ca->idx > cb->idx);
+}
+
+
+static void
+cell_of(const struct dxf_import *ctx, const fastf_t *pt, struct cell_item *item, size_t idx)
+{
+    item->ix = (int)floor(pt[X] / ctx->tile_mm);
+    item->iy = (int)floor(pt[Y] / ctx->tile_mm);
+    item->idx = idx;
+}
+
+
+/*
+ * Move the objects written for one grid cell of layer i to the layer
+ * list head, remembering them for the tile combinations.
+ */
+static void
+tile_collect(struct dxf_import *ctx, int ix, int iy, int i, struct bu_list *cell_head, struct bu_list *head)
+{
+    struct wmember *wp;
+
+    while (BU_LIST_WHILE(wp, wmember, cell_head)) {
+	struct tile_member *tm;
+
+	if (ctx->tile_count >= ctx->tile_max) {
+	    ctx->tile_max = ctx->tile_max ? ctx->tile_max * 2 : 64;
+	    ctx->tiles = (struct tile_member *)bu_realloc(ctx->tiles, ctx->tile_max * sizeof(struct tile_member), "tile members");
+	}
+	tm = &ctx->tiles[ctx->tile_count++];
+	tm->ix = ix;
+	tm->iy = iy;
+	tm->layer = i;
+	tm->seq = ctx->tile_count - 1;
+	tm->name = bu_strdup(wp->wm_name);
+
+	BU_LIST_DEQUEUE(&wp->l);
+	BU_LIST_INSERT(head, &wp->l);
+    }
+}
+
+
+/* a triangle, the piece of the mesh it is in and its grid cell */
+struct tri_cell {
+    int ix, iy;
+    int cut;			/* not in a closed shell that lies in one cell */
+    size_t piece;
+    size_t idx;
+};
+
+
+static int
+tri_cell_cmp(const void *a, const void *b, void *UNUSED(data))
+{
+    const struct tri_cell *ta = (const struct tri_cell *)a;
+    const struct tri_cell *tb = (const struct tri_cell *)b;
+
+    if (ta->ix != tb->ix) {
+	return (ta->ix < tb->ix) ? -1 : 1;
+    }
+    if (ta->iy != tb->iy) {
+	return (ta->iy < tb->iy) ? -1 : 1;
+    }
+    if (ta->cut != tb->cut) {
+	return ta->cut - tb->cut;
+    }
+    if (ta->piece != tb->piece) {
+	return (ta->piece < tb->piece) ? -1 : 1;
+    }
+    return (ta->idx < tb->idx) ? -1 : (ta->idx > tb->idx);
+}
+
+
+/*
+ * Orient the mesh of layer lp as a whole, then sort it into grid
+ * cells by triangle centroid.  A closed shell that reaches into more
+ * than one cell is written with the surfaces of each, as its parts are
+ * no longer solid.
+ */
+static void
+tile_mesh(struct dxf_import *ctx, struct layer *lp)
+{
+    const fastf_t *pts = lp->vert_tree->the_array;
+    struct tri_cell *items;
+    size_t *pieces, npieces, shells, nclosed;
+    int *sorted;
+    size_t k, p, start;
+
+    nclosed = orient_mesh(lp, lp->part_tris, lp->curr_tri, &shells, &pieces, &npieces);
+
+    items = (struct tri_cell *)bu_malloc(lp->curr_tri * sizeof(struct tri_cell), "triangle cells");
+    for (p = 0; p < npieces; p++) {
+	int cut = pieces[p] >= nclosed;
+
+	for (k = pieces[p]; k < pieces[p + 1]; k++) {
+	    const int *v = &lp->part_tris[k*3];
+	    struct cell_item cell;
+	    point_t c;
+
+	    VADD3(c, &pts[v[0]*3], &pts[v[1]*3], &pts[v[2]*3]);
+	    VSCALE(c, c, 1.0/3.0);
+	    cell_of(ctx, c, &cell, k);
+	    items[k].ix = cell.ix;
+	    items[k].iy = cell.iy;
+	    items[k].piece = p;
+	    items[k].idx = k;
+	    if (items[k].ix != items[pieces[p]].ix || items[k].iy != items[pieces[p]].iy) {
+		cut = 1;
+	    }
+	}
+	for (k = pieces[p]; k < pieces[p + 1]; k++) {
+	    items[k].cut = cut;
+	}
+	if (!cut) {
+	    lp->shell_count++;
+	}
+    }
+    bu_free(pieces, "mesh pieces");
+    bu_sort(items, lp->curr_tri, sizeof(struct tri_cell), tri_cell_cmp, NULL);
+
+    sorted = (int *)bu_malloc(3 * lp->curr_tri * sizeof(int), "triangles by cell");
+    for (k = 0; k < lp->curr_tri; k++) {
+	memcpy(&sorted[k*3], &lp->part_tris[items[k].idx*3], 3 * sizeof(int));
+    }
+    memcpy(lp->part_tris, sorted, 3 * lp->curr_tri * sizeof(int));
+    bu_free(sorted, "triangles by cell");
+
+    /* closed shells first in each cell, then the rest, one part for each piece with -p */
+    lp->mesh_cells = (struct mesh_cell *)bu_calloc(lp->curr_tri, sizeof(struct mesh_cell), "mesh cells");
+    for (start = 0; start < lp->curr_tri; start = k) {
+	struct mesh_cell *cell = &lp->mesh_cells[lp->mesh_cell_count++];
+
+	for (k = start + 1; k < lp->curr_tri && items[k].ix == items[start].ix && items[k].iy == items[start].iy; k++)
+	    ;
+	cell->ix = items[start].ix;
+	cell->iy = items[start].iy;
+	cell->start = start;
+	cell->count = k - start;
+	cell->parts = (size_t *)bu_malloc((cell->count + 2) * sizeof(size_t), "mesh parts");
+	cell->parts[0] = 0;
+	cell->nparts = 0;
+	for (p = start; p < k; p++) {
+	    if (!items[p].cut) {
+		cell->nclosed++;
+	    }
+	    if (p > start && (items[p].cut != items[p - 1].cut ||
+			      (ctx->split_components && items[p].piece != items[p - 1].piece))) {
+		cell->parts[++cell->nparts] = p - start;
+	    }
+	}
+	cell->parts[++cell->nparts] = cell->count;
+    }
+
+    bu_free(items, "triangle cells");
+}
+
+
+/* index in sub of point p of w, copying it over the first time */
+static int
+cell_point(const struct wire_store *w, struct wire_store *sub, int *map, int p)
+{
+    if (map[p] < 0) {
+	VMOVE(&sub->pts[sub->pt_count*3], &w->pts[p*3]);
+	map[p] = (int)sub->pt_count++;
+    }
+    return map[p];
+}
+
+
+/*
+ * Make a sketch of the wires of layer lp for each grid cell, by the
+ * middle of each line and the first point of each curve.
+ */
+static void
+tile_wires(struct dxf_import *ctx, struct layer *lp)
+{
+    struct wire_store *w = &lp->wires;
+    size_t count = w->seg_count + w->curve_count;
+    struct cell_item *items;
+    int *map;
+    size_t k, start;
+
+    items = (struct cell_item *)bu_malloc(count * sizeof(struct cell_item), "wire cells");
+    for (k = 0; k < w->seg_count; k++) {
+	point_t mid;
+
+	VADD2(mid, &w->pts[w->segs[k*2]*3], &w->pts[w->segs[k*2 + 1]*3]);
+	VSCALE(mid, mid, 0.5);
+	cell_of(ctx, mid, &items[k], k);
+    }
+    for (k = 0; k < w->curve_count; k++) {
+	const struct wire_curve *crv = &w->curves[k];
+	int first = (crv->type == CURVE_CARC_MAGIC) ? crv->start : crv->ctl;
+
+	cell_of(ctx, &w->pts[first*3], &items[w->seg_count + k], w->seg_count + k);
+    }
+    bu_sort(items, count, sizeof(struct cell_item), cell_cmp, NULL);
+
+    map = (int *)bu_malloc((w->pt_count + 1) * sizeof(int), "wire point map");
+    memset(map, 0xff, (w->pt_count + 1) * sizeof(int));
+    lp->sketch_cells = (struct sketch_cell *)bu_calloc(count, sizeof(struct sketch_cell), "sketch cells");
+
+    for (start = 0; start < count; start = k) {
+	struct wire_store sub;
+	struct rt_sketch_internal *skt;
+	size_t j, n, npts = 0;
+
+	for (k = start + 1; k < count && items[k].ix == items[start].ix && items[k].iy == items[start].iy; k++)
+	    ;
+
+	/* the lines and curves of the cell, with the points they use */
+	for (j = start; j < k; j++) {
+	    if (items[j].idx < w->seg_count || w->curves[items[j].idx - w->seg_count].type == CURVE_CARC_MAGIC) {
+		npts += 2;
+	    } else {
+		npts += w->curves[items[j].idx - w->seg_count].c_size;
+	    }
+	}
+	memset(&sub, 0, sizeof(sub));
+	sub.pts = (fastf_t *)bu_malloc((3 * npts + 1) * sizeof(fastf_t), "cell wire points");
+	sub.segs = (int *)bu_malloc((2 * (k - start) + 1) * sizeof(int), "cell wire segments");
+	sub.curves = (struct wire_curve *)bu_malloc((k - start + 1) * sizeof(struct wire_curve), "cell wire curves");
+
+	for (j = start; j < k; j++) {
+	    if (items[j].idx < w->seg_count) {
+		sub.segs[sub.seg_count*2] = cell_point(w, &sub, map, w->segs[items[j].idx*2]);
+		sub.segs[sub.seg_count*2 + 1] = cell_point(w, &sub, map, w->segs[items[j].idx*2 + 1]);
+		sub.seg_count++;
+	    } else {
+		struct wire_curve *crv = &sub.curves[sub.curve_count++];
+		int c;
+
+		*crv = w->curves[items[j].idx - w->seg_count];
+		if (crv->type == CURVE_CARC_MAGIC) {
+		    crv->start = cell_point(w, &sub, map, crv->start);
+		    crv->end = cell_point(w, &sub, map, crv->end);
+		} else {
+		    /* control points stay consecutive */
+		    int ctl = (int)sub.pt_count;
+
+		    for (c = 0; c < crv->c_size; c++) {
+			VMOVE(&sub.pts[sub.pt_count*3], &w->pts[(crv->ctl + c)*3]);
+			sub.pt_count++;
+		    }
+		    crv->ctl = ctl;
+		}
+	    }
+	}
+
+	skt = wires_to_sketch(ctx, &sub);
+	if (skt) {
+	    struct sketch_cell *cell = &lp->sketch_cells[lp->sketch_cell_count++];
+
+	    cell->ix = items[start].ix;
+	    cell->iy = items[start].iy;
+	    cell->skt = skt;
+	}
+
+	/* the sketch took over the knots and weights of its curves */
+	n = 0;
+	for (j = start; j < k; j++) {
+	    if (items[j].idx < w->seg_count) {
+		map[w->segs[items[j].idx*2]] = -1;
+		map[w->segs[items[j].idx*2 + 1]] = -1;
+	    } else {
+		struct wire_curve *crv = &w->curves[items[j].idx - w->seg_count];
+
+		if (crv->type == CURVE_CARC_MAGIC) {
+		    map[crv->start] = -1;
+		    map[crv->end] = -1;
+		}
+		crv->knots = sub.curves[n].knots;
+		crv->weights = sub.curves[n].weights;
+		n++;
+	    }
+	}
+	w->chain_count += sub.chain_count;
+	w->loop_count += sub.loop_count;
+	w->dup_count += sub.dup_count;
+	w->merged_count += sub.merged_count;
+
+	bu_free(sub.pts, "cell wire points");
+	bu_free(sub.segs, "cell wire segments");
+	bu_free(sub.curves, "cell wire curves");
+    }
+
+    bu_free(map, "wire point map");
+    bu_free(items, "wire cells");
+}
+
+
+/*
+ * The work on layer i that does not touch the database: orienting,
+ * splitting and sorting the mesh and making the sketches, for the
+ * whole layer or for each grid cell.  Layers may be prepared in
+ * parallel, as each only changes its own layer.
+ */
+static void
+prepare_layer(struct dxf_import *ctx, int i, int tiled)
+{
+    struct layer *lp = ctx->layers[i];
+    size_t k;
+
+    if (lp->curr_tri && lp->vert_tree->curr_vert > 2) {
+	if (tiled) {
+	    tile_mesh(ctx, lp);
+	} else {
+	    lp->mesh_cells = (struct mesh_cell *)bu_calloc(1, sizeof(struct mesh_cell), "mesh cells");
+	    lp->mesh_cells->count = lp->curr_tri;
+	    lp->mesh_cell_count = 1;
+	    prepare_mesh(ctx, lp, lp->mesh_cells);
+	}
+	for (k = 0; k < lp->mesh_cell_count; k++) {
+	    sort_mesh(ctx, lp, &lp->mesh_cells[k]);
+	}
+    }
+
+    if (lp->wires.seg_count || lp->wires.curve_count) {
+	if (tiled) {
+	    tile_wires(ctx, lp);
+	} else {
+	    struct rt_sketch_internal *skt = wires_to_sketch(ctx, &lp->wires);
+
+	    if (skt) {
+		lp->sketch_cells = (struct sketch_cell *)bu_calloc(1, sizeof(struct sketch_cell), "sketch cells");
+		lp->sketch_cells->skt = skt;
+		lp->sketch_cell_count = 1;
+	    }
+	}
+    }
+}
+
+
+struct prepare_data {
+    struct dxf_import *ctx;
+    int tiled;
+    int next_layer;
+};
+
+
+static void
+prepare_worker(int UNUSED(cpu), void *data)
+{
+    struct prepare_data *pd = (struct prepare_data *)data;
+    int i;
+
+    while (1) {
+	bu_semaphore_acquire(BU_SEM_GENERAL);
+	i = pd->next_layer++;
+	bu_semaphore_release(BU_SEM_GENERAL);
+
+	if (i >= pd->ctx->next_layer) {
+	    break;
+	}
+	prepare_layer(pd->ctx, i, pd->tiled);
+    }
+}
+
+
+static int
+tile_cmp(const void *a, const void *b, void *UNUSED(data))
+{
+    const struct tile_member *ta = (const struct tile_member *)a;
+    const struct tile_member *tb = (const struct tile_member *)b;
+
+    if (ta->ix != tb->ix) {
+	return (ta->ix < tb->ix) ? -1 : 1;
+    }
+    if (ta->iy != tb->iy) {
+	return (ta->iy < tb->iy) ? -1 : 1;
+    }
+    if (ta->layer != tb->layer) {
+	return (ta->layer < tb->layer) ? -1 : 1;
+    }
+    return (ta->seq < tb->seq) ? -1 : (ta->seq > tb->seq);
+}
+
+
+/*
+ * Group the objects written for each grid cell: a region for each
+ * layer in the cell, a combination for the cell and a "tiles"
+ * combination over all of the cells.
+ */
+static void
+write_tiles(struct dxf_import *ctx)
+{
+    struct bu_list head_tiles;
+    struct bu_vls name = BU_VLS_INIT_ZERO;
+    size_t k, j, start;
+
+    bu_sort(ctx->tiles, ctx->tile_count, sizeof(struct tile_member), tile_cmp, NULL);
+
+    BU_LIST_INIT(&head_tiles);
+    for (start = 0; start < ctx->tile_count; start = k) {
+	struct bu_list head_tile;
+
+	BU_LIST_INIT(&head_tile);
+	for (k = start; k < ctx->tile_count && ctx->tiles[k].ix == ctx->tiles[start].ix && ctx->tiles[k].iy == ctx->tiles[start].iy; k = j) {
+	    struct layer *lp = ctx->layers[ctx->tiles[k].layer];
+	    struct bu_list head;
+
+	    BU_LIST_INIT(&head);
+	    for (j = k; j < ctx->tile_count && ctx->tiles[j].ix == ctx->tiles[k].ix && ctx->tiles[j].iy == ctx->tiles[k].iy &&
+		     ctx->tiles[j].layer == ctx->tiles[k].layer; j++) {
+		(void)mk_addmember(ctx->tiles[j].name, &head, NULL, WMOP_UNION);
+	    }
+	    bu_vls_sprintf(&name, "%st%d_%d.%s.c.%d", ctx->prefix, ctx->tiles[k].ix, ctx->tiles[k].iy, lp->name, ctx->tiles[k].layer);
+	    /* a group, as the layer region already holds these primitives */
+	    if (mk_comb(ctx->out_fp, bu_vls_addr(&name), &head, 0, NULL, NULL,
+			&rgb[lp->color_number*3], 0, 0, 0, 0, 0, 0, 0)) {
+		bu_log("Failed to make combination %s\n", bu_vls_addr(&name));
+	    } else {
+		(void)mk_addmember(bu_vls_addr(&name), &head_tile, NULL, WMOP_UNION);
+	    }
+	}
+
+	bu_vls_sprintf(&name, "%st%d_%d", ctx->prefix, ctx->tiles[start].ix, ctx->tiles[start].iy);
+	if (mk_comb(ctx->out_fp, bu_vls_addr(&name), &head_tile, 0, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0)) {
+	    bu_log("Failed to make tile %s\n", bu_vls_addr(&name));
+	} else {
+	    (void)mk_addmember(bu_vls_addr(&name), &head_tiles, NULL, WMOP_UNION);
+	}
+    }
+
+    bu_vls_sprintf(&name, "%stiles", ctx->prefix);
+    if (BU_LIST_NON_EMPTY(&head_tiles) &&
+	mk_comb(ctx->out_fp, bu_vls_addr(&name), &head_tiles, 0, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0)) {
+	bu_log("Failed to make %s\n", bu_vls_addr(&name));
+    }
+    bu_vls_free(&name);
+}
+
+
+/*
+ * Write the accumulated geometry of each layer, plus a top level
+ * combination holding all of the layers.  Returns non-zero if the
+ * top level combination was written.
+ */
+static int
+write_layers(struct dxf_import *ctx)
+{
+    struct bu_list head_all;
+    int tiled;
+    int i;
+
+    curve_flush(ctx);
+    if (ctx->verbose) {
+	curve_report(ctx->curves);
+    }
+    if (ctx->block_replays) {
+	bu_log("block cache: %zu blocks parsed and %zu kept from an earlier import for %zu inserts (%.1f%% hits)\n",
+	       ctx->block_parses, ctx->block_kept, ctx->block_replays,
+	       100.0 * ((double)ctx->block_replays - (double)ctx->block_parses) / (double)ctx->block_replays);
+    }
+
+    /* block definitions are tiled where they are inserted */
+    ctx->tile_mm = ctx->tile_size * units_conv[ctx->units] * ctx->scale_factor;
+    tiled = ctx->tile_mm > SMALL_FASTF && !ctx->block_body;
+
+    /* only the database writes below have to be made one at a time, in layer order */
+    if (ctx->ncpu > 1 && ctx->next_layer > 1) {
+	struct prepare_data pd;
+
+	pd.ctx = ctx;
+	pd.tiled = tiled;
+	pd.next_layer = 0;
+	bu_parallel(prepare_worker, (ctx->ncpu < (size_t)ctx->next_layer) ? ctx->ncpu : (size_t)ctx->next_layer, &pd);
+    } else {
+	for (i = 0; i < ctx->next_layer; i++) {
+	    prepare_layer(ctx, i, tiled);
+	}
+    }
+
+    BU_LIST_INIT(&head_all);
+    for (i = 0; i < ctx->next_layer; i++) {
+	struct bu_list head;
+	size_t j;
+
+	BU_LIST_INIT(&head);
+	VSETALL(ctx->layers[i]->bb_min, INFINITY);
+	VSETALL(ctx->layers[i]->bb_max, -INFINITY);
+
+	if (ctx->layers[i]->color_number < 0)
+	    ctx->layers[i]->color_number = 7;
+
+	if (ctx->layers[i]->curr_tri || ctx->layers[i]->point_count ||
+	    BU_PTBL_LEN(&ctx->layers[i]->instances) || ctx->layers[i]->note_count ||
+	    ctx->layers[i]->wires.seg_count || ctx->layers[i]->wires.curve_count) {
+	    bu_log("LAYER: %s, color = %d (%d %d %d)\n", ctx->layers[i]->name, ctx->layers[i]->color_number, V3ARGS(&rgb[ctx->layers[i]->color_number*3]));
+	}
+
+	for (j = 0; j < ctx->layers[i]->mesh_cell_count; j++) {
+	    struct mesh_cell *cell = &ctx->layers[i]->mesh_cells[j];
+	    struct bu_list cell_head;
+	    char tag[64];
+
+	    if (!tiled) {
+		write_mesh(ctx, i, "", cell, &head);
+		continue;
+	    }
+	    BU_LIST_INIT(&cell_head);
+	    snprintf(tag, sizeof(tag), "t%d_%d.", cell->ix, cell->iy);
+	    write_mesh(ctx, i, tag, cell, &cell_head);
+	    tile_collect(ctx, cell->ix, cell->iy, i, &cell_head, &head);
+	}
+
+	if (ctx->layers[i]->point_count) {
+	    snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%s%s.pnts.%d", ctx->prefix, ctx->layers[i]->name, i);
+	    if (write_points(ctx, ctx->tmp_name, ctx->layers[i])) {
+		bu_log("Failed to make point cloud\n");
+	    } else {
+		(void)mk_addmember(ctx->tmp_name, &head, NULL, WMOP_UNION);
+	    }
+	}
+
+	for (j = 0; j < BU_PTBL_LEN(&ctx->layers[i]->instances); j++) {
+	    struct block_instance *inst = (struct block_instance *)BU_PTBL_GET(&ctx->layers[i]->instances, j);
+
+	    (void)mk_addmember(inst->comb_name, &head, inst->xform, WMOP_UNION);
+	}
+
+	if (ctx->layers[i]->note_count) {
+	    write_annotations(ctx, i, &head_all);
+	}
+
+	for (j = 0; j < ctx->layers[i]->sketch_cell_count; j++) {
+	    struct sketch_cell *cell = &ctx->layers[i]->sketch_cells[j];
+	    struct bu_list cell_head;
+
+	    if (!tiled) {
+		snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%ssketch.%d", ctx->prefix, i);
+		write_sketch(ctx, ctx->tmp_name, ctx->layers[i], cell->skt, &head);
+		continue;
+	    }
+	    BU_LIST_INIT(&cell_head);
+	    snprintf(ctx->tmp_name, sizeof(ctx->tmp_name), "%st%d_%d.sketch.%d", ctx->prefix, cell->ix, cell->iy, i);
+	    write_sketch(ctx, ctx->tmp_name, ctx->layers[i], cell->skt, &cell_head);
+	    tile_collect(ctx, cell->ix, cell->iy, i, &cell_head, &head);
+	}
+
+	if (ctx->layers[i]->line_count) {
+	    bu_log("\t%zu lines\n", ctx->layers[i]->line_count);
+	}
+
+	if (ctx->layers[i]->solid_count) {
+	    bu_log("\t%zu solids\n", ctx->layers[i]->solid_count);
+	}
+
+	if (ctx->layers[i]->polyline_count) {
+	    bu_log("\t%zu polylines\n", ctx->layers[i]->polyline_count);
+	}
+
+	if (ctx->layers[i]->lwpolyline_count) {
+	    bu_log("\t%zu lwpolylines\n", ctx->layers[i]->lwpolyline_count);
+	}
+
+	if (ctx->layers[i]->ellipse_count) {
+	    bu_log("\t%zu ellipses\n", ctx->layers[i]->ellipse_count);
+	}
+
+	if (ctx->layers[i]->circle_count) {
+	    bu_log("\t%zu circles\n", ctx->layers[i]->circle_count);
+	}
+
+	if (ctx->layers[i]->arc_count) {
+	    bu_log("\t%zu arcs\n", ctx->layers[i]->arc_count);
+	}
+
+	if (ctx->layers[i]->text_count) {
+	    bu_log("\t%zu texts\n", ctx->layers[i]->text_count);
+	}
+
+	if (ctx->layers[i]->mtext_count) {
+	    bu_log("\t%zu mtexts\n", ctx->layers[i]->mtext_count);
+	}
+
+	if (ctx->layers[i]->attrib_count) {
+	    bu_log("\t%zu attribs\n", ctx->layers[i]->attrib_count);
+	}
+
+	if (ctx->layers[i]->note_count) {
+	    bu_log("\t%zu annotations\n", ctx->layers[i]->note_count);
+	}
+
+	if (ctx->layers[i]->dimension_count) {
+	    bu_log("\t%zu dimensions\n", ctx->layers[i]->dimension_count);
+	}
+
+	if (ctx->layers[i]->leader_count) {
+	    bu_log("\t%zu leaders\n", ctx->layers[i]->leader_count);
+	}
+
+	if (ctx->layers[i]->face3d_count) {
+	    bu_log("\t%zu 3d faces\n", ctx->layers[i]->face3d_count);
+	}
+
+	if (ctx->layers[i]->dup_tris) {
+	    bu_log("\t%zu repeated faces dropped\n", ctx->layers[i]->dup_tris);
+	}
+
+	if (ctx->layers[i]->shell_count) {
+	    bu_log("\t%zu closed shells\n", ctx->layers[i]->shell_count);
+	}
+
+	if (ctx->layers[i]->point_count) {
+	    bu_log("\t%zu points\n", ctx->layers[i]->point_count);
+	}
+	if (ctx->layers[i]->spline_count) {
+	    bu_log("\t%zu splines\n", ctx->layers[i]->spline_count);
+	}
+	if (ctx->layers[i]->wires.dup_count || ctx->layers[i]->wires.merged_count) {
+	    struct wire_store *w = &ctx->layers[i]->wires;
+
+	    bu_log("\t%zu duplicate and %zu merged line segments removed (%.1f%% of %zu)\n",
+		   w->dup_count, w->merged_count,
+		   100.0 * (double)(w->dup_count + w->merged_count) / (double)w->seg_count, w->seg_count);
+	}
+	if (ctx->layers[i]->wires.chain_count || ctx->layers[i]->wires.loop_count) {
+	    bu_log("\t%zu open chains, %zu closed loops\n",
+		   ctx->layers[i]->wires.chain_count, ctx->layers[i]->wires.loop_count);
+	}
+	if (ctx->layers[i]->curve_segs_fixed) {
+	    bu_log("\t%zu curve segments (%zu at fixed resolution)\n",
+		   ctx->layers[i]->curve_segs, ctx->layers[i]->curve_segs_fixed);
+	}
+	if (BU_PTBL_LEN(&ctx->layers[i]->instances)) {
+	    bu_log("\t%zu block references\n", BU_PTBL_LEN(&ctx->layers[i]->instances));
+	}
+
+
+	if (BU_LIST_NON_EMPTY(&head)) {
+	    unsigned char *tmp_rgb;
+	    struct bu_vls comb_name = BU_VLS_INIT_ZERO;
+
+	    tmp_rgb = &rgb[ctx->layers[i]->color_number*3];
+	    bu_vls_printf(&comb_name, "%s%s.c.%d", ctx->prefix, ctx->layers[i]->name, i);
+	    /* inside a block the region is the layer that references it */
+	    if (mk_comb(ctx->out_fp, bu_vls_addr(&comb_name), &head, !ctx->block_body, NULL, NULL,
+			tmp_rgb, 1, 0, 1, 100, 0, 0, 0)) {
+		bu_log("Failed to make region %s\n", ctx->layers[i]->name);
+	    } else {
+		write_bbox(ctx, bu_vls_addr(&comb_name), ctx->layers[i]->bb_min, ctx->layers[i]->bb_max, NULL);
+		(void)mk_addmember(bu_vls_addr(&comb_name), &head_all, NULL, WMOP_UNION);
+	    }
+	    bu_vls_free(&comb_name);
+	}
+
+    }
+
+    if (tiled && ctx->tile_count) {
+	write_tiles(ctx);
+    }
+
+
+    if (BU_LIST_NON_EMPTY(&head_all)) {
+	struct bu_vls top_name = BU_VLS_INIT_ZERO;
+	const char *base = ctx->top_name ? ctx->top_name : "all";
+	int count = 0;
+	int ret;
+
+	bu_vls_strcpy(&top_name, base);
+	while (db_lookup(ctx->out_fp->dbip, bu_vls_addr(&top_name), LOOKUP_QUIET) != RT_DIR_NULL) {
+	    count++;
+	    bu_vls_trunc(&top_name, 0);
+	    bu_vls_printf(&top_name, "%s.%d", base, count);
+	}
+
+	ret = mk_comb(ctx->out_fp, bu_vls_addr(&top_name), &head_all, 0, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0);
+	bu_vls_free(&top_name);
+	return !ret;
+    }
+
+    return 0;
+}
+
+
+/* free count layers, some of which may share a vertex tree */
+static void
+free_layers(struct layer **layers, int count)
+{
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+	struct layer *lp = layers[i];
+	size_t k;
+
+	if (!lp) {
+	    continue;
+	}
+
+	if (lp->name) {
+	    bu_free(lp->name, "layer name");
+	}
+	if (lp->vert_tree) {
+	    /* POLYLINE layer switches share a vertex tree with the previous layer */
+	    for (j = i + 1; j < count; j++) {
+		if (layers[j] && layers[j]->vert_tree == lp->vert_tree) {
+		    layers[j]->vert_tree = NULL;
+		}
+	    }
+	    bn_vert_tree_destroy(lp->vert_tree);
+	}
+	if (lp->part_tris) {
+	    bu_free(lp->part_tris, "layers[layer]->part_tris");
+	}
+	if (lp->tri_hash) {
+	    bu_free(lp->tri_hash, "triangle hash");
+	}
+	for (k = 0; k < lp->mesh_cell_count; k++) {
+	    bu_free(lp->mesh_cells[k].parts, "mesh parts");
+	}
+	if (lp->mesh_cells) {
+	    bu_free(lp->mesh_cells, "mesh cells");
+	}
+	for (k = 0; k < lp->sketch_cell_count; k++) {
+	    free_sketch(lp->sketch_cells[k].skt);
+	}
+	if (lp->sketch_cells) {
+	    bu_free(lp->sketch_cells, "sketch cells");
+	}
+	if (lp->name || lp->instances.buffer) {
+	    for (k = 0; k < BU_PTBL_LEN(&lp->instances); k++) {
+		bu_free((char *)BU_PTBL_GET(&lp->instances, k), "block_instance");
+	    }
+	    bu_ptbl_free(&lp->instances);
+	    for (k = 0; k < BU_PTBL_LEN(&lp->refs); k++) {
+		bu_free((char *)BU_PTBL_GET(&lp->refs, k), "block_ref");
+	    }
+	    bu_ptbl_free(&lp->refs);
+	}
+	if (lp->point_pts) {
+	    bu_free(lp->point_pts, "point_pts");
+	}
+	for (k = 0; k < lp->note_count; k++) {
+	    bu_free(lp->notes[k].text, "annotation text");
+	}
+	if (lp->notes) {
+	    bu_free(lp->notes, "annotations");
+	}
+	if (lp->wires.pts) {
+	    bu_free(lp->wires.pts, "wire points");
+	}
+	if (lp->wires.segs) {
+	    bu_free(lp->wires.segs, "wire segments");
+	}
+	for (k = 0; k < lp->wires.curve_count; k++) {
+	    if (lp->wires.curves[k].knots) {
+		bu_free(lp->wires.curves[k].knots, "wire curve knots");
+	    }
+	    if (lp->wires.curves[k].weights) {
+		bu_free(lp->wires.curves[k].weights, "wire curve weights");
+	    }
+	}
+	if (lp->wires.curves) {
+	    bu_free(lp->wires.curves, "wire curves");
+	}
+	bu_free(lp, "struct layer");
+    }
+}
+
+
+static void
+free_parsed_block(struct parsed_block *pb)
+{
+    free_layers(pb->layers, pb->layer_count);
+    bu_free(pb->layers, "parsed layers");
+    bu_free(pb, "parsed_block");
+}
+
+
+/* release everything owned by a converter context */
+static void
+dxf_import_free(struct dxf_import *ctx)
+{
+    struct recorded_file *rf;
+    struct block_list *blk;
+    struct state_data *state;
+    int i;
+
+    if (ctx->dxf) {
+	fclose(ctx->dxf);
+    }
+
+    free_layers(ctx->layers, ctx->max_layers);
+    bu_free(ctx->layers, "layers");
+
+    /* block recordings are left for the next import of this file */
+    rf = NULL;
+    while (BU_LIST_WHILE(blk, block_list, &ctx->block_head)) {
+	BU_LIST_DEQUEUE(&blk->l);
+	if (blk->block_name) {
+	    bu_free(blk->block_name, "block_name");
+	}
+	if (blk->parsed && ctx->cache && !rf) {
+	    rf = recorded_file_find(ctx->cache, &ctx->record_key, 1);
+	}
+	if (blk->parsed && rf) {
+	    blk->parsed->offset = blk->offset;
+	    bu_ptbl_ins(&rf->blocks, (long *)blk->parsed);
+	} else if (blk->parsed) {
+	    free_parsed_block(blk->parsed);
+	}
+	bu_free(blk, "block_list");
+    }
+    bu_vls_free(&ctx->record_key);
+
+    while (BU_LIST_WHILE(state, state_data, &ctx->state_stack)) {
+	BU_LIST_DEQUEUE(&state->l);
+	bu_free(state, "curr_state");
+    }
+    bu_free(ctx->curr_state, "curr_state");
+
+    if (ctx->insert_ent.new_state) {
+	bu_free(ctx->insert_ent.new_state, "new_state");
+    }
+    if (ctx->dimension_ent.new_state) {
+	bu_free(ctx->dimension_ent.new_state, "new_state");
+    }
+    if (ctx->dimension_ent.block_name) {
+	bu_free(ctx->dimension_ent.block_name, "block_name");
+    }
+    if (ctx->text_ent.theText) {
+	bu_free(ctx->text_ent.theText, "theText");
+    }
+    if (ctx->mtext_ent.vls) {
+	bu_vls_free(ctx->mtext_ent.vls);
+	BU_PUT(ctx->mtext_ent.vls, struct bu_vls);
+    }
+    if (ctx->spline_ent.knots) bu_free(ctx->spline_ent.knots, "spline knots");
+    if (ctx->spline_ent.weights) bu_free(ctx->spline_ent.weights, "spline weights");
+    if (ctx->spline_ent.ctlPts) bu_free(ctx->spline_ent.ctlPts, "spline control points");
+    if (ctx->spline_ent.fitPts) bu_free(ctx->spline_ent.fitPts, "spline fit points");
+
+    for (i = 0; (size_t)i < ctx->tile_count; i++) {
+	bu_free(ctx->tiles[i].name, "tile member");
+    }
+    if (ctx->tiles) {
+	bu_free(ctx->tiles, "tile members");
+    }
+
+    if (ctx->cache) {
+	/* hand the buffers back for the next import */
+	if (ctx->polyline_verts) {
+	    /* a block import may have handed back its own meanwhile */
+	    if (ctx->cache->polyline_verts) {
+		bu_free(ctx->cache->polyline_verts, "polyline_verts");
+	    }
+	    ctx->cache->polyline_verts = ctx->polyline_verts;
+	    ctx->cache->polyline_vertex_max = ctx->polyline_vertex_max;
+	}
+	if (ctx->polyline_vert_indices) {
+	    if (ctx->cache->polyline_vert_indices) {
+		bu_free(ctx->cache->polyline_vert_indices, "polyline_vert_indices");
+	    }
+	    ctx->cache->polyline_vert_indices = ctx->polyline_vert_indices;
+	    ctx->cache->polyline_vert_indices_max = ctx->polyline_vert_indices_max;
+	}
+	BU_LIST_APPEND_LIST(&ctx->cache->free_hd, &ctx->free_hd);
+	if (ctx->glyphs) {
+	    if (ctx->cache->glyphs) {
+		glyphs_free(ctx->cache->glyphs);
+	    }
+	    ctx->cache->glyphs = ctx->glyphs;
+	}
+	if (ctx->cache->curve_tmpl) {
+	    curve_templates_free(ctx->cache->curve_tmpl);
+	}
+	ctx->cache->curve_tmpl = ctx->curves->tmpl;
+    } else {
+	if (ctx->polyline_verts) {
+	    bu_free(ctx->polyline_verts, "polyline_verts");
+	}
+	if (ctx->polyline_vert_indices) {
+	    bu_free(ctx->polyline_vert_indices, "polyline_vert_indices");
+	}
+	bn_vlist_cleanup(&ctx->free_hd);
+	if (ctx->glyphs) {
+	    glyphs_free(ctx->glyphs);
+	}
+	curve_templates_free(ctx->curves->tmpl);
+    }
+    if (ctx->curr_layer_name) {
+	bu_free(ctx->curr_layer_name, "curr_layer_name");
+    }
+    if (ctx->curves->scratch_max) {
+	bu_free(ctx->curves->ct, "curve cos");
+	bu_free(ctx->curves->st, "curve sin");
+	bu_free(ctx->curves->x, "curve x");
+	bu_free(ctx->curves->y, "curve y");
+	bu_free(ctx->curves->z, "curve z");
+    }
+    bu_free(ctx->curves, "curve_batch");
+    bu_free(ctx->dxf_file, "dxf_file");
+    bu_free(ctx->prefix, "prefix");
+    if (ctx->top_name) {
+	bu_free(ctx->top_name, "top_name");
+    }
+    if (ctx->own_blocks) {
+	dxf_block_library_destroy(ctx->blocks);
+    }
+    bu_free(ctx, "dxf_import");
+}
+
+
+struct dxf_block_library *
+dxf_block_library_create(void)
+{
+    struct dxf_block_library *lib;
+
+    BU_ALLOC(lib, struct dxf_block_library);
+    bu_ptbl_init(&lib->defs, 64, "block defs");
+
+    return lib;
+}
+
+
+void
+dxf_block_library_destroy(struct dxf_block_library *lib)
+{
+    size_t i;
+
+    for (i = 0; i < BU_PTBL_LEN(&lib->defs); i++) {
+	struct block_def *def = (struct block_def *)BU_PTBL_GET(&lib->defs, i);
+
+	bu_free(def->block_name, "block_name");
+	if (def->comb_name) {
+	    bu_free(def->comb_name, "comb_name");
+	}
+	bu_free(def, "block_def");
+    }
+    bu_ptbl_free(&lib->defs);
+    bu_free(lib, "dxf_block_library");
+}
+
+
+void
+dxf_block_library_report(const struct dxf_block_library *lib)
+{
+    bu_log("Block library: %zu definitions converted, %zu references reused a converted definition\n",
+	   lib->converted, lib->reused);
+}
+
+
+/*
+ * Start an import of the body of blk, sharing the header values and
+ * block table of ctx.  Returns NULL if the file cannot be reopened.
+ */
+static struct dxf_import *
+open_block_import(struct dxf_import *ctx, struct block_list *blk, const char *prefix, const char *top_name)
+{
+    struct dxf_import_opts opts;
+    struct dxf_import *sub;
+    struct block_list *b, *copy;
+    fastf_t **tmpl;
+
+    dxf_import_opts_init(&opts);
+    opts.verbose = ctx->verbose;
+    opts.ignore_colors = ctx->ignore_colors;
+    opts.native_curves = ctx->native_curves;
+    opts.dedup_reversed = ctx->dedup_reversed;
+    opts.spatial_order = ctx->spatial_order;
+    opts.chunk_tris = ctx->chunk_tris;
+    opts.split_components = ctx->split_components;
+    opts.tile_size = ctx->tile_size;
+    opts.annotations = ctx->annotations;
+    opts.chord_error = ctx->chord_error;
+    opts.simplify_tol = ctx->simplify_tol;
+    opts.tol = ctx->tol;
+    opts.scale_factor = ctx->scale_factor;
+    opts.blocks = ctx->blocks;
+    opts.cache = ctx->cache;
+    opts.top_name = top_name;
+    opts.prefix = prefix;
+
+    sub = dxf_import_open(ctx->dxf_file, ctx->out_fp, &opts);
+    if (!sub) {
+	return NULL;
+    }
+
+    /* the stroke font and curve templates are lent to the block import, see close_block_import() */
+    if (ctx->glyphs) {
+	if (sub->glyphs) {
+	    glyphs_free(sub->glyphs);
+	}
+	sub->glyphs = ctx->glyphs;
+	ctx->glyphs = NULL;
+    }
+    tmpl = sub->curves->tmpl;
+    sub->curves->tmpl = ctx->curves->tmpl;
+    ctx->curves->tmpl = tmpl;
+
+    /* header values and the block table come from the enclosing file */
+    sub->units = ctx->units;
+    sub->splineSegs = ctx->splineSegs;
+    sub->color_by_layer = ctx->color_by_layer;
+    for (BU_LIST_FOR(b, block_list, &ctx->block_head)) {
+	BU_ALLOC(copy, struct block_list);
+	*copy = *b;
+	copy->block_name = b->block_name ? bu_strdup(b->block_name) : NULL;
+	copy->parsed = NULL;
+	BU_LIST_INSERT(&sub->block_head, &copy->l);
+    }
+
+    sub->block_body = 1;
+    sub->curr_state->state = ENTITIES_SECTION;
+    sub->curr_state->sub_state = UNKNOWN_ENTITY_STATE;
+    bu_fseek(sub->dxf, blk->offset, SEEK_SET);
+
+    return sub;
+}
+
+
+/* free a block import, taking back the stroke font and curve templates it may have added to */
+static void
+close_block_import(struct dxf_import *ctx, struct dxf_import *sub)
+{
+    fastf_t **tmpl;
+
+    tmpl = sub->curves->tmpl;
+    sub->curves->tmpl = ctx->curves->tmpl;
+    ctx->curves->tmpl = tmpl;
+    if (sub->glyphs) {
+	if (ctx->glyphs) {
+	    glyphs_free(ctx->glyphs);
+	}
+	ctx->glyphs = sub->glyphs;
+	sub->glyphs = NULL;
+    }
+    dxf_import_free(sub);
+}
+
+
+/*
+ * Import the body of one BLOCK into its own set of objects, named
+ * after comb_name, with comb_name as the top level combination.
+ * Nested INSERTs become references into the same library.  Returns
+ * non-zero if the block produced any geometry.
+ */
+static int
+convert_block(struct dxf_import *ctx, struct block_list *blk, const char *comb_name)
+{
+    struct dxf_import *sub;
+    struct bu_vls prefix = BU_VLS_INIT_ZERO;
+    int ret;
+
+    bu_vls_printf(&prefix, "%s.", comb_name);
+    sub = open_block_import(ctx, blk, bu_vls_addr(&prefix), comb_name);
+    bu_vls_free(&prefix);
+    if (!sub) {
+	return 0;
+    }
+
+    while (dxf_import_feed(sub, 0))
+	;
+    ret = write_layers(sub);
+    close_block_import(ctx, sub);
+
+    return ret;
+}
+
+
+/*
+ * Take the recording of blk an earlier import of the same file left
+ * in the cache, pointing its nested INSERTs at this import's blocks.
+ * Returns zero if there is none.
+ */
+static int
+recording_take(struct dxf_import *ctx, struct block_list *blk)
+{
+    struct recorded_file *rf;
+    struct parsed_block *pb = NULL;
+    struct block_list *b;
+    size_t k;
+    int i;
+
+    if (!ctx->cache || (rf = recorded_file_find(ctx->cache, &ctx->record_key, 0)) == NULL) {
+	return 0;
+    }
+    for (k = 0; !pb && k < BU_PTBL_LEN(&rf->blocks); k++) {
+	pb = (struct parsed_block *)BU_PTBL_GET(&rf->blocks, k);
+	if (pb->offset != blk->offset) {
+	    pb = NULL;
+	}
+    }
+    if (!pb) {
+	return 0;
+    }
+    bu_ptbl_rm(&rf->blocks, (long *)pb);
+
+    for (i = 0; i < pb->layer_count; i++) {
+	for (k = 0; k < BU_PTBL_LEN(&pb->layers[i]->refs); k++) {
+	    struct block_ref *ref = (struct block_ref *)BU_PTBL_GET(&pb->layers[i]->refs, k);
+
+	    ref->blk = NULL;
+	    for (BU_LIST_FOR(b, block_list, &ctx->block_head)) {
+		if (ref->offset >= 0 && b->offset == ref->offset) {
+		    ref->blk = b;
+		    break;
+		}
+	    }
+	}
+    }
+
+    blk->parsed = pb;
+    ctx->block_kept++;
+    return 1;
+}
+
+
+/*
+ * Parse the body of blk once into blk->parsed.  INSERTs inside it
+ * are kept as references to the enclosing file's blocks rather than
+ * expanded, and POINTs as positions, so nothing is written to the
+ * database until the recording is replayed.
+ */
+static void
+record_block(struct dxf_import *ctx, struct block_list *blk)
+{
+    struct dxf_import *sub;
+    struct parsed_block *pb;
+    struct block_list *b;
+    size_t k;
+    int i;
+
+    if (recording_take(ctx, blk)) {
+	return;
+    }
+
+    sub = open_block_import(ctx, blk, ctx->prefix, NULL);
+    if (!sub) {
+	return;
+    }
+    sub->recording = 1;
+
+    while (dxf_import_feed(sub, 0))
+	;
+    curve_flush(sub);
+
+    /* keep the layers, the sub-import is left with none */
+    BU_ALLOC(pb, struct parsed_block);
+    pb->layers = sub->layers;
+    pb->layer_count = sub->max_layers;
+    sub->layers = (struct layer **)bu_calloc(1, sizeof(struct layer *), "layers");
+    sub->max_layers = 0;
+    sub->next_layer = 0;
+
+    for (i = 0; i < pb->layer_count; i++) {
+	struct layer *lp = pb->layers[i];
+
+	for (k = 0; k < lp->wires.curve_count; k++) {
+	    if (lp->wires.curves[k].type == CURVE_CARC_MAGIC) {
+		pb->has_arcs = 1;
+	    }
+	}
+	if (lp->curve_segs) {
+	    pb->has_chords = 1;
+	}
+
+	/* references point at the sub-import's copy of the block table */
+	for (k = 0; k < BU_PTBL_LEN(&lp->refs); k++) {
+	    struct block_ref *ref = (struct block_ref *)BU_PTBL_GET(&lp->refs, k);
+
+	    for (BU_LIST_FOR(b, block_list, &ctx->block_head)) {
+		if (b->offset == ref->blk->offset && BU_STR_EQUAL(b->block_name, ref->blk->block_name)) {
+		    break;
+		}
+	    }
+	    ref->blk = BU_LIST_IS_HEAD(b, &ctx->block_head) ? NULL : b;
+	    ref->offset = ref->blk ? ref->blk->offset : -1;
+	}
+    }
+
+    close_block_import(ctx, sub);
+    blk->parsed = pb;
+    ctx->block_parses++;
+}
+
+
+/*
+ * Whether blk, and every block it inserts, can be replayed under
+ * xform.  Returns 1 if so, 0 to expand it from the file instead, and
+ * -1 if it inserts itself.
+ */
+static int
+replay_check(struct dxf_import *ctx, struct block_list *blk, const mat_t xform)
+{
+    struct parsed_block *pb;
+    fastf_t scale;
+    int mirror;
+    int ret = 1;
+    size_t k;
+    int i;
+
+    if (!blk) {
+	return 1;
+    }
+    if (!blk->parsed) {
+	record_block(ctx, blk);
+	if (!blk->parsed) {
+	    return 0;
+	}
+    }
+    pb = blk->parsed;
+    if (pb->replaying) {
+	bu_log("ERROR: block %s inserts itself\n\tignoring\n", blk->block_name);
+	return -1;
+    }
+
+    /* native arcs need a similarity, and chords were sized for the block's own scale */
+    if (pb->has_arcs && !xform_similar_xy(xform, &scale, &mirror)) {
+	return 0;
+    }
+    if (pb->has_chords && ctx->chord_error > 0.0 && xform_scale(xform) > 1.0 + SMALL_FASTF) {
+	return 0;
+    }
+
+    pb->replaying = 1;
+    for (i = 0; ret > 0 && i < pb->layer_count; i++) {
+	struct layer *lp = pb->layers[i];
+
+	for (k = 0; ret > 0 && k < BU_PTBL_LEN(&lp->refs); k++) {
+	    struct block_ref *ref = (struct block_ref *)BU_PTBL_GET(&lp->refs, k);
+	    mat_t m;
+
+	    bn_mat_mul(m, xform, ref->xform);
+	    ret = replay_check(ctx, ref->blk, m);
+	}
+    }
+    pb->replaying = 0;
+
+    return ret;
+}
+
+
+/*
+ * Add the recording of blk to the current geometry under xform.  What
+ * the block has on layer 0 goes on the layer of the INSERT, the
+ * current layer, which is left as it was.
+ */
+static void
+replay_layers(struct dxf_import *ctx, struct parsed_block *pb, const mat_t xform)
+{
+    struct state_data state;
+    fastf_t scale;
+    int mirror;
+    int *vmap = NULL;
+    size_t vmap_max = 0;
+    int *dst_layers;
+    char *layer_name;
+    int layer, color;
+    size_t j, k;
+    int i;
+
+    layer_name = ctx->curr_layer_name;
+    ctx->curr_layer_name = NULL;
+    layer = ctx->curr_layer;
+    color = ctx->curr_color;
+    dst_layers = (int *)bu_calloc(pb->layer_count + 1, sizeof(int), "replay layers");
+
+    MAT_COPY(state.xform, xform);
+    state.xform_type = xform_classify(xform);
+    (void)xform_similar_xy(xform, &scale, &mirror);
+
+    for (i = 0; i < pb->layer_count; i++) {
+	struct layer *src = pb->layers[i];
+	struct layer *dst;
+	struct wire_store *w;
+	size_t base;
+
+	if (!src->name) {
+	    continue;
+	}
+
+	if (i == 0) {
+	    ctx->curr_layer = layer;
+	} else {
+	    if (ctx->curr_layer_name) {
+		bu_free(ctx->curr_layer_name, "curr_layer_name");
+	    }
+	    ctx->curr_layer_name = bu_strdup(src->name);
+	    ctx->curr_color = src->color_number;
+	    get_layer(ctx);
+	}
+	dst_layers[i] = ctx->curr_layer;
+	dst = ctx->layers[ctx->curr_layer];
+	w = &dst->wires;
+
+	/* wires and curves, with their indices moved past the existing points */
+	base = w->pt_count;
+	wire_reserve(w, src->wires.pt_count, src->wires.seg_count);
+	memcpy(&w->pts[base*3], src->wires.pts, src->wires.pt_count * 3 * sizeof(fastf_t));
+	xform_points(&state, &w->pts[base*3], src->wires.pt_count);
+	w->pt_count += src->wires.pt_count;
+	for (k = 0; k < src->wires.seg_count * 2; k++) {
+	    w->segs[w->seg_count*2 + k] = src->wires.segs[k] + (int)base;
+	}
+	w->seg_count += src->wires.seg_count;
+
+	for (k = 0; k < src->wires.curve_count; k++) {
+	    const struct wire_curve *from = &src->wires.curves[k];
+	    struct wire_curve *crv = wire_curve(ctx, from->type);
+
+	    *crv = *from;
+	    crv->start += (int)base;
+	    crv->end += (int)base;
+	    crv->ctl += (int)base;
+	    if (from->knots) {
+		crv->knots = (fastf_t *)bu_malloc(from->k_size * sizeof(fastf_t), "wire curve knots");
+		memcpy(crv->knots, from->knots, from->k_size * sizeof(fastf_t));
+	    }
+	    if (from->weights) {
+		crv->weights = (fastf_t *)bu_malloc(from->c_size * sizeof(fastf_t), "wire curve weights");
+		memcpy(crv->weights, from->weights, from->c_size * sizeof(fastf_t));
+	    }
+	    if (from->type == CURVE_CARC_MAGIC) {
+		crv->radius *= scale;
+		if (mirror && from->radius >= 0.0) {
+		    crv->orientation = !crv->orientation;
+		    crv->center_is_left = !crv->center_is_left;
+		}
+	    }
+	}
+
+	/* triangles, through a map from the recorded vertices to this layer's */
+	if (src->curr_tri) {
+	    size_t nverts = src->vert_tree->curr_vert;
+
+	    if (nverts > vmap_max) {
+		vmap_max = nverts;
+		vmap = (int *)bu_realloc(vmap, vmap_max * sizeof(int), "replay vertex map");
+	    }
+	    for (j = 0; j < nverts; j++) {
+		vmap[j] = -1;
+	    }
+	    for (j = 0; j < src->curr_tri * 3; j += 3) {
+		int v[3];
+
+		for (k = 0; k < 3; k++) {
+		    int idx = src->part_tris[j + k];
+
+		    if (vmap[idx] < 0) {
+			point_t pt;
+
+			VMOVE(pt, &src->vert_tree->the_array[idx*3]);
+			xform_points(&state, pt, 1);
+			vmap[idx] = bn_vert_tree_add(dst->vert_tree, V3ARGS(pt), ctx->tol_sq);
+		    }
+		    v[k] = vmap[idx];
+		}
+		add_triangle(ctx, v[0], v[1], v[2], ctx->curr_layer);
+	    }
+	}
+
+	for (k = 0; k < src->note_count; k++) {
+	    struct annotation *note;
+
+	    if (dst->note_count >= dst->note_max) {
+		dst->note_max = dst->note_max ? dst->note_max * 2 : 16;
+		dst->notes = (struct annotation *)bu_realloc(dst->notes, dst->note_max * sizeof(struct annotation), "annotations");
+	    }
+	    note = &dst->notes[dst->note_count++];
+	    *note = src->notes[k];
+	    note->text = bu_strdup(src->notes[k].text);
+	    xform_points(&state, note->pt, 1);
+	    annotation_xform(note, xform);
+	}
+
+	if (src->point_count) {
+	    point_reserve(dst, src->point_count);
+	    memcpy(&dst->point_pts[dst->point_count*3], src->point_pts, src->point_count * 3 * sizeof(fastf_t));
+	    xform_points(&state, &dst->point_pts[dst->point_count*3], src->point_count);
+	    dst->point_count += src->point_count;
+	}
 
-		if (!layers[curr_layer]->m) {
-		    create_nmg();
-		}
+	dst->line_count += src->line_count;
+	dst->solid_count += src->solid_count;
+	dst->polyline_count += src->polyline_count;
+	dst->lwpolyline_count += src->lwpolyline_count;
+	dst->ellipse_count += src->ellipse_count;
+	dst->circle_count += src->circle_count;
+	dst->spline_count += src->spline_count;
+	dst->arc_count += src->arc_count;
+	dst->text_count += src->text_count;
+	dst->mtext_count += src->mtext_count;
+	dst->attrib_count += src->attrib_count;
+	dst->dimension_count += src->dimension_count;
+	dst->leader_count += src->leader_count;
+	dst->face3d_count += src->face3d_count;
+	dst->curve_segs += src->curve_segs;
+	dst->curve_segs_fixed += src->curve_segs_fixed;
+    }
 
-		/* apply transformation */
-		MAT4X3PNT(tmp_pt, curr_state->xform, firstAlignmentPoint);
-		VMOVE(firstAlignmentPoint, tmp_pt);
-		MAT4X3PNT(tmp_pt, curr_state->xform, secondAlignmentPoint);
-		VMOVE(secondAlignmentPoint, tmp_pt);
+    if (vmap) {
+	bu_free(vmap, "replay vertex map");
+    }
 
-		drawString(theText, firstAlignmentPoint, secondAlignmentPoint,
-			   textHeight, textScale, textRotation, horizAlignment, vertAlignment, textFlag);
-		layers[curr_layer]->text_count++;
+    for (i = 0; i < pb->layer_count; i++) {
+	for (k = 0; k < BU_PTBL_LEN(&pb->layers[i]->refs); k++) {
+	    struct block_ref *ref = (struct block_ref *)BU_PTBL_GET(&pb->layers[i]->refs, k);
+	    mat_t m;
+
+	    if (ref->blk) {
+		/* a nested INSERT is on the layer its own layer was replayed to */
+		ctx->curr_layer = dst_layers[i];
+		bn_mat_mul(m, xform, ref->xform);
+		replay_layers(ctx, ref->blk->parsed, m);
+		ctx->block_replays++;
 	    }
-	    horizAlignment = 0;
-	    vertAlignment = 0;
-	    textFlag = 0;
-	    VSET(firstAlignmentPoint, 0.0, 0.0, 0.0);
-	    VSET(secondAlignmentPoint, 0.0, 0.0, 0.0);
-	    textScale = 1.0;
-	    textRotation = 0.0;
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+	}
     }
 
-    return 0;
+    bu_free(dst_layers, "replay layers");
+    if (ctx->curr_layer_name) {
+	bu_free(ctx->curr_layer_name, "curr_layer_name");
+    }
+    ctx->curr_layer_name = layer_name;
+    ctx->curr_layer = layer;
+    ctx->curr_color = color;
 }
 
 
+/*
+ * Expand an INSERT of blk from its recording, parsing the block on
+ * first use.  Returns zero if the block must be read from the file
+ * again instead.
+ */
 static int
-process_dimension_entities_code(int code)
+replay_block(struct dxf_import *ctx, struct block_list *blk, const mat_t xform)
 {
-    static char *block_name=NULL;
-    static struct state_data *new_state=NULL;
-    struct block_list *blk;
-
-    switch (code) {
-	case 10:
-	case 20:
-	case 30:
-	    break;
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 2:	/* block name */
-	    block_name = bu_strdup(line);
-	    break;
-	case 0:
-	    if (block_name != NULL) {
-		/* insert this dimension block */
-		get_layer();
-		BU_ALLOC(new_state, struct state_data);
-		*new_state = *curr_state;
-		if (verbose) {
-		    bu_log("Created a new state for DIMENSION\n");
-		}
-		for (BU_LIST_FOR(blk, block_list, &block_head)) {
-		    if (block_name) {
-			if (BU_STR_EQUAL(blk->block_name, block_name)) {
-			    break;
-			}
-		    }
-		}
-		if (BU_LIST_IS_HEAD(blk, &block_head)) {
-		    bu_log("ERROR: DIMENSION references non-existent block (%s)\n", block_name);
-		    bu_log("\tignoring missing block\n");
-		    blk = NULL;
-		}
-		new_state->curr_block = blk;
-		if (verbose && blk) {
-		    bu_log("Inserting block %s\n", blk->block_name);
-		}
+    int ret;
 
-		if (block_name) {
-		    bu_free(block_name, "block_name");
-		}
-
-		if (new_state->curr_block) {
-		    BU_LIST_PUSH(&state_stack, &(curr_state->l));
-		    curr_state = new_state;
-		    new_state = NULL;
-		    bu_fseek(dxf, curr_state->curr_block->offset, SEEK_SET);
-		    curr_state->state = ENTITIES_SECTION;
-		    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-		    if (verbose) {
-			bu_log("Changing state for INSERT\n");
-			bu_log("seeked to %jd\n", (intmax_t)curr_state->curr_block->offset);
-		    }
-		    layers[curr_layer]->dimension_count++;
-		}
-	    } else {
-		curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-		process_entities_code[curr_state->sub_state](code);
-	    }
-	    break;
+    ret = replay_check(ctx, blk, xform);
+    if (ret <= 0) {
+	return ret < 0;
     }
 
-    return 0;
+    replay_layers(ctx, blk->parsed, xform);
+    ctx->block_replays++;
+
+    return 1;
 }
 
 
-static int
-process_arc_entities_code(int code)
+/* the library combination for blk, converting it on first use */
+static const char *
+get_block_def(struct dxf_import *ctx, struct block_list *blk)
 {
-    static point_t center={0, 0, 0};
-    static fastf_t radius;
-    static fastf_t start_angle, end_angle;
-    int num_segs;
-    int coord, i;
-    struct vertex *v0=NULL, *v1=NULL, *v2=NULL;
-    struct edgeuse *eu;
-
-    switch (code) {
-	case 8:		/* layer name */
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	    coord = code / 10 - 1;
-	    center[coord] = atof(line) * units_conv[units] * scale_factor;
-	    if (verbose) {
-		bu_log("ARC center coord #%d = %g\n", coord, center[coord]);
-	    }
-	    break;
-	case 40:
-	    radius = atof(line) * units_conv[units] * scale_factor;
-	    if (verbose) {
-		bu_log("ARC radius = %g\n", radius);
-	    }
-	    break;
-	case 50:
-	    start_angle = atof(line);
-	    if (verbose) {
-		bu_log("ARC start angle = %g\n", start_angle);
-	    }
-	    break;
-	case 51:
-	    end_angle = atof(line);
-	    if (verbose) {
-		bu_log("ARC end angle = %g\n", end_angle);
-	    }
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    /* end of this arc entity
-	     * make a series of wire edges in the NMG to approximate an arc
-	     */
-
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found an arc\n");
-	    }
+    struct dxf_block_library *lib = ctx->blocks;
+    struct block_def *def = blk->def;
+    size_t i;
+
+    for (i = 0; !def && i < BU_PTBL_LEN(&lib->defs); i++) {
+	def = (struct block_def *)BU_PTBL_GET(&lib->defs, i);
+	if (def->hash != blk->hash || !BU_STR_EQUAL(def->block_name, blk->block_name)) {
+	    def = NULL;
+	}
+    }
 
-	    layers[curr_layer]->arc_count++;
+    if (def) {
+	blk->def = def;
+	if (def->converting) {
+	    bu_log("ERROR: block %s inserts itself\n\tignoring\n", blk->block_name);
+	    return NULL;
+	}
+	lib->reused++;
+	return def->comb_name;
+    }
 
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
-	    }
+    BU_ALLOC(def, struct block_def);
+    def->block_name = bu_strdup(blk->block_name);
+    def->hash = blk->hash;
+    bu_ptbl_ins(&lib->defs, (long *)def);
+    blk->def = def;
 
-	    while (end_angle < start_angle) {
-		end_angle += 360.0;
-	    }
+    {
+	struct bu_vls name = BU_VLS_INIT_ZERO;
+	char *block_name = make_brlcad_name(blk->block_name);
+	int count = 0;
 
-	    /* calculate arc at origin first */
-	    num_segs = (end_angle - start_angle) / 360.0 * segs_per_circle;
-	    start_angle *= DEG2RAD;
-	    end_angle *= DEG2RAD;
-	    if (verbose) {
-		bu_log("arc has %d segs\n", num_segs);
-	    }
+	/* a block of the same name with a different definition gets a new name */
+	bu_vls_printf(&name, "block.%s", block_name);
+	while (db_lookup(ctx->out_fp->dbip, bu_vls_addr(&name), LOOKUP_QUIET) != RT_DIR_NULL) {
+	    count++;
+	    bu_vls_trunc(&name, 0);
+	    bu_vls_printf(&name, "block.%s.%d", block_name, count);
+	}
+	bu_free(block_name, "block_name");
 
-	    V_MAX(num_segs, 1);
+	if (ctx->verbose) {
+	    bu_log("Converting block %s as %s\n", blk->block_name, bu_vls_addr(&name));
+	}
 
-	    VSET(circle_pts[0], radius * cos(start_angle), radius * sin(start_angle), 0.0);
-	    for (i=1; i<num_segs; i++) {
-		circle_pts[i][X] = circle_pts[i-1][X]*cos_delta - circle_pts[i-1][Y]*sin_delta;
-		circle_pts[i][Y] = circle_pts[i-1][Y]*cos_delta + circle_pts[i-1][X]*sin_delta;
-	    }
-	    circle_pts[num_segs][X] = radius * cos(end_angle);
-	    circle_pts[num_segs][Y] = radius * sin(end_angle);
-	    num_segs++;
+	def->converting = 1;
+	if (convert_block(ctx, blk, bu_vls_addr(&name))) {
+	    def->comb_name = bu_vls_strdup(&name);
+	}
+	def->converting = 0;
+	bu_vls_free(&name);
+    }
+    lib->converted++;
 
-	    if (verbose) {
-		bu_log("ARC points calculated:\n");
-		for (i = 0; i < num_segs; i++) {
-		    bu_log("\t point #%d: (%g %g %g)\n", i, V3ARGS(circle_pts[i]));
-		}
-	    }
+    return def->comb_name;
+}
 
-	    /* move everything to the specified center */
-	    for (i = 0; i < num_segs; i++) {
-		point_t tmp_pt;
 
-		VADD2(circle_pts[i], circle_pts[i], center);
+static void
+add_block_instance(struct dxf_import *ctx, struct block_list *blk, mat_t xform)
+{
+    struct block_instance *inst;
+    const char *comb_name;
 
-		/* apply transformation */
-		MAT4X3PNT(tmp_pt, curr_state->xform, circle_pts[i]);
-		VMOVE(circle_pts[i], tmp_pt);
-	    }
+    if ((comb_name = get_block_def(ctx, blk)) == NULL) {
+	return;
+    }
 
-	    if (verbose) {
-		bu_log("ARC points after move to center at (%g %g %g):\n", V3ARGS(center));
-		for (i = 0; i < num_segs; i++) {
-		    bu_log("\t point #%d: (%g %g %g)\n", i, V3ARGS(circle_pts[i]));
-		}
-	    }
+    get_layer(ctx);
+    BU_ALLOC(inst, struct block_instance);
+    inst->comb_name = comb_name;
+    MAT_COPY(inst->xform, xform);
+    bu_ptbl_ins(&ctx->layers[ctx->curr_layer]->instances, (long *)inst);
+}
 
-	    /* make nmg wire edges */
-	    for (i = 1; i < num_segs; i++) {
-		if (i == num_segs) {
-		    v2 = v0;
-		}
-		eu = nmg_me(v1, v2, layers[curr_layer]->s);
-		if (i == 1) {
-		    v1 = eu->vu_p->v_p;
-		    v0 = v1;
-		    nmg_vertex_gv(v1, circle_pts[0]);
-		}
-		v2 = eu->eumate_p->vu_p->v_p;
-		if (i < segs_per_circle) {
-		    nmg_vertex_gv(v2, circle_pts[i]);
-		}
-		if (verbose) {
-		    bu_log("Wire edge (arc) #%d (%g %g %g) <-> (%g %g %g)\n", i,
-			   V3ARGS(v1->vg_p->coord),
-			   V3ARGS(v2->vg_p->coord));
-		}
-		v1 = v2;
-		v2 = NULL;
-	    }
 
-	    VSETALL(center, 0.0);
-	    for (i = 0; i < segs_per_circle; i++) {
-		VSETALL(circle_pts[i], 0.0);
-	    }
+int
+dxf_import_finish(struct dxf_import *ctx)
+{
+    /* consume anything the caller did not feed */
+    while (dxf_import_feed(ctx, 0))
+	;
 
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+    (void)write_layers(ctx);
+    if (ctx->own_blocks && ctx->verbose) {
+	dxf_block_library_report(ctx->blocks);
     }
+    dxf_import_free(ctx);
 
     return 0;
 }
 
 
-static int
-process_spline_entities_code(int code)
-{
-    static int flag = 0;
-    static int degree = 0;
-    static int numKnots = 0;
-    static int numCtlPts = 0;
-    static int numFitPts = 0;
-    static fastf_t *knots = NULL;
-    static fastf_t *weights = NULL;
-    static fastf_t *ctlPts = NULL;
-    static fastf_t *fitPts = NULL;
-    static int knotCount = 0;
-    static int weightCount = 0;
-    static int ctlPtCount = 0;
-    static int fitPtCount = 0;
-    static int subCounter = 0;
-    static int subCounter2 = 0;
-    int i;
-    int coord;
-    struct edge_g_cnurb *crv;
-    int pt_type;
-    int ncoords;
-    struct vertex *v1 = NULL;
-    struct vertex *v2 = NULL;
-    struct edgeuse *eu;
-    fastf_t startParam;
-    fastf_t stopParam;
-    fastf_t paramDelta;
-    point_t pt;
+#ifndef DXF_IMPORT_NO_MAIN
 
-    switch (code) {
-	case 8:
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 210:
-	case 220:
-	case 230:
-	    coord = code / 10 - 21;
-	    break;
-	case 70:
-	    flag = atoi(line);
-	    break;
-	case 71:
-	    degree = atoi(line);
-	    break;
-	case 72:
-	    numKnots = atoi(line);
-	    if (numKnots > 0) {
-		knots = (fastf_t *)bu_malloc(numKnots*sizeof(fastf_t),
-					     "spline knots");
-	    }
-	    break;
-	case 73:
-	    numCtlPts = atoi(line);
-	    if (numCtlPts > 0) {
-		ctlPts = (fastf_t *)bu_malloc(numCtlPts*3*sizeof(fastf_t),
-					      "spline control points");
-		weights = (fastf_t *)bu_malloc(numCtlPts*sizeof(fastf_t),
-					       "spline weights");
-	    }
-	    for (i = 0; i < numCtlPts; i++) {
-		weights[i] = 1.0;
-	    }
-	    break;
-	case 74:
-	    numFitPts = atoi(line);
-	    if (numFitPts > 0) {
-		fitPts = (fastf_t *)bu_malloc(numFitPts*3*sizeof(fastf_t),
-					      "fit control points");
-	    }
-	    break;
-	case 42:
-	    break;
-	case 43:
-	    break;
-	case 44:
-	    break;
-	case 12:
-	case 22:
-	case 32:
-	    coord = code / 10 - 1;
-	    /* start tangent, unimplemented */
-	    break;
-	case 13:
-	case 23:
-	case 33:
-	    coord = code / 10 - 1;
-	    /* end tangent, unimplemented */
-	    break;
-	case 40:
-	    knots[knotCount++] = atof(line);
-	    break;
-	case 41:
-	    weights[weightCount++] = atof(line);
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	    coord = (code / 10) - 1 + ctlPtCount*3;
-	    ctlPts[coord] = atof(line) * units_conv[units] * scale_factor;
-	    subCounter++;
-	    if (subCounter > 2) {
-		ctlPtCount++;
-		subCounter = 0;
-	    }
-	    break;
-	case 11:
-	case 21:
-	case 31:
-	    coord = (code / 10) - 1 + fitPtCount*3;
-	    fitPts[coord] = atof(line) * units_conv[units] * scale_factor;
-	    subCounter2++;
-	    if (subCounter2 > 2) {
-		fitPtCount++;
-		subCounter2 = 0;
-	    }
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    /* draw the spline */
-	    get_layer();
-	    layers[curr_layer]->spline_count++;
+static char *usage="Usage: dxf-g [-a] [-c] [-d] [-i] [-n] [-o] [-p] [-v] [-w] [-e chord_error] [-g tile_size] [-k chunk_triangles] [-r simplify_tolerance] [-t tolerance] [-s scale_factor] [-P #_of_CPUs] input_file.dxf output_file.g\n"
+    "       dxf-g [-a] [-c] [-d] [-i] [-n] [-o] [-p] [-v] [-w] [-e chord_error] [-g tile_size] [-k chunk_triangles] [-r simplify_tolerance] [-t tolerance] [-s scale_factor] [-P #_of_CPUs] -b manifest_file\n"
+    "       dxf-g [-a] [-c] [-d] [-i] [-n] [-o] [-p] [-v] [-w] [-e chord_error] [-g tile_size] [-k chunk_triangles] [-r simplify_tolerance] [-t tolerance] [-s scale_factor] [-P #_of_CPUs] -S socket_path\n"
+    "       dxf-g [-a] [-c] [-d] [-n] [-o] [-p] [-v] [-w] [-e chord_error] [-g tile_size] [-k chunk_triangles] [-r simplify_tolerance] [-t tolerance] [-s scale_factor] [-P #_of_CPUs] -m output_file.g input_file.dxf ...\n";
 
-	    if (flag & SPLINE_RATIONAL) {
-		ncoords = 4;
-		pt_type = RT_NURB_MAKE_PT_TYPE(ncoords, RT_NURB_PT_XYZ, RT_NURB_PT_RATIONAL);
-	    } else {
-		ncoords = 3;
-		pt_type = RT_NURB_MAKE_PT_TYPE(ncoords, RT_NURB_PT_XYZ, RT_NURB_PT_NONRAT);
-	    }
-	    crv = nmg_nurb_new_cnurb(degree+1, numCtlPts+degree+1, numCtlPts, pt_type);
-
-	    for (i = 0; i < numKnots; i++) {
-		crv->k.knots[i] = knots[i];
-	    }
-	    for (i = 0; i < numCtlPts; i++) {
-		crv->ctl_points[i*ncoords + 0] = ctlPts[i*3+0];
-		crv->ctl_points[i*ncoords + 1] = ctlPts[i*3+1];
-		crv->ctl_points[i*ncoords + 2] = ctlPts[i*3+2];
-		if (flag & SPLINE_RATIONAL) {
-		    crv->ctl_points[i*ncoords + 3] = weights[i];
-		}
-	    }
-	    if (!layers[curr_layer]->m) {
-		create_nmg();
-	    }
-	    startParam = knots[0];
-	    stopParam = knots[numKnots-1];
-	    paramDelta = (stopParam - startParam) / (double)splineSegs;
-	    nmg_nurb_c_eval(crv, startParam, pt);
-	    for (i = 0; i < splineSegs; i++) {
-		fastf_t param = startParam + paramDelta * (i+1);
-		eu = nmg_me(v1, v2, layers[curr_layer]->s);
-		v1 = eu->vu_p->v_p;
-		if (i == 0) {
-		    nmg_vertex_gv(v1, pt);
-		}
-		nmg_nurb_c_eval(crv, param, pt);
-		v2 = eu->eumate_p->vu_p->v_p;
-		nmg_vertex_gv(v2, pt);
-
-		v1 = v2;
-		v2 = NULL;
-	    }
-
-	    nmg_nurb_free_cnurb(crv);
-
-	    if (knots != NULL) bu_free(knots, "spline knots");
-	    if (weights != NULL) bu_free(weights, "spline weights");
-	    if (ctlPts != NULL) bu_free(ctlPts, "spline control points");
-	    if (fitPts != NULL) bu_free(fitPts, "spline fit points");
-	    flag = 0;
-	    degree = 0;
-	    numKnots = 0;
-	    numCtlPts = 0;
-	    numFitPts = 0;
-	    knotCount = 0;
-	    weightCount = 0;
-	    ctlPtCount = 0;
-	    fitPtCount = 0;
-	    subCounter = 0;
-	    subCounter2 = 0;
-	    knots = NULL;
-	    weights = NULL;
-	    ctlPts = NULL;
-	    fitPts = NULL;
-
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
-    }
 
-    return 0;
+/* one entry of a batch manifest */
+struct batch_job {
+    char *dxf_file;
+    char *output_file;
+    off_t bytes;		/* size of the DXF file */
+    int64_t usec;		/* conversion time */
+    int status;
+};
+
+
+struct batch_data {
+    struct batch_job *jobs;
+    size_t njobs;
+    size_t next_job;
+    const struct dxf_import_opts *opts;
+};
+
+
+/*
+ * Only the import caches are kept across daemon jobs.  A block library
+ * names combinations in the database it was filled for, and every job
+ * writes a new database, so with -i each job gets a private library.
+ */
+struct daemon_data {
+    const struct dxf_import_opts *opts;
+    struct dxf_import_cache **caches;	/* one per worker slot, kept across jobs */
+};
+
+
+/* title for the database, the DXF file name without path or extension */
+static char *
+dxf_base_name(const char *dxf_file)
+{
+    const char *ptr1, *ptr2;
+    size_t name_len;
+    char *base_name;
+
+    ptr1 = strrchr(dxf_file, '/');
+    if (ptr1 == NULL)
+	ptr1 = dxf_file;
+    else
+	ptr1++;
+    ptr2 = strchr(ptr1, '.');
+
+    if (ptr2 == NULL)
+	name_len = strlen(ptr1);
+    else
+	name_len = ptr2 - ptr1;
+
+    base_name = (char *)bu_calloc((unsigned int)name_len + 1, 1, "base_name");
+    bu_strlcpy(base_name , ptr1 , name_len+1);
+
+    return base_name;
 }
+
+
+/* convert one DXF file into a new database, returns 0 on success */
 static int
-process_3dface_entities_code(int code)
+convert_file(const char *dxf_file, const char *output_file, const struct dxf_import_opts *opts)
 {
-    int vert_no;
-    int coord;
-    int face[5];
+    struct dxf_import *ctx;
+    struct rt_wdb *out_fp;
+    char *base_name;
 
-    switch (code) {
-	case 8:
-	    if (curr_layer_name) {
-		bu_free(curr_layer_name, "curr_layer_name");
-	    }
-	    curr_layer_name = make_brlcad_name(line);
-	    break;
-	case 10:
-	case 20:
-	case 30:
-	case 11:
-	case 21:
-	case 31:
-	case 12:
-	case 22:
-	case 32:
-	case 13:
-	case 23:
-	case 33:
-	    vert_no = code % 10;
-	    coord = code / 10 - 1;
-	    pts[vert_no][coord] = atof(line) * units_conv[units] * scale_factor;
-	    if (verbose) {
-		bu_log("3dface vertex #%d coord #%d = %g\n", vert_no, coord, pts[vert_no][coord]);
-	    }
-	    if (vert_no == 2) {
-		pts[3][coord] = pts[2][coord];
-	    }
-	    break;
-	case 62:	/* color number */
-	    curr_color = atoi(line);
-	    break;
-	case 0:
-	    /* end of this 3dface */
-	    get_layer();
-	    if (verbose) {
-		bu_log("Found end of 3DFACE\n");
-	    }
-	    if (verbose) {
-		bu_log("\tmaking two triangles\n");
-	    }
-	    layers[curr_layer]->face3d_count++;
-	    for (vert_no = 0; vert_no < 4; vert_no++) {
-		point_t tmp_pt1;
-		MAT4X3PNT(tmp_pt1, curr_state->xform, pts[vert_no]);
-		VMOVE(pts[vert_no], tmp_pt1);
-		face[vert_no] = bn_vert_tree_add(layers[curr_layer]->vert_tree,
-						 V3ARGS(pts[vert_no]),
-						 tol_sq);
-	    }
-	    add_triangle(face[0], face[1], face[2], curr_layer);
-	    add_triangle(face[2], face[3], face[0], curr_layer);
-	    if (verbose) {
-		bu_log("finished face\n");
-	    }
+    if (!bu_file_exists(dxf_file, NULL)) {
+	perror(dxf_file);
+	bu_log("Cannot open DXF file (%s)\n", dxf_file);
+	return 1;
+    }
+
+    if ((out_fp = wdb_fopen(output_file)) == NULL) {
+	perror(output_file);
+	bu_log("Cannot open BRL-CAD geometry file (%s)\n", output_file);
+	return 1;
+    }
 
-	    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-	    process_entities_code[curr_state->sub_state](code);
-	    break;
+    base_name = dxf_base_name(dxf_file);
+    mk_id(out_fp, base_name);
+    bu_free(base_name, "base_name");
+
+    if ((ctx = dxf_import_open(dxf_file, out_fp, opts)) == NULL) {
+	wdb_close(out_fp);
+	return 1;
     }
 
+    (void)dxf_import_feed(ctx, 0);
+    (void)dxf_import_finish(ctx);
+
+    wdb_close(out_fp);
+
     return 0;
 }
 
 
+/*
+ * Import several DXF files into one database.  Each sheet's objects
+ * are prefixed with the sheet name and grouped under a combination
+ * of that name, and all sheets share one block library.  Sheets with
+ * the same file name in different directories are told apart by a
+ * ".2", ".3", ... after the name.
+ */
 static int
-process_entity_code(int code)
+merge_files(const char *output_file, int nfiles, char **dxf_files, const struct dxf_import_opts *sheet_opts)
 {
-    return process_entities_code[curr_state->sub_state](code);
-}
+    struct dxf_import_opts opts = *sheet_opts;
+    struct dxf_block_library *lib;
+    struct dxf_import *ctx;
+    struct rt_wdb *out_fp;
+    struct bu_vls prefix = BU_VLS_INIT_ZERO;
+    struct bu_vls sheet = BU_VLS_INIT_ZERO;
+    char **base_names;
+    char *base_name;
+    int64_t start;
+    int converted = 0;
+    int i, j, n;
 
+    if ((out_fp = wdb_fopen(output_file)) == NULL) {
+	perror(output_file);
+	bu_log("Cannot open BRL-CAD geometry file (%s)\n", output_file);
+	return 1;
+    }
 
-static int
-process_objects_code(int code)
-{
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
+    base_name = dxf_base_name(output_file);
+    mk_id(out_fp, base_name);
+    bu_free(base_name, "base_name");
+
+    lib = dxf_block_library_create();
+    opts.blocks = lib;
+    if (!opts.cache) {
+	opts.cache = dxf_import_cache_create();
+    }
+
+    base_names = (char **)bu_calloc(nfiles + 1, sizeof(char *), "base_names");
+    for (i = 0; i < nfiles; i++) {
+	base_names[i] = dxf_base_name(dxf_files[i]);
+    }
+
+    start = bu_gettime();
+    for (i = 0; i < nfiles; i++) {
+	for (j = 0, n = 1; j < i; j++) {
+	    if (BU_STR_EQUAL(base_names[j], base_names[i])) {
+		n++;
 	    }
-	    break;
+	}
+	if (n > 1) {
+	    bu_vls_sprintf(&sheet, "%s.%d", base_names[i], n);
+	    bu_log("%s: sheet named %s\n", dxf_files[i], bu_vls_addr(&sheet));
+	} else {
+	    bu_vls_strcpy(&sheet, base_names[i]);
+	}
+	bu_vls_sprintf(&prefix, "%s.", bu_vls_addr(&sheet));
+	opts.prefix = bu_vls_addr(&prefix);
+	opts.top_name = bu_vls_addr(&sheet);
+
+	if (!bu_file_exists(dxf_files[i], NULL) ||
+	    (ctx = dxf_import_open(dxf_files[i], out_fp, &opts)) == NULL) {
+	    bu_log("Cannot open DXF file (%s)\n", dxf_files[i]);
+	    continue;
+	}
+
+	(void)dxf_import_feed(ctx, 0);
+	(void)dxf_import_finish(ctx);
+	converted++;
     }
 
-    return 0;
+    for (i = 0; i < nfiles; i++) {
+	bu_free(base_names[i], "base_name");
+    }
+    bu_free(base_names, "base_names");
+
+    bu_log("Merged %d of %d files in %.3f s\n", converted, nfiles,
+	   (double)(bu_gettime() - start) / 1.0e6);
+    dxf_block_library_report(lib);
+
+    if (!sheet_opts->cache) {
+	dxf_import_cache_destroy(opts.cache);
+    }
+    dxf_block_library_destroy(lib);
+    bu_vls_free(&prefix);
+    bu_vls_free(&sheet);
+    wdb_close(out_fp);
+
+    return converted != nfiles;
 }
 
 
-static int
-process_thumbnail_code(int code)
+static void
+batch_worker(int UNUSED(cpu), void *data)
 {
-    switch (code) {
-	case 999:	/* comment */
-	    printf("%s\n", line);
-	    break;
-	case 0:		/* text string */
-	    if (!bu_strncmp(line, "SECTION", 7)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    } else if (!bu_strncmp(line, "ENDSEC", 6)) {
-		curr_state->state = UNKNOWN_SECTION;
-		break;
-	    }
+    struct batch_data *bd = (struct batch_data *)data;
+    struct dxf_import_opts opts = *bd->opts;
+    struct batch_job *job;
+    struct stat sb;
+    int64_t start;
+    size_t idx;
+
+    /* keep this worker's buffers warm from one file to the next */
+    opts.cache = dxf_import_cache_create();
+
+    while (1) {
+	bu_semaphore_acquire(BU_SEM_GENERAL);
+	idx = bd->next_job++;
+	bu_semaphore_release(BU_SEM_GENERAL);
+
+	if (idx >= bd->njobs) {
 	    break;
+	}
+
+	job = &bd->jobs[idx];
+	if (stat(job->dxf_file, &sb) == 0) {
+	    job->bytes = sb.st_size;
+	}
+
+	start = bu_gettime();
+	job->status = convert_file(job->dxf_file, job->output_file, &opts);
+	job->usec = bu_gettime() - start;
+
+	bu_log("%s -> %s: %s, %.3f s\n", job->dxf_file, job->output_file,
+	       job->status ? "FAILED" : "ok", (double)job->usec / 1.0e6);
     }
 
-    return 0;
+    dxf_import_cache_destroy(opts.cache);
 }
 
 
 /*
- * Create a sketch object based on the wire edges in an NMG
+ * Convert every input/output pair listed in the manifest file, one
+ * pair per line separated by white space.  Blank lines and lines
+ * starting with '#' are ignored.  Returns the number of failures.
  */
-static struct rt_sketch_internal *
-nmg_wire_edges_to_sketch(struct model *m)
+static int
+batch_convert(const char *manifest, size_t ncpu, const struct dxf_import_opts *opts)
 {
-    struct rt_sketch_internal *skt;
-    struct bu_ptbl segs;
-    struct nmgregion *r;
-    struct shell *s;
-    struct edgeuse *eu;
-    struct vertex *v;
-    struct bn_vert_tree *tree;
-    size_t idx;
+    struct batch_data bd;
+    struct bu_vls in = BU_VLS_INIT_ZERO;
+    struct bu_vls out = BU_VLS_INIT_ZERO;
+    char buf[MAX_LINE_SIZE];
+    size_t max_jobs = 0;
+    size_t failed = 0;
+    off_t total_bytes = 0;
+    int64_t start, elapsed;
+    double secs;
+    FILE *fp;
+    size_t i;
+
+    if ((fp = fopen(manifest, "rb")) == NULL) {
+	perror(manifest);
+	bu_exit(1, "Cannot open batch manifest (%s)\n", manifest);
+    }
 
-    BU_ALLOC(skt, struct rt_sketch_internal);
-    skt->magic = RT_SKETCH_INTERNAL_MAGIC;
-    VSET(skt->V, 0.0, 0.0, 0.0);
-    VSET(skt->u_vec, 1.0, 0.0, 0.0);
-    VSET(skt->v_vec, 0.0, 1.0, 0.0);
+    memset(&bd, 0, sizeof(struct batch_data));
+    bd.opts = opts;
+
+    while (bu_fgets(buf, MAX_LINE_SIZE, fp)) {
+	char *c = buf;
+	char *word;
+
+	while (isspace((unsigned char)*c))
+	    c++;
+	if (*c == '\0' || *c == '#')
+	    continue;
+
+	bu_vls_trunc(&in, 0);
+	bu_vls_trunc(&out, 0);
+	for (word = c; *c && !isspace((unsigned char)*c); c++)
+	    ;
+	bu_vls_strncpy(&in, word, c - word);
+	while (isspace((unsigned char)*c))
+	    c++;
+	for (word = c; *c && !isspace((unsigned char)*c); c++)
+	    ;
+	bu_vls_strncpy(&out, word, c - word);
+
+	if (!bu_vls_strlen(&out)) {
+	    bu_log("%s: no output file for %s, skipping\n", manifest, bu_vls_cstr(&in));
+	    continue;
+	}
 
-    tree = bn_vert_tree_create();
-    bu_ptbl_init(&segs, 64, "segs for sketch");
-    for (BU_LIST_FOR(r, nmgregion, &m->r_hd)) {
-	for (BU_LIST_FOR(s, shell, &r->s_hd)) {
-	    struct edgeuse *eu1;
-
-	    /* add a line segment for each wire edge */
-	    bu_ptbl_reset(&segs);
-	    eu1 = NULL;
-	    for (BU_LIST_FOR(eu, edgeuse, &s->eu_hd)) {
-		struct line_seg * lseg;
-		if (eu == eu1) {
-		    continue;
-		} else {
-		    eu1 = eu->eumate_p;
-		}
-		BU_ALLOC(lseg, struct line_seg);
-		lseg->magic = CURVE_LSEG_MAGIC;
-		v = eu->vu_p->v_p;
-		lseg->start = bn_vert_tree_add(tree, V3ARGS(v->vg_p->coord), tol_sq);
-		v = eu->eumate_p->vu_p->v_p;
-		lseg->end = bn_vert_tree_add(tree, V3ARGS(v->vg_p->coord), tol_sq);
-		if (verbose) {
-		    bu_log("making sketch line seg from #%d (%g %g %g) to #%d (%g %g %g)\n",
-			   lseg->start, V3ARGS(&tree->the_array[lseg->start]),
-			   lseg->end, V3ARGS(&tree->the_array[lseg->end]));
-		}
-		bu_ptbl_ins(&segs, (long int *)lseg);
-	    }
+	if (bd.njobs >= max_jobs) {
+	    max_jobs += 64;
+	    bd.jobs = (struct batch_job *)bu_realloc(bd.jobs, max_jobs * sizeof(struct batch_job), "batch jobs");
 	}
+	memset(&bd.jobs[bd.njobs], 0, sizeof(struct batch_job));
+	bd.jobs[bd.njobs].dxf_file = bu_strdup(bu_vls_cstr(&in));
+	bd.jobs[bd.njobs].output_file = bu_strdup(bu_vls_cstr(&out));
+	bd.njobs++;
     }
+    fclose(fp);
+    bu_vls_free(&in);
+    bu_vls_free(&out);
 
-    if (BU_PTBL_LEN(&segs) < 1) {
-	bu_free(skt, "rt_sketch_internal");
-	return NULL;
+    if (!bd.njobs) {
+	bu_log("%s: nothing to convert\n", manifest);
+	return 0;
     }
-    skt->vert_count = tree->curr_vert;
-    skt->verts = (point2d_t *)bu_malloc(skt->vert_count * sizeof(point2d_t), "skt->verts");
-    for (idx = 0 ; idx < tree->curr_vert ; idx++) {
-	skt->verts[idx][0] = tree->the_array[idx*3];
-	skt->verts[idx][1] = tree->the_array[idx*3 + 1];
+
+    if (ncpu > bd.njobs) {
+	ncpu = bd.njobs;
     }
-    skt->curve.count = BU_PTBL_LEN(&segs);
-    skt->curve.reverse = (int *)bu_realloc(skt->curve.reverse, skt->curve.count * sizeof (int), "curve segment reverse");
-    memset(skt->curve.reverse, 0, skt->curve.count * sizeof (int));
-    skt->curve.segment = (void **)bu_realloc(skt->curve.segment, skt->curve.count * sizeof (void *), "curve segments");
-    for (idx = 0; idx < BU_PTBL_LEN(&segs); idx++) {
-	void *ptr = BU_PTBL_GET(&segs, idx);
-	skt->curve.segment[idx] = ptr;
+
+    start = bu_gettime();
+    bu_parallel(batch_worker, ncpu, &bd);
+    elapsed = bu_gettime() - start;
+
+    for (i = 0; i < bd.njobs; i++) {
+	if (bd.jobs[i].status) {
+	    failed++;
+	} else {
+	    total_bytes += bd.jobs[i].bytes;
+	}
+	bu_free(bd.jobs[i].dxf_file, "dxf_file");
+	bu_free(bd.jobs[i].output_file, "output_file");
     }
+    bu_free(bd.jobs, "batch jobs");
 
-    bn_vert_tree_destroy(tree);
-    bu_ptbl_free(&segs);
+    secs = (double)elapsed / 1.0e6;
+    if (secs <= 0.0) {
+	secs = 1.0e-6;
+    }
+    bu_log("Converted %zu of %zu files using %zu CPUs in %.3f s (%.1f files/s, %.2f MB/s)\n",
+	   bd.njobs - failed, bd.njobs, ncpu, secs,
+	   (double)(bd.njobs - failed) / secs, (double)total_bytes / (1024.0 * 1024.0) / secs);
 
-    return skt;
+    return (int)failed;
 }
 
 
-int
-readcodes()
+/*
+ * Daemon convert request:
+ *
+ *	convert [-a] [-c] [-i] [-n] [-o] [-p] [-v] [-w] [-e chord_error] [-g tile_size] [-k chunk_triangles] [-r simplify_tolerance] [-t tolerance] [-s scale_factor] input_file.dxf output_file.g
+ *
+ * Options not given in the request default to those the daemon was
+ * started with.
+ */
+static int
+daemon_convert(struct dxf_daemon_job *job, size_t slot, void *data)
 {
-    int code;
-    size_t line_len;
-    static int line_num = 0;
+    struct daemon_data *dd = (struct daemon_data *)data;
+    struct dxf_import_opts opts = *dd->opts;
+    int i;
 
-    curr_state->file_offset = bu_ftell(dxf);
+    opts.cache = dd->caches[slot];
 
-    if (bu_fgets(line, MAX_LINE_SIZE, dxf) == NULL) {
-	return ERROR_FLAG;
-    } else {
-	code = atoi(line);
+    for (i = 1; i < job->argc && job->argv[i][0] == '-'; i++) {
+	switch (job->argv[i][1]) {
+	    case 'c':
+		opts.ignore_colors = 1;
+		break;
+	    case 'a':
+		opts.annotations = 1;
+		break;
+	    case 'i':
+		opts.instance_blocks = 1;
+		break;
+	    case 'n':
+		opts.native_curves = 1;
+		break;
+	    case 'v':
+		opts.verbose = 1;
+		break;
+	    case 'w':
+		opts.dedup_reversed = 1;
+		break;
+	    case 'o':
+		opts.spatial_order = 1;
+		break;
+	    case 'p':
+		opts.split_components = 1;
+		break;
+	    case 'e':
+	    case 'g':
+	    case 'k':
+	    case 'r':
+	    case 't':
+	    case 's':
+		if (i + 1 >= job->argc) {
+		    bu_vls_printf(&job->result, "option %s needs a value", job->argv[i]);
+		    return 1;
+		}
+		if (job->argv[i][1] == 'e') {
+		    opts.chord_error = atof(job->argv[++i]);
+		} else if (job->argv[i][1] == 'g') {
+		    opts.tile_size = atof(job->argv[++i]);
+		} else if (job->argv[i][1] == 'k') {
+		    opts.chunk_tris = (size_t)atol(job->argv[++i]);
+		} else if (job->argv[i][1] == 'r') {
+		    opts.simplify_tol = atof(job->argv[++i]);
+		} else if (job->argv[i][1] == 't') {
+		    opts.tol = atof(job->argv[++i]);
+		} else {
+		    opts.scale_factor = atof(job->argv[++i]);
+		    if (opts.scale_factor < SQRT_SMALL_FASTF) {
+			bu_vls_printf(&job->result, "scale factor too small (%g)", opts.scale_factor);
+			return 1;
+		    }
+		}
+		break;
+	    default:
+		bu_vls_printf(&job->result, "unknown option %s", job->argv[i]);
+		return 1;
+	}
     }
 
-    if (bu_fgets(line, MAX_LINE_SIZE, dxf) == NULL) {
-	return ERROR_FLAG;
+    if (job->argc - i < 2) {
+	bu_vls_strcpy(&job->result, "expected input_file.dxf output_file.g");
+	return 1;
     }
 
-    if (!bu_strncmp(line, "EOF", 3)) {
-	return EOF_FLAG;
+    if (convert_file(job->argv[i], job->argv[i+1], &opts)) {
+	bu_vls_printf(&job->result, "cannot convert %s", job->argv[i]);
+	return 1;
     }
 
-    line_len = strlen(line);
-    if (line_len) {
-	line[line_len-1] = '\0';
-	line_len--;
-    }
+    return 0;
+}
 
-    if (line_len && line[line_len-1] == '\r') {
-	line[line_len-1] = '\0';
-	line_len--;
+
+static int
+run_daemon(const char *socket_path, size_t ncpu, const struct dxf_import_opts *opts)
+{
+    struct daemon_data dd;
+    size_t i;
+    int ret;
+
+    dd.opts = opts;
+    dd.caches = (struct dxf_import_cache **)bu_calloc(ncpu, sizeof(struct dxf_import_cache *), "daemon caches");
+    for (i = 0; i < ncpu; i++) {
+	dd.caches[i] = dxf_import_cache_create();
     }
 
-    if (verbose) {
-	line_num++;
-	bu_log("%d:\t%d\n", line_num, code);
-	line_num++;
-	bu_log("%d:\t%s\n", line_num, line);
+    ret = dxf_daemon_run(socket_path, ncpu, daemon_convert, &dd);
+
+    for (i = 0; i < ncpu; i++) {
+	dxf_import_cache_destroy(dd.caches[i]);
     }
+    bu_free(dd.caches, "daemon caches");
 
-    return code;
+    return ret;
 }
 
 
 int
 main(int argc, char *argv[])
 {
-    struct bu_list head_all;
-    size_t name_len;
-    char *ptr1, *ptr2;
-    int code;
+    struct dxf_import_opts opts;
+    char *manifest = NULL;
+    char *socket_path = NULL;
+    char *merge_output = NULL;
+    size_t ncpu = 0;
     int c;
-    int i;
-
-    tol_sq = tol * tol;
 
-    delta_angle = M_2PI / (fastf_t)segs_per_circle;
-    sin_delta = sin(delta_angle);
-    cos_delta = cos(delta_angle);
+    dxf_import_opts_init(&opts);
 
     /* get command line arguments */
-    scale_factor = 1.0;
-    while ((c = bu_getopt(argc, argv, "cdvt:s:h?")) != -1) {
+    while ((c = bu_getopt(argc, argv, "ab:cde:g:ik:m:nopr:vwt:s:P:S:h?")) != -1) {
 	switch (c) {
+	    case 'b':	/* batch manifest */
+		manifest = bu_optarg;
+		break;
+	    case 'S':	/* daemon socket */
+		socket_path = bu_optarg;
+		break;
+	    case 'm':	/* merge into one database */
+		merge_output = bu_optarg;
+		break;
 	    case 's':	/* scale factor */
-		scale_factor = atof(bu_optarg);
-		if (scale_factor < SQRT_SMALL_FASTF) {
-		    bu_log("scale factor too small (%g < %g)\n", scale_factor, SQRT_SMALL_FASTF);
+		opts.scale_factor = atof(bu_optarg);
+		if (opts.scale_factor < SQRT_SMALL_FASTF) {
+		    bu_log("scale factor too small (%g < %g)\n", opts.scale_factor, SQRT_SMALL_FASTF);
 		    bu_exit(1, "%s", usage);
 		}
 		break;
 	    case 'c':	/* ignore colors */
-		ignore_colors = 1;
+		opts.ignore_colors = 1;
 		break;
 	    case 'd':	/* debug */
 		bu_debug = BU_DEBUG_COREDUMP;
 		break;
+	    case 'e':	/* chord error */
+		opts.chord_error = atof(bu_optarg);
+		break;
+	    case 'a':	/* text as annotations */
+		opts.annotations = 1;
+		break;
+	    case 'g':	/* tile size */
+		opts.tile_size = atof(bu_optarg);
+		break;
+	    case 'i':	/* instance blocks */
+		opts.instance_blocks = 1;
+		break;
+	    case 'k':	/* triangles per BOT chunk */
+		opts.chunk_tris = (size_t)atol(bu_optarg);
+		break;
+	    case 'n':	/* native sketch curves */
+		opts.native_curves = 1;
+		break;
+	    case 'o':	/* Morton ordered BOTs */
+		opts.spatial_order = 1;
+		break;
+	    case 'p':	/* a BOT for each connected piece */
+		opts.split_components = 1;
+		break;
+	    case 'r':	/* simplification tolerance */
+		opts.simplify_tol = atof(bu_optarg);
+		break;
 	    case 't':	/* tolerance */
-		tol = atof(bu_optarg);
-		tol_sq = tol * tol;
+		opts.tol = atof(bu_optarg);
 		break;
 	    case 'v':	/* verbose */
-		verbose = 1;
+		opts.verbose = 1;
+		break;
+	    case 'w':	/* either winding repeats a face */
+		opts.dedup_reversed = 1;
+		break;
+	    case 'P':	/* number of CPUs */
+		ncpu = (size_t)atoi(bu_optarg);
 		break;
 	    default:
 		bu_exit(1, "%s", usage);
 	}
     }
 
-    if (argc - bu_optind < 2) {
-	bu_exit(1, "%s", usage);
-    }
-
-    dxf_file = argv[bu_optind++];
-    output_file = argv[bu_optind];
-
-    if ((dxf=fopen(dxf_file, "rb")) == NULL) {
-	perror(dxf_file);
-	bu_exit(1, "Cannot open DXF file (%s)\n", dxf_file);
-    }
-
-    if ((out_fp = wdb_fopen(output_file)) == NULL) {
-	perror(output_file);
-	bu_exit(1, "Cannot open BRL-CAD geometry file (%s)\n", output_file);
-    }
-
-    ptr1 = strrchr(dxf_file, '/');
-    if (ptr1 == NULL)
-	ptr1 = dxf_file;
-    else
-	ptr1++;
-    ptr2 = strchr(ptr1, '.');
-
-    if (ptr2 == NULL)
-	name_len = strlen(ptr1);
-    else
-	name_len = ptr2 - ptr1;
-
-    base_name = (char *)bu_calloc((unsigned int)name_len + 1, 1, "base_name");
-    bu_strlcpy(base_name , ptr1 , name_len+1);
-
-    mk_id(out_fp, base_name);
-
-    BU_LIST_INIT(&block_head);
-    BU_LIST_INIT(&free_hd);
-
-    process_code[UNKNOWN_SECTION] = process_unknown_code;
-    process_code[HEADER_SECTION] = process_header_code;
-    process_code[CLASSES_SECTION] = process_classes_code;
-    process_code[TABLES_SECTION] = process_tables_code;
-    process_code[BLOCKS_SECTION] = process_blocks_code;
-    process_code[ENTITIES_SECTION] = process_entity_code;
-    process_code[OBJECTS_SECTION] = process_objects_code;
-    process_code[THUMBNAILIMAGE_SECTION] = process_thumbnail_code;
-
-    process_entities_code[UNKNOWN_ENTITY_STATE] = process_entities_unknown_code;
-    process_entities_code[POLYLINE_ENTITY_STATE] = process_entities_polyline_code;
-    process_entities_code[POLYLINE_VERTEX_ENTITY_STATE] = process_entities_polyline_vertex_code;
-    process_entities_code[FACE3D_ENTITY_STATE] = process_3dface_entities_code;
-    process_entities_code[LINE_ENTITY_STATE] = process_line_entities_code;
-    process_entities_code[INSERT_ENTITY_STATE] = process_insert_entities_code;
-    process_entities_code[POINT_ENTITY_STATE] = process_point_entities_code;
-    process_entities_code[CIRCLE_ENTITY_STATE] = process_circle_entities_code;
-    process_entities_code[ARC_ENTITY_STATE] = process_arc_entities_code;
-    process_entities_code[DIMENSION_ENTITY_STATE] = process_dimension_entities_code;
-    process_entities_code[TEXT_ENTITY_STATE] = process_text_attrib_entities_code;
-    process_entities_code[SOLID_ENTITY_STATE] = process_solid_entities_code;
-    process_entities_code[LWPOLYLINE_ENTITY_STATE] = process_lwpolyline_entities_code;
-    process_entities_code[MTEXT_ENTITY_STATE] = process_mtext_entities_code;
-    process_entities_code[ATTRIB_ENTITY_STATE] = process_text_attrib_entities_code;
-    process_entities_code[ATTDEF_ENTITY_STATE] = process_text_attrib_entities_code;
-    process_entities_code[ELLIPSE_ENTITY_STATE] = process_ellipse_entities_code;
-    process_entities_code[LEADER_ENTITY_STATE] = process_leader_entities_code;
-    process_entities_code[SPLINE_ENTITY_STATE] = process_spline_entities_code;
-
-    process_tables_sub_code[UNKNOWN_TABLE_STATE] = process_tables_unknown_code;
-    process_tables_sub_code[LAYER_TABLE_STATE] = process_tables_layer_code;
-
-    /* create storage for circles */
-    circle_pts = (point_t *)bu_calloc(segs_per_circle, sizeof(point_t), "circle_pts");
-    for (i = 0; i < segs_per_circle; i++) {
-	VSETALL(circle_pts[i], 0.0);
+    if (ncpu < 1) {
+	ncpu = bu_avail_cpus();
     }
+    opts.ncpu = ncpu;
 
-    /* initialize state stack */
-    BU_LIST_INIT(&state_stack);
-
-    /* create initial state */
-    BU_ALLOC(curr_state, struct state_data);
-    curr_state->file_offset = 0;
-    curr_state->state = UNKNOWN_SECTION;
-    curr_state->sub_state = UNKNOWN_ENTITY_STATE;
-    MAT_IDN(curr_state->xform);
-
-    /* make space for 5 layers to start */
-    max_layers = 5;
-    next_layer = 1;
-    curr_layer = 0;
-    layers = (struct layer **)bu_calloc(5, sizeof(struct layer *), "layers");
-    for (i = 0; i < max_layers; i++) {
-	BU_ALLOC(layers[i], struct layer);
+    /* daemon and batch jobs already run in parallel, one file to a thread */
+    if (socket_path) {
+	opts.ncpu = 1;
+	return run_daemon(socket_path, ncpu, &opts);
     }
-    layers[0]->name = bu_strdup("noname");
-    layers[0]->color_number = 7;	/* default white */
-    layers[0]->vert_tree = bn_vert_tree_create();
-    bu_ptbl_init(&layers[0]->solids, 8, "layers[curr_layer]->solids");
 
-    curr_color = layers[0]->color_number;
-    curr_layer_name = bu_strdup(layers[0]->name);
-
-    while ((code=readcodes()) > -900) {
-	process_code[curr_state->state](code);
+    if (manifest) {
+	opts.ncpu = 1;
+	return batch_convert(manifest, ncpu, &opts) ? 1 : 0;
     }
 
-    BU_LIST_INIT(&head_all);
-    for (i = 0; i < next_layer; i++) {
-	struct bu_list head;
-	size_t j;
-
-	BU_LIST_INIT(&head);
-
-	if (layers[i]->color_number < 0)
-	    layers[i]->color_number = 7;
-
-	if (layers[i]->curr_tri || BU_PTBL_LEN(&layers[i]->solids) || layers[i]->m) {
-	    bu_log("LAYER: %s, color = %d (%d %d %d)\n", layers[i]->name, layers[i]->color_number, V3ARGS(&rgb[layers[i]->color_number*3]));
+    if (merge_output) {
+	if (argc - bu_optind < 1) {
+	    bu_exit(1, "%s", usage);
 	}
-
-	if (layers[i]->curr_tri && layers[i]->vert_tree->curr_vert > 2) {
-	    sprintf(tmp_name, "bot.s%d", i);
-	    if (mk_bot(out_fp, tmp_name, RT_BOT_SURFACE, RT_BOT_UNORIENTED, 0,
-		       layers[i]->vert_tree->curr_vert, layers[i]->curr_tri, layers[i]->vert_tree->the_array,
-		       layers[i]->part_tris, (fastf_t *)NULL, (struct bu_bitv *)NULL)) {
-		bu_log("Failed to make Bot\n");
-	    } else {
-		(void)mk_addmember(tmp_name, &head, NULL, WMOP_UNION);
-	    }
-	}
-
-	for (j = 0; j < BU_PTBL_LEN(&layers[i]->solids); j++) {
-	    (void)mk_addmember((char *)BU_PTBL_GET(&layers[i]->solids, j), &head, NULL, WMOP_UNION);
-	    bu_free((char *)BU_PTBL_GET(&layers[i]->solids, j), "solid_name");
-	}
-
-	if (layers[i]->m) {
-	    char name[32];
-	    struct rt_sketch_internal *skt;
-
-	    sprintf(name, "sketch.%d", i);
-	    skt = nmg_wire_edges_to_sketch(layers[i]->m);
-	    if (skt != NULL) {
-		mk_sketch(out_fp, name, skt);
-		(void) mk_addmember(name, &head, NULL, WMOP_UNION);
-		rt_curve_free(&skt->curve);
-		if (skt->verts)
-		    bu_free(skt->verts, "free verts");
-		bu_free(skt, "free sketch");
-	    }
-	}
-
-	if (layers[i]->line_count) {
-	    bu_log("\t%zu lines\n", layers[i]->line_count);
-	}
-
-	if (layers[i]->solid_count) {
-	    bu_log("\t%zu solids\n", layers[i]->solid_count);
-	}
-
-	if (layers[i]->polyline_count) {
-	    bu_log("\t%zu polylines\n", layers[i]->polyline_count);
-	}
-
-	if (layers[i]->lwpolyline_count) {
-	    bu_log("\t%zu lwpolylines\n", layers[i]->lwpolyline_count);
-	}
-
-	if (layers[i]->ellipse_count) {
-	    bu_log("\t%zu ellipses\n", layers[i]->ellipse_count);
-	}
-
-	if (layers[i]->circle_count) {
-	    bu_log("\t%zu circles\n", layers[i]->circle_count);
-	}
-
-	if (layers[i]->arc_count) {
-	    bu_log("\t%zu arcs\n", layers[i]->arc_count);
-	}
-
-	if (layers[i]->text_count) {
-	    bu_log("\t%zu texts\n", layers[i]->text_count);
-	}
-
-	if (layers[i]->mtext_count) {
-	    bu_log("\t%zu mtexts\n", layers[i]->mtext_count);
-	}
-
-	if (layers[i]->attrib_count) {
-	    bu_log("\t%zu attribs\n", layers[i]->attrib_count);
-	}
-
-	if (layers[i]->dimension_count) {
-	    bu_log("\t%zu dimensions\n", layers[i]->dimension_count);
-	}
-
-	if (layers[i]->leader_count) {
-	    bu_log("\t%zu leaders\n", layers[i]->leader_count);
-	}
-
-	if (layers[i]->face3d_count) {
-	    bu_log("\t%zu 3d faces\n", layers[i]->face3d_count);
-	}
-
-	if (layers[i]->point_count) {
-	    bu_log("\t%zu points\n", layers[i]->point_count);
-	}
-	if (layers[i]->spline_count) {
-	    bu_log("\t%zu splines\n", layers[i]->spline_count);
-	}
-
-
-	if (BU_LIST_NON_EMPTY(&head)) {
-	    unsigned char *tmp_rgb;
-	    struct bu_vls comb_name = BU_VLS_INIT_ZERO;
-
-	    tmp_rgb = &rgb[layers[i]->color_number*3];
-	    bu_vls_printf(&comb_name, "%s.c.%d", layers[i]->name, i);
-	    if (mk_comb(out_fp, bu_vls_addr(&comb_name), &head, 1, NULL, NULL,
-			tmp_rgb, 1, 0, 1, 100, 0, 0, 0)) {
-		bu_log("Failed to make region %s\n", layers[i]->name);
-	    } else {
-		(void)mk_addmember(bu_vls_addr(&comb_name), &head_all, NULL, WMOP_UNION);
-	    }
-	}
-
+	return merge_files(merge_output, argc - bu_optind, argv + bu_optind, &opts);
     }
 
+    if (argc - bu_optind < 2) {
+	bu_exit(1, "%s", usage);
+    }
 
-    if (BU_LIST_NON_EMPTY(&head_all)) {
-	struct bu_vls top_name = BU_VLS_INIT_ZERO;
-	int count = 0;
-
-	bu_vls_strcpy(&top_name, "all");
-	while (db_lookup(out_fp->dbip, bu_vls_addr(&top_name), LOOKUP_QUIET) != RT_DIR_NULL) {
-	    count++;
-	    bu_vls_trunc(&top_name, 0);
-	    bu_vls_printf(&top_name, "all.%d", count);
-	}
-
-	(void)mk_comb(out_fp, bu_vls_addr(&top_name), &head_all, 0, NULL, NULL, NULL, 0, 0, 0, 0, 0, 0, 0);
+    if (convert_file(argv[bu_optind], argv[bu_optind+1], &opts)) {
+	bu_exit(1, "Cannot convert DXF file (%s)\n", argv[bu_optind]);
     }
 
     return 0;
 }
+#endif /* DXF_IMPORT_NO_MAIN */
 
 
 /*
@@ -3422,4 +8162,4 @@ main(int argc, char *argv[])
  * c-file-style: "stroustrup"
  * End:
  * ex: shiftwidth=4 tabstop=8
- */
\ No newline at end of file
+ */
@@ -0,0 +1,643 @@
+/*                    D X F _ D A E M O N . C
+ * BRL-CAD
+ *
+ * Copyright (c) 2008-2019 United States Government as represented by
+ * the U.S. Army Research Laboratory.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this file; see the file named COPYING for more
+ * information.
+ */
+/** @file dxf_daemon.c
+ *
+ * Unix-domain socket job server used by the dxf-g and g-dxf daemon
+ * modes.  One thread accepts and reads requests and answers status
+ * requests at once, while nworkers more take queued jobs one at a
+ * time as they come free and reply to each client when its job is
+ * done.
+ *
+ */
+
+#include "common.h"
+
+/* system headers */
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include "bio.h"
+#ifdef HAVE_SYS_SOCKET_H
+#  include <sys/socket.h>
+#endif
+#ifdef HAVE_SYS_UN_H
+#  include <sys/un.h>
+#endif
+#ifdef HAVE_POLL_H
+#  include <poll.h>
+#endif
+
+/* interface headers */
+#include "bu/log.h"
+#include "bu/malloc.h"
+#include "bu/parallel.h"
+#include "bu/str.h"
+#include "bu/time.h"
+#include "bu/vls.h"
+
+/* private headers */
+#include "./dxf_daemon.h"
+
+
+#if defined(HAVE_SYS_SOCKET_H) && defined(HAVE_SYS_UN_H) && defined(HAVE_POLL_H)
+
+#define MAX_REQUEST_SIZE 65536
+#define REQUEST_TIMEOUT 5	/* seconds a client has to send its request */
+
+/* a connection whose request line has not all arrived yet */
+struct daemon_client {
+    int fd;
+    struct bu_vls line;
+    int64_t arrived;
+};
+
+struct daemon_state {
+    struct daemon_client *clients;
+    size_t client_count;
+    size_t client_max;
+
+    struct dxf_daemon_job **queue;	/* FIFO of waiting jobs */
+    size_t queue_head;
+    size_t queue_len;
+    size_t queue_max;
+
+    int wake[2];		/* pipe, a byte for each queued job and each worker to stop */
+    size_t nworkers;
+    size_t next_thread;
+    int listen_fd;
+
+    dxf_daemon_handler_t handler;
+    void *data;
+
+    size_t done;
+    size_t failed;
+    int64_t latency_total;
+    int64_t latency_max;
+    int shutdown;
+};
+
+
+static void
+queue_push(struct daemon_state *ds, struct dxf_daemon_job *job)
+{
+    if (ds->queue_len >= ds->queue_max) {
+	struct dxf_daemon_job **q;
+	size_t i;
+
+	/* grow and unwrap the ring */
+	q = (struct dxf_daemon_job **)bu_calloc(ds->queue_max + 64, sizeof(struct dxf_daemon_job *), "daemon queue");
+	for (i = 0; i < ds->queue_len; i++) {
+	    q[i] = ds->queue[(ds->queue_head + i) % ds->queue_max];
+	}
+	if (ds->queue) {
+	    bu_free(ds->queue, "daemon queue");
+	}
+	ds->queue = q;
+	ds->queue_head = 0;
+	ds->queue_max += 64;
+    }
+
+    ds->queue[(ds->queue_head + ds->queue_len) % ds->queue_max] = job;
+    ds->queue_len++;
+}
+
+
+static struct dxf_daemon_job *
+queue_pop(struct daemon_state *ds)
+{
+    struct dxf_daemon_job *job;
+
+    if (!ds->queue_len) {
+	return NULL;
+    }
+
+    job = ds->queue[ds->queue_head];
+    ds->queue_head = (ds->queue_head + 1) % ds->queue_max;
+    ds->queue_len--;
+
+    return job;
+}
+
+
+static void
+job_free(struct dxf_daemon_job *job)
+{
+    int i;
+
+    for (i = 0; i < job->argc; i++) {
+	bu_free(job->argv[i], "request word");
+    }
+    if (job->argv) {
+	bu_free(job->argv, "request words");
+    }
+    bu_vls_free(&job->result);
+    bu_free(job, "dxf_daemon_job");
+}
+
+
+#ifndef MSG_NOSIGNAL
+#  define MSG_NOSIGNAL 0	/* SIGPIPE is ignored in dxf_daemon_run() instead */
+#endif
+
+
+/* write a reply line and close the connection, a client that went away is dropped */
+static void
+reply(int fd, struct bu_vls *msg)
+{
+    const char *c = bu_vls_cstr(msg);
+    size_t len = bu_vls_strlen(msg);
+
+    while (len > 0) {
+	ssize_t ret = send(fd, c, len, MSG_NOSIGNAL);
+	if (ret <= 0) {
+	    if (ret < 0 && errno == EINTR)
+		continue;
+	    if (ret < 0 && (errno == EPIPE || errno == ECONNRESET))
+		bu_log("client went away before its reply\n");
+	    break;
+	}
+	c += ret;
+	len -= (size_t)ret;
+    }
+    close(fd);
+}
+
+
+/* split a request line into white space separated words */
+static int
+split_request(const char *line, char ***argv)
+{
+    const char *c = line;
+    int argc = 0;
+    int max = 0;
+
+    *argv = NULL;
+    while (*c) {
+	const char *word;
+
+	while (*c && isspace((unsigned char)*c))
+	    c++;
+	if (!*c)
+	    break;
+	word = c;
+	while (*c && !isspace((unsigned char)*c))
+	    c++;
+
+	if (argc >= max) {
+	    max += 8;
+	    *argv = (char **)bu_realloc(*argv, max * sizeof(char *), "request words");
+	}
+	(*argv)[argc] = (char *)bu_calloc(c - word + 1, 1, "request word");
+	bu_strlcpy((*argv)[argc], word, c - word + 1);
+	argc++;
+    }
+
+    return argc;
+}
+
+
+/* answer a request that cannot be queued and close the connection */
+static void
+reply_error(struct daemon_state *ds, int fd, const char *message)
+{
+    struct bu_vls msg = BU_VLS_INIT_ZERO;
+
+    bu_vls_printf(&msg, "error 0 0 %zu %s\n", ds->queue_len, message);
+    reply(fd, &msg);
+    bu_vls_free(&msg);
+}
+
+
+/* act on a complete request line */
+static void
+handle_request(struct daemon_state *ds, int fd, const char *line, int64_t arrived)
+{
+    struct dxf_daemon_job *job;
+    struct bu_vls msg = BU_VLS_INIT_ZERO;
+    int flags;
+
+    /* the reply is written in one go, so back to blocking */
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0) {
+	(void)fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+    }
+
+    BU_ALLOC(job, struct dxf_daemon_job);
+    bu_vls_init(&job->result);
+    job->fd = fd;
+    job->queued = arrived;
+    job->argc = split_request(line, &job->argv);
+
+    if (job->argc < 1) {
+	reply_error(ds, fd, "empty request");
+	job_free(job);
+    } else if (BU_STR_EQUAL(job->argv[0], "status")) {
+	double avg;
+
+	bu_semaphore_acquire(BU_SEM_GENERAL);
+	avg = ds->done ? (double)ds->latency_total / (double)ds->done / 1.0e6 : 0.0;
+	bu_vls_printf(&msg, "status queued %zu done %zu failed %zu latency_avg %.6f latency_max %.6f\n",
+		      ds->queue_len, ds->done, ds->failed, avg, (double)ds->latency_max / 1.0e6);
+	bu_semaphore_release(BU_SEM_GENERAL);
+	reply(fd, &msg);
+	job_free(job);
+    } else if (BU_STR_EQUAL(job->argv[0], "shutdown")) {
+	ds->shutdown = 1;
+	bu_vls_printf(&msg, "ok 0 0 %zu\n", ds->queue_len);
+	reply(fd, &msg);
+	job_free(job);
+    } else if (BU_STR_EQUAL(job->argv[0], "convert")) {
+	char token = 1;
+
+	bu_semaphore_acquire(BU_SEM_GENERAL);
+	queue_push(ds, job);
+	bu_semaphore_release(BU_SEM_GENERAL);
+	while (write(ds->wake[1], &token, 1) < 0 && errno == EINTR)
+	    ;
+    } else {
+	bu_vls_printf(&msg, "unknown request %s", job->argv[0]);
+	reply_error(ds, fd, bu_vls_cstr(&msg));
+	job_free(job);
+    }
+
+    bu_vls_free(&msg);
+}
+
+
+static void
+client_remove(struct daemon_state *ds, size_t i)
+{
+    bu_vls_free(&ds->clients[i].line);
+    ds->clients[i] = ds->clients[--ds->client_count];
+}
+
+
+/*
+ * Read what client i has sent so far without blocking.  Only a line
+ * ending in a newline is a request; a client that closes or sends too
+ * much first is answered with an error.  Returns non-zero once the
+ * client has been dealt with and removed.
+ */
+static int
+client_read(struct daemon_state *ds, size_t i)
+{
+    struct daemon_client *cl = &ds->clients[i];
+    char buf[1024];
+
+    while (1) {
+	ssize_t ret = read(cl->fd, buf, sizeof(buf));
+	const char *eol;
+
+	if (ret < 0 && errno == EINTR) {
+	    continue;
+	}
+	if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+	    return 0;
+	}
+	if (ret < 0) {
+	    close(cl->fd);
+	    client_remove(ds, i);
+	    return 1;
+	}
+	if (ret == 0) {
+	    reply_error(ds, cl->fd, "request not terminated by a newline");
+	    client_remove(ds, i);
+	    return 1;
+	}
+
+	eol = (const char *)memchr(buf, '\n', (size_t)ret);
+	bu_vls_strncat(&cl->line, buf, eol ? (size_t)(eol - buf) : (size_t)ret);
+	if (bu_vls_strlen(&cl->line) >= MAX_REQUEST_SIZE) {
+	    reply_error(ds, cl->fd, "request too long");
+	    client_remove(ds, i);
+	    return 1;
+	}
+	if (eol) {
+	    handle_request(ds, cl->fd, bu_vls_cstr(&cl->line), cl->arrived);
+	    client_remove(ds, i);
+	    return 1;
+	}
+    }
+}
+
+
+static void
+accept_clients(struct daemon_state *ds, int listen_fd)
+{
+    int fd;
+
+    while ((fd = accept(listen_fd, NULL, NULL)) >= 0) {
+	struct daemon_client *cl;
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	/* requests are read a piece at a time from the poll loop */
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+	    close(fd);
+	    continue;
+	}
+	if (ds->client_count >= ds->client_max) {
+	    ds->client_max += 16;
+	    ds->clients = (struct daemon_client *)bu_realloc(ds->clients, ds->client_max * sizeof(struct daemon_client), "daemon clients");
+	}
+	cl = &ds->clients[ds->client_count++];
+	cl->fd = fd;
+	bu_vls_init(&cl->line);
+	cl->arrived = bu_gettime();
+    }
+}
+
+
+/* milliseconds poll() may wait before the oldest client runs out of time */
+static int
+client_timeout(struct daemon_state *ds)
+{
+    int64_t now = bu_gettime();
+    int64_t wait = -1;
+    size_t i;
+
+    for (i = 0; i < ds->client_count; i++) {
+	int64_t left = ds->clients[i].arrived + REQUEST_TIMEOUT * 1000000 - now;
+
+	if (left < 0) {
+	    left = 0;
+	}
+	if (wait < 0 || left < wait) {
+	    wait = left;
+	}
+    }
+
+    return (wait < 0) ? -1 : (int)((wait + 999) / 1000);
+}
+
+
+/* drop the clients that have not sent a whole request in time */
+static void
+client_expire(struct daemon_state *ds)
+{
+    int64_t now = bu_gettime();
+    size_t i = 0;
+
+    while (i < ds->client_count) {
+	if (now - ds->clients[i].arrived >= REQUEST_TIMEOUT * 1000000) {
+	    reply_error(ds, ds->clients[i].fd, "request timed out");
+	    client_remove(ds, i);
+	} else {
+	    i++;
+	}
+    }
+}
+
+
+/* take queued jobs until a stop token finds the queue empty */
+static void
+daemon_worker(struct daemon_state *ds, size_t slot)
+{
+    while (1) {
+	struct dxf_daemon_job *job;
+	struct bu_vls msg = BU_VLS_INIT_ZERO;
+	int64_t latency;
+	double service;
+	size_t depth, done;
+	char token;
+
+	if (read(ds->wake[0], &token, 1) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    perror("daemon worker");
+	    break;
+	}
+
+	bu_semaphore_acquire(BU_SEM_GENERAL);
+	job = queue_pop(ds);
+	bu_semaphore_release(BU_SEM_GENERAL);
+	if (!job) {
+	    break;
+	}
+
+	job->started = bu_gettime();
+	job->status = ds->handler(job, slot, ds->data);
+	job->finished = bu_gettime();
+	latency = job->finished - job->queued;
+	service = (double)(job->finished - job->started) / 1.0e6;
+
+	bu_semaphore_acquire(BU_SEM_GENERAL);
+	ds->done++;
+	ds->failed += (job->status != 0);
+	ds->latency_total += latency;
+	V_MAX(ds->latency_max, latency);
+	depth = ds->queue_len;
+	done = ds->done;
+	bu_semaphore_release(BU_SEM_GENERAL);
+
+	if (job->status) {
+	    bu_vls_printf(&msg, "error %.6f %.6f %zu %s\n", (double)latency / 1.0e6, service, depth,
+			  bu_vls_strlen(&job->result) ? bu_vls_cstr(&job->result) : "conversion failed");
+	} else {
+	    bu_vls_printf(&msg, "ok %.6f %.6f %zu\n", (double)latency / 1.0e6, service, depth);
+	}
+	reply(job->fd, &msg);
+	bu_vls_free(&msg);
+
+	bu_log("job %zu %s: latency %.3f s, service %.3f s, queue depth %zu\n",
+	       done, job->status ? "failed" : "ok", (double)latency / 1.0e6, service, depth);
+
+	job_free(job);
+    }
+}
+
+
+/* accept and read requests until a shutdown request, then stop the workers */
+static void
+daemon_listen(struct daemon_state *ds)
+{
+    size_t i;
+
+    while (!ds->shutdown) {
+	struct pollfd *pfds;
+	size_t n = ds->client_count;
+
+	pfds = (struct pollfd *)bu_calloc(n + 1, sizeof(struct pollfd), "daemon poll");
+	pfds[0].fd = ds->listen_fd;
+	pfds[0].events = POLLIN;
+	for (i = 0; i < n; i++) {
+	    pfds[i + 1].fd = ds->clients[i].fd;
+	    pfds[i + 1].events = POLLIN;
+	}
+	if (poll(pfds, n + 1, client_timeout(ds)) < 0 && errno != EINTR) {
+	    perror("poll");
+	    bu_free(pfds, "daemon poll");
+	    break;
+	}
+
+	/* backwards, as a client that is done swaps in the last one */
+	for (i = n; i > 0 && !ds->shutdown; i--) {
+	    if (pfds[i].revents) {
+		(void)client_read(ds, i - 1);
+	    }
+	}
+	bu_free(pfds, "daemon poll");
+	if (!ds->shutdown) {
+	    client_expire(ds);
+	    accept_clients(ds, ds->listen_fd);
+	}
+    }
+
+    while (ds->client_count) {
+	reply_error(ds, ds->clients[0].fd, "daemon is shutting down");
+	client_remove(ds, 0);
+    }
+
+    /* the workers finish what is queued before they see these */
+    for (i = 0; i < ds->nworkers; i++) {
+	char token = 0;
+
+	while (write(ds->wake[1], &token, 1) < 0 && errno == EINTR)
+	    ;
+    }
+}
+
+
+/* the first thread listens, the others are the workers with slots 0 to nworkers-1 */
+static void
+daemon_thread(int UNUSED(cpu), void *data)
+{
+    struct daemon_state *ds = (struct daemon_state *)data;
+    size_t id;
+
+    bu_semaphore_acquire(BU_SEM_GENERAL);
+    id = ds->next_thread++;
+    bu_semaphore_release(BU_SEM_GENERAL);
+
+    if (id == 0) {
+	daemon_listen(ds);
+    } else {
+	daemon_worker(ds, id - 1);
+    }
+}
+
+
+int
+dxf_daemon_run(const char *socket_path, size_t nworkers, dxf_daemon_handler_t handler, void *data)
+{
+    struct daemon_state ds;
+    struct sockaddr_un addr;
+    struct dxf_daemon_job *job;
+    int listen_fd;
+    int flags;
+
+    if (nworkers < 1) {
+	nworkers = 1;
+    }
+
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+	bu_log("Socket path is too long (%s)\n", socket_path);
+	return 1;
+    }
+
+#ifdef SIGPIPE
+    /* a client closing early must not take the daemon down with it */
+    (void)signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if ((listen_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+	perror("socket");
+	return 1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    bu_strlcpy(addr.sun_path, socket_path, sizeof(addr.sun_path));
+    (void)unlink(socket_path);
+
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(listen_fd, 64) < 0) {
+	perror(socket_path);
+	close(listen_fd);
+	return 1;
+    }
+
+    flags = fcntl(listen_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+	perror("fcntl");
+	close(listen_fd);
+	(void)unlink(socket_path);
+	return 1;
+    }
+
+    memset(&ds, 0, sizeof(ds));
+    if (pipe(ds.wake) < 0) {
+	perror("pipe");
+	close(listen_fd);
+	(void)unlink(socket_path);
+	return 1;
+    }
+    ds.handler = handler;
+    ds.data = data;
+    ds.nworkers = nworkers;
+    ds.listen_fd = listen_fd;
+
+    bu_log("Listening on %s with %zu workers\n", socket_path, nworkers);
+
+    bu_parallel(daemon_thread, nworkers + 1, &ds);
+
+    close(listen_fd);
+    (void)unlink(socket_path);
+    close(ds.wake[0]);
+    close(ds.wake[1]);
+    if (ds.clients) {
+	bu_free(ds.clients, "daemon clients");
+    }
+
+    /* anything left over after an error gets no answer */
+    while ((job = queue_pop(&ds)) != NULL) {
+	close(job->fd);
+	job_free(job);
+    }
+    if (ds.queue) {
+	bu_free(ds.queue, "daemon queue");
+    }
+
+    bu_log("Daemon stopped after %zu jobs (%zu failed)\n", ds.done, ds.failed);
+
+    return 0;
+}
+
+#else /* no Unix-domain sockets */
+
+int
+dxf_daemon_run(const char *socket_path, size_t UNUSED(nworkers), dxf_daemon_handler_t UNUSED(handler), void *UNUSED(data))
+{
+    bu_log("Daemon mode is not supported on this platform (%s)\n", socket_path);
+    return 1;
+}
+
+#endif
+
+
+/*
+ * Local Variables:
+ * mode: C
+ * tab-width: 8
+ * indent-tabs-mode: t
+ * c-file-style: "stroustrup"
+ * End:
+ * ex: shiftwidth=4 tabstop=8
+ */
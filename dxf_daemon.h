@@ -0,0 +1,85 @@
+/*                    D X F _ D A E M O N . H
+ * BRL-CAD
+ *
+ * Copyright (c) 2008-2019 United States Government as represented by
+ * the U.S. Army Research Laboratory.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this file; see the file named COPYING for more
+ * information.
+ */
+/** @file dxf_daemon.h
+ *
+ * Job server shared by dxf-g and g-dxf when they run as a local
+ * daemon (-S socket_path).
+ *
+ * Clients connect to a Unix-domain socket and send one request line
+ * of white space separated words:
+ *
+ *	convert [options] input output [objects ...]
+ *	status
+ *	shutdown
+ *
+ * A convert request is queued and answered with a single line once
+ * the job has run:
+ *
+ *	ok <latency> <service> <queue_depth>
+ *	error <latency> <service> <queue_depth> <message>
+ *
+ * where latency is the time from arrival to completion, service the
+ * time spent converting (both in seconds) and queue_depth the number
+ * of jobs still waiting.  A status request is answered immediately:
+ *
+ *	status queued <n> done <n> failed <n> latency_avg <s> latency_max <s>
+ *
+ */
+
+#ifndef CONV_DXF_DXF_DAEMON_H
+#define CONV_DXF_DXF_DAEMON_H
+
+struct dxf_daemon_job {
+    int fd;			/* client connection, the reply goes here */
+    int argc;
+    char **argv;		/* request words, argv[0] is "convert" */
+    int64_t queued;		/* bu_gettime() when the request arrived */
+    int64_t started;		/* bu_gettime() when the handler was called */
+    int64_t finished;
+    int status;			/* handler result, zero on success */
+    struct bu_vls result;	/* error message from the handler */
+};
+
+/**
+ * Run one convert request.  slot is less than the number of workers
+ * and no two jobs running at the same time share a slot, so handlers
+ * can keep per-slot caches without locking.  Returns zero on success.
+ */
+typedef int (*dxf_daemon_handler_t)(struct dxf_daemon_job *job, size_t slot, void *data);
+
+/**
+ * Listen on socket_path and run convert requests through handler on
+ * up to nworkers threads until a shutdown request arrives.  Returns
+ * non-zero if the socket could not be set up.
+ */
+extern int dxf_daemon_run(const char *socket_path, size_t nworkers, dxf_daemon_handler_t handler, void *data);
+
+#endif /* CONV_DXF_DXF_DAEMON_H */
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * mode: C
+ * indent-tabs-mode: t
+ * c-file-style: "stroustrup"
+ * End:
+ * ex: shiftwidth=4 tabstop=8
+ */
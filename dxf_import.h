@@ -0,0 +1,135 @@
+/*                    D X F _ I M P O R T . H
+ * BRL-CAD
+ *
+ * Copyright (c) 2004-2019 United States Government as represented by
+ * the U.S. Army Research Laboratory.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * version 2.1 as published by the Free Software Foundation.
+ *
+ * This library is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this file; see the file named COPYING for more
+ * information.
+ */
+/** @file dxf_import.h
+ *
+ * Library interface to the DXF importer in dxf-g.c.
+ *
+ * All of the state for one conversion lives in an opaque dxf_import
+ * context, so several conversions may run concurrently in one process
+ * as long as each context writes to a different database.  Build
+ * dxf-g.c with DXF_IMPORT_NO_MAIN defined to link it into another
+ * program.
+ *
+ * Typical use:
+ *
+ *	struct dxf_import_opts opts;
+ *	struct dxf_import *ctx;
+ *
+ *	dxf_import_opts_init(&opts);
+ *	ctx = dxf_import_open("in.dxf", wdbp, &opts);
+ *	while (dxf_import_feed(ctx, 4096))
+ *	    ;
+ *	dxf_import_finish(ctx);
+ *
+ */
+
+#ifndef CONV_DXF_DXF_IMPORT_H
+#define CONV_DXF_DXF_IMPORT_H
+
+struct dxf_import_cache;
+struct dxf_block_library;
+
+struct dxf_import_opts {
+    int verbose;		/* log every group code and entity */
+    int ignore_colors;		/* group layers by name only */
+    int native_curves;		/* keep arcs, ellipses and splines as sketch curves */
+    int dedup_reversed;		/* drop a face repeated with reversed winding, not only exact repeats */
+    int spatial_order;		/* write BOT triangles and vertices along a Morton curve */
+    size_t chunk_tris;		/* split surface BOTs into Morton ordered chunks of at most this many triangles, 0 for none */
+    int split_components;	/* write each connected piece of a layer mesh as its own BOT */
+    fastf_t tile_size;		/* split layers into grid cells this wide in drawing units, 0 for none */
+    size_t ncpu;		/* threads preparing the layers for writing, 1 by default */
+    int annotations;		/* keep text as attributes on a per-layer object instead of strokes */
+    fastf_t chord_error;	/* max chord deviation of curves in drawing units, 0 for fixed counts */
+    fastf_t simplify_tol;	/* max deviation of simplified polylines in drawing units, 0 to only merge collinear lines */
+    fastf_t tol;		/* vertex welding distance, mm */
+    fastf_t scale_factor;	/* applied to every coordinate */
+    struct dxf_import_cache *cache;	/* optional buffers reused between imports */
+    const char *prefix;		/* prepended to every object name, may be NULL */
+    const char *top_name;	/* top level combination, NULL for "all" */
+    struct dxf_block_library *blocks;	/* optional, see dxf_block_library_create() */
+    int instance_blocks;	/* write INSERTs as references to blocks, with a private library if blocks is NULL */
+};
+
+struct dxf_import;
+
+/**
+ * Create a cache of allocations that are handed from one import to
+ * the next, along with the block recordings of the last few files so
+ * that importing an unchanged file again does not parse its blocks
+ * again.  A cache may only be used by one import at a time, so a
+ * thread pool should keep one per worker.
+ */
+extern struct dxf_import_cache *dxf_import_cache_create(void);
+extern void dxf_import_cache_destroy(struct dxf_import_cache *cache);
+
+/**
+ * Create a library of converted BLOCK definitions.  When an import
+ * is given a library, each INSERT references a combination holding
+ * the block instead of expanding the block into the layer geometry.
+ * Blocks are identified by name and a hash of their definition, so
+ * imports sharing one library (and one database) convert each
+ * distinct definition once.  A library is not locked and may only be
+ * used by one import at a time.
+ */
+extern struct dxf_block_library *dxf_block_library_create(void);
+extern void dxf_block_library_destroy(struct dxf_block_library *lib);
+
+/**
+ * Log the number of block definitions converted and the number of
+ * INSERTs that reused one.
+ */
+extern void dxf_block_library_report(const struct dxf_block_library *lib);
+
+/**
+ * Fill in the default import options.
+ */
+extern void dxf_import_opts_init(struct dxf_import_opts *opts);
+
+/**
+ * Open a DXF file for import into wdbp.  opts may be NULL to use the
+ * defaults.  Returns NULL if the file cannot be opened.
+ */
+extern struct dxf_import *dxf_import_open(const char *dxf_file, struct rt_wdb *wdbp, const struct dxf_import_opts *opts);
+
+/**
+ * Process up to max_codes group codes (all remaining codes if
+ * max_codes is zero).  Returns non-zero while input remains.
+ */
+extern int dxf_import_feed(struct dxf_import *ctx, size_t max_codes);
+
+/**
+ * Process any remaining input, write the layer objects to the
+ * database and release the context.  The database is left open.
+ */
+extern int dxf_import_finish(struct dxf_import *ctx);
+
+#endif /* CONV_DXF_DXF_IMPORT_H */
+
+
+/*
+ * Local Variables:
+ * tab-width: 8
+ * mode: C
+ * indent-tabs-mode: t
+ * c-file-style: "stroustrup"
+ * End:
+ * ex: shiftwidth=4 tabstop=8
+ */
@@ -32,6 +32,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "bio.h"
 
 /* interface headers */
@@ -45,6 +46,7 @@
 /* private headers */
 #include "brlcad_ident.h"
 #include "./dxf.h"
+#include "./dxf_daemon.h"
 
 
 #define V3ARGSIN(a)       (a)[X]/25.4, (a)[Y]/25.4, (a)[Z]/25.4
@@ -60,7 +62,9 @@ usage(const char *argv0)
 {
     bu_log("Usage: %s [-v] [-i] [-p] [-xX lvl]\n\
        [-a abs_tess_tol] [-r rel_tess_tol] [-n norm_tess_tol] [-D dist_calc_tol]\n\
-       [-o output_file_name.dxf] [-P #_of_CPUs] brlcad_db.g object(s)\n\n", argv0);
+       [-o output_file_name.dxf] [-P #_of_CPUs] brlcad_db.g object(s)\n\
+       %s [-v] [-i] [-p] [-a abs_tess_tol] [-r rel_tess_tol] [-n norm_tess_tol]\n\
+       [-D dist_calc_tol] -S socket_path\n\n", argv0, argv0);
 
     bu_log("Options:\n\
  -v	Verbose output\n\
@@ -81,7 +85,8 @@ usage(const char *argv0)
  -P #	DISABLED: Specify number of CPUS to be used (value accepted, but not used)\n\n");
 
     bu_log("\
- -o dxf	Output to the specified dxf filename\n\n---\n");
+ -o dxf	Output to the specified dxf filename\n\
+ -S path	Run as a daemon taking convert requests on the Unix socket path\n\n---\n");
 }
 
 static int	NMG_debug;	/* saved arg of -X, for longjmp handling */
@@ -368,26 +373,9 @@ union tree *get_layer(struct db_tree_state *tsp, const struct db_full_path *path
 static struct gcv_region_end_data gcvwriter = {nmg_to_dxf, NULL};
 
 
-/**
- * This is the gist for what is going on (not verified):
- *
- * 1. initialize tree_state (db_tree_state)
- * 2. Deal with command line arguments. Strip off everything but regions for processing.
- * 3. Open geometry (.g) file and build directory db_dirbuild
- * 4. db_walk_tree (get_layer) for layer names only
- * 5. Initialize tree_state
- * 6. Initialize model (nmg)\
- * 7. db_walk_tree (gcv_region_end)
- * 8. Cleanup
- */
-int
-main(int argc, char *argv[])
+static void
+init_tolerances(void)
 {
-    int c;
-    double percent;
-
-    bu_setlinebuf(stderr);
-
     tree_state = rt_initial_tree_state;	/* struct copy */
     tree_state.ts_tol = &tol;
     tree_state.ts_ttol = &ttol;
@@ -407,11 +395,358 @@ main(int argc, char *argv[])
     tol.dist_sq = tol.dist * tol.dist;
     tol.perp = 1e-6;
     tol.para = 1 - tol.perp;
+}
+
+
+/**
+ * Write the named objects of the open database to fp as a complete
+ * DXF file.
+ */
+static void
+write_dxf(int nobjs, const char **objs)
+{
+    double percent;
+
+    regions_tried = 0;
+    regions_converted = 0;
+    regions_written = 0;
+    tot_polygons = 0;
+
+    /* output DXF header and start of TABLES section */
+    fprintf(fp,
+	    "0\nSECTION\n2\nHEADER\n999\n%s\n0\nENDSEC\n0\nSECTION\n2\nTABLES\n0\nTABLE\n2\nLAYER\n",
+	    objs[nobjs-1]);
+
+    /* Walk indicated tree(s) just for layer names to put in TABLES section */
+    (void)db_walk_tree(dbip, nobjs, objs,
+		       1,			/* ncpu */
+		       &tree_state,
+		       0,			/* take all regions */
+		       get_layer,
+		       NULL,
+		       (void *)NULL);	/* in librt/nmg_bool.c */
+
+    /* end of layers section, start of ENTITIES SECTION */
+    fprintf(fp, "0\nENDTAB\n0\nENDSEC\n0\nSECTION\n2\nENTITIES\n");
+
+    /* Walk indicated tree(s).  Each region will be output separately */
+    tree_state = rt_initial_tree_state;	/* struct copy */
+    tree_state.ts_tol = &tol;
+    tree_state.ts_ttol = &ttol;
+    /* make empty NMG model */
+    the_model = nmg_mm();
+    tree_state.ts_m = &the_model;
+    (void) db_walk_tree(dbip, nobjs, objs,
+			1,			/* ncpu */
+			&tree_state,
+			0,			/* take all regions */
+			gcv_region_end,
+			nmg_booltree_leaf_tess,
+			(void *)&gcvwriter);	/* callback for gcv_region_end */
+
+    percent = 0;
+    if (regions_tried>0) {
+	percent = ((double)regions_converted * 100) / regions_tried;
+	if (verbose)
+	    bu_log("Tried %d regions, %d converted to NMG's successfully.  %g%%\n",
+		   regions_tried, regions_converted, percent);
+    }
+    percent = 0;
+
+    if (regions_tried > 0) {
+	percent = ((double)regions_written * 100) / regions_tried;
+	if (verbose)
+	    bu_log("                  %d triangulated successfully. %g%%\n",
+		    regions_written, percent);
+    }
+
+    bu_log("%ld triangles written\n", (long int)tot_polygons);
+
+    fprintf(fp, "0\nENDSEC\n0\nEOF\n");
+
+    nmg_km(the_model);
+    the_model = NULL;
+}
+
+
+/*
+ * Daemon state kept between jobs.  The database stays open (with its
+ * directory built) until a job names another file or the file
+ * changes, and the last few outputs are kept so that a repeated
+ * request replays the DXF instead of tessellating again.
+ */
+#define OUTPUT_CACHE_SIZE 8
+
+struct output_cache_entry {
+    struct bu_vls key;	/* database, mtime, size, options and objects */
+    char *buf;
+    size_t len;
+};
+
+static char *db_path = NULL;
+static time_t db_mtime = 0;
+static long db_mtime_nsec = 0;
+static off_t db_size = 0;
+static struct output_cache_entry output_cache[OUTPUT_CACHE_SIZE];
+static size_t output_cache_next = 0;
+static size_t output_cache_hits = 0;
+
+/* the options given on the daemon command line, restored before each job */
+static struct rt_tess_tol daemon_ttol;
+static struct bn_tol daemon_tol;
+static int daemon_verbose;
+static int daemon_inches;
+static int daemon_polyface_mesh;
+
+
+/* nanoseconds of the modification time, where the system keeps them */
+static long
+mtime_nsec(const struct stat *sb)
+{
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+    return (long)sb->st_mtim.tv_nsec;
+#elif defined(__APPLE__)
+    return (long)sb->st_mtimespec.tv_nsec;
+#else
+    (void)sb;
+    return 0;
+#endif
+}
+
+
+/* open path unless it is the database already open and unchanged since */
+static int
+daemon_open_db(const char *path, const struct stat *sb)
+{
+    if (dbip != DBI_NULL && db_path && BU_STR_EQUAL(path, db_path) && sb->st_mtime == db_mtime
+	&& mtime_nsec(sb) == db_mtime_nsec && sb->st_size == db_size)
+	return 0;
+
+    if (dbip != DBI_NULL) {
+	db_close(dbip);
+	dbip = DBI_NULL;
+	bu_free(db_path, "db_path");
+	db_path = NULL;
+    }
+
+    if ((dbip = db_open(path, DB_OPEN_READONLY)) == DBI_NULL)
+	return 1;
+
+    if (db_dirbuild(dbip)) {
+	db_close(dbip);
+	dbip = DBI_NULL;
+	return 1;
+    }
+
+    db_path = bu_strdup(path);
+    db_mtime = sb->st_mtime;
+    db_mtime_nsec = mtime_nsec(sb);
+    db_size = sb->st_size;
+    return 0;
+}
+
+
+static int
+daemon_store_output(const char *output, struct bu_vls *key)
+{
+    struct output_cache_entry *ent = &output_cache[output_cache_next];
+    long len;
+
+    if ((fp = fopen(output, "rb")) == NULL)
+	return 1;
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    rewind(fp);
+    if (len < 0) {
+	fclose(fp);
+	return 1;
+    }
+
+    if (ent->buf)
+	bu_free(ent->buf, "output cache");
+    else
+	bu_vls_init(&ent->key);
+
+    ent->buf = (char *)bu_malloc((size_t)len + 1, "output cache");
+    ent->len = fread(ent->buf, 1, (size_t)len, fp);
+    fclose(fp);
+    bu_vls_strcpy(&ent->key, bu_vls_addr(key));
+
+    output_cache_next = (output_cache_next + 1) % OUTPUT_CACHE_SIZE;
+    return 0;
+}
+
+
+/*
+ * Daemon convert request:
+ *
+ *	convert [-v] [-i] [-p] [-a #] [-r #] [-n #] [-D #] brlcad_db.g output.dxf object(s)
+ *
+ * The request options apply on top of those the daemon was started with.
+ */
+static int
+daemon_convert(struct dxf_daemon_job *job, size_t UNUSED(slot), void *UNUSED(data))
+{
+    struct bu_vls key = BU_VLS_INIT_ZERO;
+    struct stat sb;
+    const char *input;
+    const char *output;
+    int i, j;
+    int ret = 0;
+
+    init_tolerances();
+    ttol = daemon_ttol;
+    tol = daemon_tol;
+    polyface_mesh = daemon_polyface_mesh;
+    inches = daemon_inches;
+    verbose = daemon_verbose;
+
+    for (i = 1; i < job->argc && job->argv[i][0] == '-'; i++) {
+	const char *opt = job->argv[i];
+
+	if (opt[1] == 'v' || opt[1] == 'i' || opt[1] == 'p') {
+	    if (opt[1] == 'v')
+		verbose++;
+	    else if (opt[1] == 'i')
+		inches = 1;
+	    else
+		polyface_mesh = 1;
+	    continue;
+	}
+
+	if (!strchr("arnD", opt[1]) || i + 1 >= job->argc) {
+	    bu_vls_printf(&job->result, "bad option %s", opt);
+	    return 1;
+	}
+
+	switch (opt[1]) {
+	    case 'a':
+		ttol.abs = atof(job->argv[++i]);
+		ttol.rel = 0.0;
+		break;
+	    case 'n':
+		ttol.norm = atof(job->argv[++i]);
+		ttol.rel = 0.0;
+		break;
+	    case 'r':
+		ttol.rel = atof(job->argv[++i]);
+		break;
+	    case 'D':
+		tol.dist = atof(job->argv[++i]);
+		tol.dist_sq = tol.dist * tol.dist;
+		break;
+	}
+    }
+
+    if (job->argc - i < 3) {
+	bu_vls_strcpy(&job->result, "expected brlcad_db.g output.dxf object(s)");
+	return 1;
+    }
+    input = job->argv[i];
+    output = job->argv[i+1];
+    i += 2;
+
+    if (stat(input, &sb) || daemon_open_db(input, &sb)) {
+	bu_vls_printf(&job->result, "unable to open geometry database file (%s)", input);
+	return 1;
+    }
+
+    bu_vls_printf(&key, "%s|%ld.%09ld|%lld|%d|%d|%g|%g|%g|%g", input, (long)sb.st_mtime, mtime_nsec(&sb),
+		  (long long)sb.st_size, inches, polyface_mesh, ttol.abs, ttol.rel, ttol.norm, tol.dist);
+    for (j = i; j < job->argc; j++)
+	bu_vls_printf(&key, "|%s", job->argv[j]);
+
+    for (j = 0; j < OUTPUT_CACHE_SIZE; j++) {
+	if (!output_cache[j].buf || !BU_STR_EQUAL(bu_vls_addr(&output_cache[j].key), bu_vls_addr(&key)))
+	    continue;
+
+	if ((fp = fopen(output, "wb")) == NULL
+	    || fwrite(output_cache[j].buf, 1, output_cache[j].len, fp) != output_cache[j].len) {
+	    bu_vls_printf(&job->result, "cannot write %s", output);
+	    ret = 1;
+	}
+	if (fp)
+	    fclose(fp);
+	output_cache_hits++;
+	if (verbose)
+	    bu_log("%s: replayed cached output (%zu hits)\n", output, output_cache_hits);
+	bu_vls_free(&key);
+	return ret;
+    }
+
+    if ((fp = fopen(output, "w+b")) == NULL) {
+	bu_vls_printf(&job->result, "cannot open output file (%s) for writing", output);
+	bu_vls_free(&key);
+	return 1;
+    }
+
+    write_dxf(job->argc - i, (const char **)(job->argv + i));
+    fclose(fp);
+
+    (void)daemon_store_output(output, &key);
+    bu_vls_free(&key);
+    return 0;
+}
+
+
+static int
+run_daemon(const char *socket_path)
+{
+    int ret;
+    int i;
+
+    daemon_ttol = ttol;
+    daemon_tol = tol;
+    daemon_verbose = verbose;
+    daemon_inches = inches;
+    daemon_polyface_mesh = polyface_mesh;
+
+    /* the converter keeps its state in file statics, so one worker */
+    ret = dxf_daemon_run(socket_path, 1, daemon_convert, NULL);
+
+    for (i = 0; i < OUTPUT_CACHE_SIZE; i++) {
+	if (!output_cache[i].buf)
+	    continue;
+	bu_free(output_cache[i].buf, "output cache");
+	bu_vls_free(&output_cache[i].key);
+    }
+    if (dbip != DBI_NULL) {
+	db_close(dbip);
+	bu_free(db_path, "db_path");
+    }
+    rt_vlist_cleanup();
+
+    return ret;
+}
+
+
+/**
+ * This is the gist for what is going on (not verified):
+ *
+ * 1. initialize tree_state (db_tree_state)
+ * 2. Deal with command line arguments. Strip off everything but regions for processing.
+ * 3. Open geometry (.g) file and build directory db_dirbuild
+ * 4. db_walk_tree (get_layer) for layer names only
+ * 5. Initialize tree_state
+ * 6. Initialize model (nmg)\
+ * 7. db_walk_tree (gcv_region_end)
+ * 8. Cleanup
+ */
+int
+main(int argc, char *argv[])
+{
+    int c;
+    char *socket_path = NULL;
+
+    bu_setlinebuf(stderr);
+
+    init_tolerances();
 
     BU_LIST_INIT(&RTG.rtg_vlfree);	/* for vlist macros */
 
     /* Get command line arguments. */
-    while ((c = bu_getopt(argc, argv, "a:n:o:pr:vx:D:P:X:ih?")) != -1) {
+    while ((c = bu_getopt(argc, argv, "a:n:o:pr:vx:D:P:S:X:ih?")) != -1) {
 	switch (c) {
 	    case 'a':		/* Absolute tolerance. */
 		ttol.abs = atof(bu_optarg);
@@ -436,6 +771,9 @@ main(int argc, char *argv[])
 	    case 'P':
 		ncpu = atoi(bu_optarg);
 		break;
+	    case 'S':		/* Daemon socket. */
+		socket_path = bu_optarg;
+		break;
 	    case 'x':
 		sscanf(bu_optarg, "%x", (unsigned int *)&RTG.debug);
 		break;
@@ -458,6 +796,10 @@ main(int argc, char *argv[])
 	}
     }
 
+    if (socket_path) {
+	return run_daemon(socket_path);
+    }
+
     if (bu_optind+1 >= argc) {
 	usage(argv[0]);
 	bu_exit(1, "%s\n", brlcad_ident("BRL-CAD to DXF Exporter"));
@@ -502,64 +844,13 @@ main(int argc, char *argv[])
 		tree_state.ts_tol->dist, tree_state.ts_tol->perp);
     }
 
-    /* output DXF header and start of TABLES section */
-    fprintf(fp,
-	    "0\nSECTION\n2\nHEADER\n999\n%s\n0\nENDSEC\n0\nSECTION\n2\nTABLES\n0\nTABLE\n2\nLAYER\n",
-	    argv[argc-1]);
-
-    /* Walk indicated tree(s) just for layer names to put in TABLES section */
-    (void)db_walk_tree(dbip, argc-1, (const char **)(argv+1),
-		       1,			/* ncpu */
-		       &tree_state,
-		       0,			/* take all regions */
-		       get_layer,
-		       NULL,
-		       (void *)NULL);	/* in librt/nmg_bool.c */
-
-    /* end of layers section, start of ENTITIES SECTION */
-    fprintf(fp, "0\nENDTAB\n0\nENDSEC\n0\nSECTION\n2\nENTITIES\n");
-
-    /* Walk indicated tree(s).  Each region will be output separately */
-    tree_state = rt_initial_tree_state;	/* struct copy */
-    tree_state.ts_tol = &tol;
-    tree_state.ts_ttol = &ttol;
-    /* make empty NMG model */
-    the_model = nmg_mm();
-    tree_state.ts_m = &the_model;
-    (void) db_walk_tree(dbip, argc-1, (const char **)(argv+1),
-			1,			/* ncpu */
-			&tree_state,
-			0,			/* take all regions */
-			gcv_region_end,
-			nmg_booltree_leaf_tess,
-			(void *)&gcvwriter);	/* callback for gcv_region_end */
-
-    percent = 0;
-    if (regions_tried>0) {
-	percent = ((double)regions_converted * 100) / regions_tried;
-	if (verbose)
-	    bu_log("Tried %d regions, %d converted to NMG's successfully.  %g%%\n",
-		   regions_tried, regions_converted, percent);
-    }
-    percent = 0;
-
-    if (regions_tried > 0) {
-	percent = ((double)regions_written * 100) / regions_tried;
-	if (verbose)
-	    bu_log("                  %d triangulated successfully. %g%%\n",
-		    regions_written, percent);
-    }
-
-    bu_log("%ld triangles written\n", (long int)tot_polygons);
-
-    fprintf(fp, "0\nENDSEC\n0\nEOF\n");
+    write_dxf(argc-1, (const char **)(argv+1));
 
     if (output_file) {
 	fclose(fp);
     }
 
     /* Release dynamic storage */
-    nmg_km(the_model);
     rt_vlist_cleanup();
     db_close(dbip);
 